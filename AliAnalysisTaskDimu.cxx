@@ -30,6 +30,13 @@
 #include "AliAnalysisTaskDimu.h"
 
 #include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <thread>
 
 // ROOT includes
 #include "TROOT.h"
@@ -41,12 +48,15 @@
 #include "TMath.h"
 #include "TObjString.h"
 #include "TObjArray.h"
+#include "TArrayI.h"
 //#include "TMCProcess.h"
 #include "TDatabasePDG.h"
 #include "TList.h"
 #include "TPaveStats.h"
 #include "TPRegexp.h"
 #include "THashList.h"
+#include "TFile.h"
+#include "TTree.h"
 #include "AliMultiplicity.h"
 
 // STEER includes
@@ -72,6 +82,12 @@
 #include "AliMuonTrackCuts.h"
 #include "AliAnalysisMuonUtility.h"
 #include "AliUtilityMuonAncestor.h"
+#include "AliDimuEventMixer.h"
+#include "AliDimuSkim.h"
+#include "AliDimuProjectionStore.h"
+#include "AliDimuWeightMap.h"
+#include "AliDimuSlowEvents.h"
+#include "AliDimuOccupancy.h"
 
 /// \cond CLASSIMP
 ClassImp(AliAnalysisTaskDimu) // Class implementation in ROOT context
@@ -83,7 +99,68 @@ AliAnalysisTaskDimu::AliAnalysisTaskDimu() :
 AliAnalysisTaskSE(),
 fSelectedPairTypes(""),
 fMergeableCollection(0x0),
-fSparse(0x0)
+fSparse(0x0),
+fBinning(),
+fMixingDepth(0),
+fMixingMaxMuons(4),
+fEventMixer(0x0),
+fMixedPairTypeId(-1),
+fSkimFileName(""),
+fSkimBlockSize(8192),
+fSkimWriter(0x0),
+fTrackletPhi(),
+fTrackletDist(),
+fTrackletsLoaded(kFALSE),
+fExecVariant(-1),
+fDataParticleTypeCached(kFALSE),
+fDataParticleType(0),
+fDataPairTypeId(-1),
+fDataCommonAncestor(-1),
+fTrackletDistCutsNames(),
+fTrigClassIds(),
+fTrigClassNames(),
+fTrigClassEvents(),
+fTrigClassPtCutLevel(),
+fTrigClassIsDimuon(),
+fPairTypeIds(),
+fPairTypeNames(),
+fPairTypeSelected(),
+fPairTypeSkimIndex(),
+fPairSparses(),
+fUseTrackPrefilter(kFALSE),
+fTrackPrefilterCheck(kFALSE),
+fTrackPrefilter(),
+fTrackPrefilterMismatches(0),
+fUseAODFastPath(kTRUE),
+fAODFastPath(kFALSE),
+fMuonTracksOnly(kFALSE),
+fRecoTracks(),
+fAODMuons(),
+fTerminateThreads(0),
+fTerminateOutput(""),
+fTerminateDraw(kTRUE),
+fEffMassMin(0.),
+fEffMassMax(0.),
+fEffMapAxes({kHvarPt, kHvarY, kHcentrality, kHtracklets}),
+fWeightMap(0x0),
+fWeightGenerated(kFALSE),
+fTimers(),
+fSlowEventsMax(20),
+fEventLatency(0x0),
+fSlowEvents(0x0),
+fOccupancySampling(10000),
+fOccupancy(0x0),
+fSparseList(),
+fSparseIdentifiers(),
+fDryRunEvents(0),
+fDryRunDatasetEvents(0),
+fDryRunStop(kTRUE),
+fDryRunMaxOutputMB(0.),
+fDryRunMaxCpuHours(0.),
+fDryRunProcessed(0),
+fDryRunStartTime(0),
+fDryRunStartCpu(0.),
+fDryRunHalfBins()
 {
   /// Default ctor.
 }
@@ -93,7 +170,68 @@ AliAnalysisTaskDimu::AliAnalysisTaskDimu ( const char *name ) :
 AliAnalysisTaskSE(name),
 fSelectedPairTypes(""),
 fMergeableCollection(0x0),
-fSparse(0x0)
+fSparse(0x0),
+fBinning(),
+fMixingDepth(0),
+fMixingMaxMuons(4),
+fEventMixer(0x0),
+fMixedPairTypeId(-1),
+fSkimFileName(""),
+fSkimBlockSize(8192),
+fSkimWriter(0x0),
+fTrackletPhi(),
+fTrackletDist(),
+fTrackletsLoaded(kFALSE),
+fExecVariant(-1),
+fDataParticleTypeCached(kFALSE),
+fDataParticleType(0),
+fDataPairTypeId(-1),
+fDataCommonAncestor(-1),
+fTrackletDistCutsNames(),
+fTrigClassIds(),
+fTrigClassNames(),
+fTrigClassEvents(),
+fTrigClassPtCutLevel(),
+fTrigClassIsDimuon(),
+fPairTypeIds(),
+fPairTypeNames(),
+fPairTypeSelected(),
+fPairTypeSkimIndex(),
+fPairSparses(),
+fUseTrackPrefilter(kFALSE),
+fTrackPrefilterCheck(kFALSE),
+fTrackPrefilter(),
+fTrackPrefilterMismatches(0),
+fUseAODFastPath(kTRUE),
+fAODFastPath(kFALSE),
+fMuonTracksOnly(kFALSE),
+fRecoTracks(),
+fAODMuons(),
+fTerminateThreads(0),
+fTerminateOutput(""),
+fTerminateDraw(kTRUE),
+fEffMassMin(0.),
+fEffMassMax(0.),
+fEffMapAxes({kHvarPt, kHvarY, kHcentrality, kHtracklets}),
+fWeightMap(0x0),
+fWeightGenerated(kFALSE),
+fTimers(),
+fSlowEventsMax(20),
+fEventLatency(0x0),
+fSlowEvents(0x0),
+fOccupancySampling(10000),
+fOccupancy(0x0),
+fSparseList(),
+fSparseIdentifiers(),
+fDryRunEvents(0),
+fDryRunDatasetEvents(0),
+fDryRunStop(kTRUE),
+fDryRunMaxOutputMB(0.),
+fDryRunMaxCpuHours(0.),
+fDryRunProcessed(0),
+fDryRunStartTime(0),
+fDryRunStartCpu(0.),
+fDryRunHalfBins()
 {
   //
   /// Constructor.
@@ -112,13 +250,166 @@ AliAnalysisTaskDimu::~AliAnalysisTaskDimu()
     delete fMergeableCollection;
   }
   delete fSparse;
+  delete fEventMixer;
+  delete fSkimWriter;
+  delete fWeightMap;
 }
 
 //________________________________________________________________________
 void AliAnalysisTaskDimu::NotifyRun()
 {
-  /// Set run number for cuts
+  /// Set run number for cuts.
+  /// The event loop specialization, the sources of the data
+  /// and the trigger pt-cut levels per trigger class index are computed again
+  /// at the first event of the run (SelectExecVariant)
   fMuonPairCuts.SetRun(fInputHandler);
+  fExecVariant = -1;
+  fDataParticleTypeCached = kFALSE;
+}
+
+//________________________________________________________________________
+void AliAnalysisTaskDimu::FinishTaskOutput()
+{
+  /// Close the skim file at the end of the processing on the worker,
+  /// check the track prefilter cross-check (fatal on mismatch) and store the stage timers in the output
+  if ( fSkimWriter ) {
+    AliInfo(Form("Skim %s: %llu events",fSkimFileName.Data(),fSkimWriter->GetNevents()));
+    fSkimWriter->Close();
+  }
+  if ( fUseTrackPrefilter && fTrackPrefilterCheck ) {
+    if ( fTrackPrefilterMismatches > 0 ) AliFatal(Form("Track prefilter: %lld selected tracks rejected by the prefilter",fTrackPrefilterMismatches));
+    else AliInfo("Track prefilter: same selection as the track cuts");
+  }
+  FlushStageTimers();
+}
+
+//________________________________________________________________________
+void AliAnalysisTaskDimu::FlushStageTimers ()
+{
+  /// Add the stage timers (s) and counters of the worker to the histograms
+  /// "stageTimes" and "counters" of the identifier /perf.
+  /// They are merged with the rest of the output, so the merged histograms
+  /// give the time per stage of the whole production.
+  if ( ! fMergeableCollection ) return;
+  fTimers.Count(AliDimuStageTimers::kWorkers);
+  TH1* stageTimes = static_cast<TH1*>(GetMergeableObject("/perf", "stageTimes"));
+  TH1* counters = static_cast<TH1*>(GetMergeableObject("/perf", "counters"));
+  for ( Int_t istage=0; istage<AliDimuStageTimers::kNstages; ++istage ) stageTimes->AddBinContent(istage+1, 1.e-9*fTimers.GetTime(istage));
+  for ( Int_t icounter=0; icounter<AliDimuStageTimers::kNcounters; ++icounter ) counters->AddBinContent(icounter+1, fTimers.GetCount(icounter));
+  stageTimes->SetEntries(stageTimes->GetEntries()+1);
+  counters->SetEntries(counters->GetEntries()+1);
+  Double_t totalTime = 1.e-9*fTimers.GetTime(AliDimuStageTimers::kTotal);
+  AliInfo(Form("%lld events in %g s (%g us/event), %lld pairs, %lld fills",fTimers.GetCount(AliDimuStageTimers::kEvents),totalTime,fTimers.GetCount(AliDimuStageTimers::kEvents)>0?1.e6*totalTime/fTimers.GetCount(AliDimuStageTimers::kEvents):0.,fTimers.GetCount(AliDimuStageTimers::kPairs),fTimers.GetCount(AliDimuStageTimers::kFills)));
+  fTimers.Reset();
+}
+
+//________________________________________________________________________
+void AliAnalysisTaskDimu::EndEventTimers ( Long64_t startTime, Int_t nCandidates, AliMultiplicity* mult )
+{
+  /// Stop the event timer, fill the latency histogram
+  /// and keep the event if it is among the slowest ones
+  fTimers.Stop(AliDimuStageTimers::kTotal, startTime);
+  Long64_t nEvents = fTimers.GetCount(AliDimuStageTimers::kEvents);
+  if ( fOccupancy && nEvents % fOccupancySampling == 0 ) {
+    fOccupancy->AddSample(nEvents, fSparseList);
+    if ( fDebug > 0 ) PrintOccupancyReport();
+  }
+  if ( fDryRunEvents > 0 ) CheckDryRun();
+  Double_t time = 1.e-3*fTimers.GetEventTime(AliDimuStageTimers::kTotal);
+  if ( fEventLatency ) fEventLatency->Fill(time);
+  if ( ! fSlowEvents || ! fSlowEvents->IsSlow(time) ) return;
+  Double_t stageTimes[AliDimuStageTimers::kNstages];
+  for ( Int_t istage=0; istage<AliDimuStageTimers::kNstages; ++istage ) stageTimes[istage] = 1.e-3*fTimers.GetEventTime(istage);
+  ULong64_t eventId = InputEvent()->GetHeader() ? InputEvent()->GetHeader()->GetEventIdAsLong() : 0;
+  fSlowEvents->AddEvent(InputEvent()->GetRunNumber(), eventId, CurrentFileName(), Entry(), nCandidates, mult ? mult->GetNumberOfTracklets() : 0, time, stageTimes);
+}
+
+//________________________________________________________________________
+void AliAnalysisTaskDimu::SetDryRun ( Long64_t nEvents, Long64_t datasetEvents, Bool_t stopAfter )
+{
+  /// Process the first nEvents events of each job, then extrapolate to the
+  /// datasetEvents events of the dataset (all the jobs):
+  /// memory of each identifier of the merged output, total memory and CPU time.
+  /// The job is aborted if the limits (SetDryRunLimits) are exceeded.
+  /// If stopAfter is kTRUE, the following events are skipped: UserExec returns immediately,
+  /// but the analysis manager still reads them from the input (the task cannot stop the
+  /// event loop of the other tasks). To avoid reading the rest of the input, also limit
+  /// the number of entries of the job, e.g. AliAnalysisManager::StartAnalysis("local",chain,nEvents)
+  fDryRunEvents = nEvents;
+  fDryRunDatasetEvents = datasetEvents;
+  fDryRunStop = stopAfter;
+}
+
+//________________________________________________________________________
+void AliAnalysisTaskDimu::CheckDryRun ()
+{
+  /// Extrapolate the output memory and the CPU time at the end of the dry run.
+  /// The filled bins of each identifier are extrapolated with a power law
+  /// n^alpha (0<=alpha<=1) from the values at half and at the end of the dry run,
+  /// limited by the number of cells of the sparse.
+  /// The identifiers that appear in the second half grow linearly
+  ++fDryRunProcessed;
+  if ( fDryRunProcessed == fDryRunEvents/2 ) {
+    fDryRunHalfBins.resize(fSparseList.size());
+    for ( size_t isparse=0; isparse<fSparseList.size(); ++isparse ) fDryRunHalfBins[isparse] = fSparseList[isparse]->GetNbins();
+  }
+  if ( fDryRunProcessed != fDryRunEvents ) return;
+
+  Double_t scale = ( fDryRunDatasetEvents > fDryRunEvents ) ? (Double_t)fDryRunDatasetEvents / fDryRunEvents : 1.;
+  Double_t totalBytes = 0.;
+  std::vector<std::pair<Double_t,Int_t> > sparseBytes;
+  for ( size_t isparse=0; isparse<fSparseList.size(); ++isparse ) {
+    THnSparse* sparse = fSparseList[isparse];
+    Long64_t nBins = sparse->GetNbins();
+    if ( nBins == 0 ) continue;
+    Double_t alpha = 1.;
+    if ( isparse < fDryRunHalfBins.size() && fDryRunHalfBins[isparse] > 0 ) alpha = TMath::Max(0.,TMath::Min(1.,TMath::Log((Double_t)nBins/fDryRunHalfBins[isparse])/TMath::Log(2.)));
+    Double_t nCells = 1.;
+    for ( Int_t idim=0; idim<sparse->GetNdimensions(); ++idim ) nCells *= sparse->GetAxis(idim)->GetNbins() + 2;
+    Double_t finalBins = TMath::Min(nBins * TMath::Power(scale,alpha), nCells);
+    Double_t bytes = finalBins * AliDimuOccupancy::EstimateBytes(sparse) / nBins;
+    sparseBytes.push_back(std::make_pair(bytes,(Int_t)isparse));
+    totalBytes += bytes;
+  }
+  std::sort(sparseBytes.begin(), sparseBytes.end(), std::greater<std::pair<Double_t,Int_t> >());
+
+  Long64_t now = AliDimuStageTimers::Now();
+  Double_t cpuNow = (Double_t)std::clock() / CLOCKS_PER_SEC;
+  Double_t execTime = 1.e-9 * fTimers.GetTime(AliDimuStageTimers::kTotal) / fDryRunEvents;
+  Double_t wallTime = ( fDryRunStartTime > 0 && fDryRunEvents > 1 ) ? 1.e-9 * ( now - fDryRunStartTime ) / ( fDryRunEvents - 1 ) : execTime;
+  Double_t cpuTime = ( fDryRunStartTime > 0 && fDryRunEvents > 1 ) ? ( cpuNow - fDryRunStartCpu ) / ( fDryRunEvents - 1 ) : execTime;
+  Double_t nDatasetEvents = fDryRunEvents * scale;
+  Double_t cpuHours = cpuTime * nDatasetEvents / 3600.;
+  Double_t wallHours = wallTime * nDatasetEvents / 3600.;
+  Double_t outputMB = totalBytes/1024./1024.;
+
+  printf("\nDry run: %lld events, extrapolated to %lld events\n", fDryRunEvents, (Long64_t)(fDryRunEvents*scale));
+  printf("%-60s %12s %12s\n", "identifier", "bins now", "final (MB)");
+  for ( auto& entry : sparseBytes ) printf("%-60s %12lld %12.2f\n", fSparseIdentifiers[entry.second].Data(), fSparseList[entry.second]->GetNbins(), entry.first/1024./1024.);
+  printf("Merged output: %lu sparses, %.1f MB\n", sparseBytes.size(), outputMB);
+  printf("Time per event: %.1f us in UserExec, %.1f us wall time and %.1f us CPU time with the input\n", 1.e6*execTime, 1.e6*wallTime, 1.e6*cpuTime);
+  printf("Total: %.1f CPU hours, %.1f wall-time hours (single job)\n\n", cpuHours, wallHours);
+
+  TString exceeded = "";
+  if ( fDryRunMaxOutputMB > 0. && outputMB > fDryRunMaxOutputMB ) exceeded += Form(" output %.1f MB > %.1f MB;",outputMB,fDryRunMaxOutputMB);
+  if ( fDryRunMaxCpuHours > 0. && cpuHours > fDryRunMaxCpuHours ) exceeded += Form(" CPU time %.1f h > %.1f h;",cpuHours,fDryRunMaxCpuHours);
+  if ( ! exceeded.IsNull() ) AliFatal(Form("Dry run: limits exceeded:%s",exceeded.Data()));
+  if ( fDryRunStop ) AliInfo("Dry run done: the following events are skipped (but still read from the input)");
+}
+
+//________________________________________________________________________
+void AliAnalysisTaskDimu::PrintOccupancyReport () const
+{
+  /// Print the memory and occupancy of the sparses per identifier,
+  /// and the growth of the filled bins.
+  /// It can be called during the processing (it is called at each sample
+  /// with debug level > 0) and it is called in Terminate on the merged output:
+  /// there the memory report is the one of the merged sparses, while the growth
+  /// curves are summed over the workers (see AliDimuOccupancy)
+  if ( ! fMergeableCollection ) return;
+  AliDimuOccupancy::PrintReport(fMergeableCollection);
+  AliDimuOccupancy* occupancy = fOccupancy ? fOccupancy : static_cast<AliDimuOccupancy*>(fMergeableCollection->GetObject("/perf","occupancy"));
+  if ( occupancy ) occupancy->Print();
 }
 
 //________________________________________________________________________
@@ -135,6 +426,67 @@ void AliAnalysisTaskDimu::SetTrackletDistCuts ( Double_t* cuts, Int_t nCuts )
   std::sort(fTrackletDistCuts.begin(),fTrackletDistCuts.end(),std::greater<Double_t>());
 }
 
+//________________________________________________________________________
+void AliAnalysisTaskDimu::SetEventMixing ( Int_t poolDepth, Double_t* centralityEdges, Int_t nCentralityEdges, Double_t* trackletEdges, Int_t nTrackletEdges, Int_t maxMuonsPerEvent )
+{
+  /// Enable mixed-event pairs.
+  /// The pools are binned in centrality and number of SPD tracklets
+  /// (bin edges in increasing order).
+  /// Each pool keeps the selected muons of the last poolDepth events,
+  /// with at most maxMuonsPerEvent muons per event.
+  /// The mixed pairs are stored with pair type "ME" (MixedPairType)
+  fMixingDepth = poolDepth;
+  fMixingMaxMuons = maxMuonsPerEvent;
+  fMixingCentralityEdges.assign(centralityEdges,centralityEdges+nCentralityEdges);
+  fMixingTrackletEdges.assign(trackletEdges,trackletEdges+nTrackletEdges);
+}
+
+//________________________________________________________________________
+void AliAnalysisTaskDimu::SetSkimOutput ( const char* fileName, Int_t blockSize )
+{
+  /// Write the selected muons, the tracklets and the event information
+  /// to a columnar skim file (see AliDimuSkim) that can be re-analysed
+  /// without the AODs.
+  /// The tracklets are stored only for events with at least one pair.
+  /// When running on grid, the file must be added to the output files of the plugin
+  fSkimFileName = fileName;
+  fSkimBlockSize = blockSize;
+}
+
+//________________________________________________________________________
+Bool_t AliAnalysisTaskDimu::SetBinningSchema ( const char* fileName )
+{
+  /// Read the binning of the output sparse from a schema file
+  /// (e.g. proposed by dimuOptimizeBinning, see AliDimuBinning::ReadSchema).
+  /// The file is read when configuring the task: the binning is then streamed with the task
+  Bool_t isOk = fBinning.ReadSchema(fileName);
+  if ( isOk ) fBinning.Print();
+  else AliError(Form("Cannot read the binning schema %s",fileName));
+  return isOk;
+}
+
+//________________________________________________________________________
+void AliAnalysisTaskDimu::SetEfficiencyMapAxes ( const Int_t* axes, Int_t nAxes )
+{
+  /// Axes of the multi-dimensional efficiency maps computed in Terminate
+  /// (default: pt, y, centrality, tracklets).
+  /// The maps are written in the Terminate output (see SetTerminateOutput)
+  fEffMapAxes.assign(axes,axes+nAxes);
+}
+
+//________________________________________________________________________
+void AliAnalysisTaskDimu::SetWeightMap ( AliDimuWeightMap* weightMap, Bool_t applyToGenerated )
+{
+  /// Weight the reconstructed and mixed-event pairs with the map
+  /// (e.g. 1/efficiency, see AliDimuWeightMap::CreateFromSparse).
+  /// The map axes refer to the sparse variables (kHvarPt, kHvarY, ...).
+  /// The generated pairs are weighted only if applyToGenerated is kTRUE.
+  /// The task owns the map
+  if ( weightMap != fWeightMap ) delete fWeightMap;
+  fWeightMap = weightMap;
+  fWeightGenerated = applyToGenerated;
+}
+
 //________________________________________________________________________
 TObject* AliAnalysisTaskDimu::GetMergeableObject ( TString identifier, TString objectName )
 {
@@ -149,11 +501,37 @@ TObject* AliAnalysisTaskDimu::GetMergeableObject ( TString identifier, TString o
     TH1* histo = new TH1D(objectName.Data(),objectName.Data(),1,0.5,1.5);
     obj = histo;
   }
+  else if ( objectName == "stageTimes" ) {
+    TH1* histo = new TH1D(objectName.Data(),"Time per stage;;time (s)",AliDimuStageTimers::kNstages,0.,AliDimuStageTimers::kNstages);
+    for ( Int_t istage=0; istage<AliDimuStageTimers::kNstages; ++istage ) histo->GetXaxis()->SetBinLabel(istage+1,AliDimuStageTimers::GetStageName(istage));
+    obj = histo;
+  }
+  else if ( objectName == "eventLatency" ) {
+    // Logarithmic bins from 1 us to 10 s
+    const Int_t nBins = 140;
+    Double_t edges[nBins+1];
+    for ( Int_t ibin=0; ibin<=nBins; ++ibin ) edges[ibin] = TMath::Power(10.,7.*ibin/nBins);
+    TH1* histo = new TH1D(objectName.Data(),"Processing time per event;time (#mus);events",nBins,edges);
+    obj = histo;
+  }
+  else if ( objectName == "slowEvents" ) obj = new AliDimuSlowEvents(objectName.Data(),fSlowEventsMax,AliDimuStageTimers::kNstages);
+  else if ( objectName == "occupancy" ) obj = new AliDimuOccupancy(objectName.Data(),fOccupancySampling);
+  else if ( objectName == "counters" ) {
+    TH1* histo = new TH1D(objectName.Data(),"Counters;;entries",AliDimuStageTimers::kNcounters,0.,AliDimuStageTimers::kNcounters);
+    for ( Int_t icounter=0; icounter<AliDimuStageTimers::kNcounters; ++icounter ) histo->GetXaxis()->SetBinLabel(icounter+1,AliDimuStageTimers::GetCounterName(icounter));
+    obj = histo;
+  }
   else {
     AliError(Form("Unknown object %s\n",objectName.Data()));
   }
 
   fMergeableCollection->Adopt(identifier, obj);
+  fTimers.Count(AliDimuStageTimers::kNewIdentifiers);
+  if ( objectName == "DimuSparse" ) {
+    fSparseList.push_back(static_cast<THnSparse*>(obj));
+    fSparseIdentifiers.push_back(identifier);
+    if ( fOccupancy ) fOccupancy->AddIdentifier(identifier.Data());
+  }
   AliInfo(Form("Mergeable object collection size %g MB", fMergeableCollection->EstimateSize()/1024.0/1024.0));
   return obj;
 }
@@ -162,71 +540,518 @@ TObject* AliAnalysisTaskDimu::GetMergeableObject ( TString identifier, TString o
 void AliAnalysisTaskDimu::UserCreateOutputObjects()
 {
 
-  Int_t nPtBins = 100;
-  Double_t ptMin = 0., ptMax = 100.;
-  TString ptTitle("p_{T}"), ptUnits("GeV/c");
-
-  Int_t nEtaBins = 25;
-  Double_t etaMin = -4.5, etaMax = -2.;
-  TString etaTitle("y"), etaUnits("");
-
-  Int_t nPhiBins = 36;
-  Double_t phiMin = 0., phiMax = 2.*TMath::Pi();
-  TString phiTitle("#phi"), phiUnits("rad");
-
-  // Int_t nInvMassBins = 1500;
-  // Double_t invMassMin = 0., invMassMax = 150.;
-  Int_t nInvMassBins = 750;
-  Double_t invMassMin = 0., invMassMax = 15.;
-  TString invMassTitle("M_{#mu#mu}"), invMassUnits("GeV/c^{2}");
-
-  Int_t nMultBins = 10;
-  Double_t multBinMin = 0., multBinMax = 100.;
-  TString multBinTitle(Form("Centrality (%s)",fMuonEventCuts.GetCentralityEstimator().Data())), multBinUnits("");
-
-  Int_t nTrackletBins = 150;
-  Double_t trackletMin = -0.5, trackletMax = 150.-0.5;
-  TString trackletTitle("SPD tracklets"), trackletUnits("");
-
-//  Int_t nMotherTypeBins = kNpairTypes;
-//  Double_t motherTypeMin = -0.5, motherTypeMax = (Double_t)kNpairTypes - 0.5;
-//  TString motherType("MotherType"), motherTypeTitle("motherType"), motherTypeUnits("");
-
-  Int_t nbins[kNvars] = {nPtBins, nEtaBins, nPhiBins, nInvMassBins, nMultBins, nTrackletBins};
-  Double_t xmin[kNvars] = {ptMin, etaMin, phiMin, invMassMin, multBinMin, trackletMin};
-  Double_t xmax[kNvars] = {ptMax, etaMax, phiMax, invMassMax, multBinMax, trackletMax};
-  TString axisTitle[kNvars] = {ptTitle, etaTitle, phiTitle, invMassTitle, multBinTitle, trackletTitle};
-  TString axisUnits[kNvars] = {ptUnits, etaUnits, phiUnits, invMassUnits, multBinUnits, trackletUnits};
-
-  fSparse = new THnSparseF("BaseDimuSparse","Sparse for tracks",kNvars,nbins);
-
-  TString histoTitle = "";
-  for ( Int_t idim = 0; idim<kNvars; idim++ ) {
-    histoTitle = Form("%s (%s)", axisTitle[idim].Data(), axisUnits[idim].Data());
-    histoTitle.ReplaceAll("()","");
-    fSparse->GetAxis(idim)->SetTitle(histoTitle.Data());
-
-    Double_t array[nbins[idim]+1];
-    for ( Int_t ibin=0; ibin<=nbins[idim]; ibin++ ) array[ibin] = xmin[idim] + ibin * (xmax[idim]-xmin[idim])/nbins[idim] ;
-    fSparse->SetBinEdges(idim, array);
+  fBinning.SetAxisTitle(kHcentrality, Form("Centrality (%s)",fMuonEventCuts.GetCentralityEstimator().Data()));
+  fSparse = fBinning.CreateSparse("BaseDimuSparse","Sparse for tracks");
+  if ( fWeightMap ) {
+    fSparse->Sumw2();
+    fWeightMap->Print();
   }
 
   fMergeableCollection = new AliMergeableCollection(GetOutputSlot(1)->GetContainer()->GetName());
+  fEventLatency = static_cast<TH1*>(GetMergeableObject("/perf", "eventLatency"));
+  if ( fSlowEventsMax > 0 ) fSlowEvents = static_cast<AliDimuSlowEvents*>(GetMergeableObject("/perf", "slowEvents"));
+  if ( fOccupancySampling > 0 ) fOccupancy = static_cast<AliDimuOccupancy*>(GetMergeableObject("/perf", "occupancy"));
   fMuonEventCuts.Print("mask");
   fMuonPairCuts.Print("mask");
 
   AliInfo(Form("The task will store the results for %s",fSelectedPairTypes.IsNull()?"all particles":fSelectedPairTypes.Data()));
 
   TString trackletDistCuts = "";
+  fTrackletDistCutsNames.clear();
   for ( auto& val : fTrackletDistCuts ) {
     trackletDistCuts += Form("  %g",val);
+    fTrackletDistCutsNames.push_back(Form("trackletDistCuts_%g",val));
   }
+  fTrackletDistCutsNames.push_back("trackletDistCuts_none");
   if ( trackletDistCuts.IsNull() ) trackletDistCuts = "none";
   AliInfo(Form("Cuts on tracklet distance: %s",trackletDistCuts.Data()));
 
+  if ( fMixingDepth > 0 && fMixingCentralityEdges.size() > 1 && fMixingTrackletEdges.size() > 1 ) {
+    fEventMixer = new AliDimuEventMixer(fMixingDepth,fMixingMaxMuons,fMixingCentralityEdges,fMixingTrackletEdges);
+    AliInfo(Form("Event mixing: %i pools of %i events (max %i muons per event): %g MB",fEventMixer->GetNpools(),fEventMixer->GetPoolDepth(),fEventMixer->GetMaxMuonsPerEvent(),fEventMixer->GetMemorySize()/1024./1024.));
+    fMixedPairTypeId = GetPairTypeId(MixedPairType());
+  }
+
+  if ( ! fSkimFileName.IsNull() ) {
+    fSkimWriter = new AliDimuSkimWriter(fSkimFileName.Data(),fSkimBlockSize);
+    if ( fSkimWriter->IsOpen() ) AliInfo(Form("Writing skim to %s",fSkimFileName.Data()));
+    else {
+      AliError(Form("Cannot open skim file %s",fSkimFileName.Data()));
+      delete fSkimWriter;
+      fSkimWriter = 0x0;
+    }
+  }
+
   PostData(1,fMergeableCollection);
 }
 
+//________________________________________________________________________
+void AliAnalysisTaskDimu::BeginSkimEvent ( const TObjArray* selectTrigClasses, Double_t centrality )
+{
+  /// Add the event to the skim, with the trigger pt-cut levels of its classes in the run
+  /// (set by SelectExecVariant and GetTrigClassId)
+  ULong64_t trigMask = 0;
+  Int_t run = InputEvent()->GetRunNumber();
+  std::vector<TString> trigClasses;
+  TIter nextTrig(selectTrigClasses);
+  TObject* obj;
+  while ( (obj = nextTrig()) ) trigClasses.push_back(obj->GetName());
+  if ( MCEvent() ) trigClasses.push_back("generated");
+
+  for ( auto& trigClass : trigClasses ) {
+    Int_t index = fSkimWriter->AddTrigClass(trigClass.Data());
+    if ( index < 0 ) {
+      AliWarning(Form("Too many trigger classes in skim: %s not stored",trigClass.Data()));
+      continue;
+    }
+    Int_t trigClassId = GetTrigClassId(trigClass);
+    fSkimWriter->SetTrigClassPtCutLevel(run, index, fTrigClassPtCutLevel[trigClassId], fTrigClassIsDimuon[trigClassId]);
+    trigMask |= ( 1ULL << index );
+  }
+
+  fSkimWriter->BeginEvent(run,centrality,trigMask);
+}
+
+//________________________________________________________________________
+void AliAnalysisTaskDimu::EndSkimEvent ( AliMultiplicity* mult )
+{
+  /// Add the tracklets (only if needed for pairs) and close the skim event
+  if ( mult && fSkimWriter->GetNpairsInEvent() > 0 ) {
+    if ( ! fTrackletsLoaded ) LoadTracklets(mult);
+    for ( size_t itrk=0; itrk<fTrackletPhi.size(); ++itrk ) fSkimWriter->AddTracklet(fTrackletPhi[itrk],fTrackletDist[itrk]);
+  }
+  fSkimWriter->EndEvent();
+}
+
+//________________________________________________________________________
+void AliAnalysisTaskDimu::SetTrackPrefilter ( Bool_t usePrefilter, Bool_t crossCheck )
+{
+  /// Select the muon tracks with a batch prefilter before the full track cuts (off by default).
+  /// With crossCheck, the full track cuts are applied to all the tracks
+  /// and the job fails in FinishTaskOutput if a selected track is rejected by the prefilter.
+  /// Validate the prefilter on a recorded sample with bench/checkTrackPrefilter before enabling it
+  fUseTrackPrefilter = usePrefilter;
+  fTrackPrefilterCheck = crossCheck;
+}
+
+//________________________________________________________________________
+Int_t AliAnalysisTaskDimu::LoadRecoTracks ()
+{
+  /// Fill the list of the reconstructed track candidates of the event
+  /// and evaluate the track prefilter on them.
+  /// AOD fast path: the AliAODTrack are read once (AliDimuAODMuons), without the ESD/AOD checks
+  /// of AliAnalysisMuonUtility and with non-virtual accessors: the same sweep builds the
+  /// compact muons and fills the prefilter, and only the muon tracks are kept when the track
+  /// cuts require them.
+  /// Returns the number of tracks of the event
+  if ( fAODFastPath ) return fAODMuons.Load(static_cast<const AliAODEvent*>(InputEvent()), fMuonTracksOnly, fRecoTracks, fUseTrackPrefilter ? &fTrackPrefilter : 0x0);
+  fRecoTracks.clear();
+  Int_t nTracks = AliAnalysisMuonUtility::GetNTracks(InputEvent());
+  for ( Int_t itrack=0; itrack<nTracks; ++itrack ) fRecoTracks.push_back(AliAnalysisMuonUtility::GetTrack(itrack,InputEvent()));
+  if ( ! fUseTrackPrefilter ) return nTracks;
+  fTrackPrefilter.Resize(nTracks);
+  for ( Int_t itrack=0; itrack<nTracks; ++itrack ) {
+    const AliVParticle* track = fRecoTracks[itrack];
+    if ( AliAnalysisMuonUtility::IsMuonTrack(track) ) fTrackPrefilter.SetTrack(itrack, kTRUE, track->Eta(), AliAnalysisMuonUtility::GetThetaAbsDeg(track), AliAnalysisMuonUtility::GetMatchTrigger(track));
+    else fTrackPrefilter.SetTrack(itrack, kFALSE, 0., 0., 0);
+  }
+  fTrackPrefilter.Select();
+  return nTracks;
+}
+
+//________________________________________________________________________
+Bool_t AliAnalysisTaskDimu::IsSelectedPairType ( const TString& pairType ) const
+{
+  /// Check if the pair type is in the list of selected pair types
+  TPRegexp re(Form("(^|,)%s(,|$)",pairType.Data()));
+  return fSelectedPairTypes.Contains(re);
+}
+
+//________________________________________________________________________
+Int_t AliAnalysisTaskDimu::GetTrigClassId ( const TString& trigClass )
+{
+  /// Index of the trigger class, assigned when the class is first seen in the job.
+  /// The objects of the class (event counter, pair sparses) and its trigger pt-cut level
+  /// are then looked up by index
+  auto it = fTrigClassIds.find(trigClass);
+  if ( it != fTrigClassIds.end() ) return it->second;
+  Int_t id = fTrigClassNames.size();
+  fTrigClassIds[trigClass] = id;
+  fTrigClassNames.push_back(trigClass);
+  fTrigClassEvents.push_back(static_cast<TH1*>(GetMergeableObject(Form("/%s",trigClass.Data()), "nevents")));
+  fPairSparses.push_back(std::vector<THnSparse*>());
+  fTrigClassPtCutLevel.push_back(0);
+  fTrigClassIsDimuon.push_back(kFALSE);
+  SetTrigClassPtCutLevel(id);
+  return id;
+}
+
+//________________________________________________________________________
+Int_t AliAnalysisTaskDimu::GetPairTypeId ( const TString& pairType )
+{
+  /// Index of the pair type, assigned when the type is first seen in the job,
+  /// with the pair type selection and the skim index of the type
+  /// (the mixed-event pairs are not in the skim)
+  auto it = fPairTypeIds.find(pairType);
+  if ( it != fPairTypeIds.end() ) return it->second;
+  Int_t id = fPairTypeNames.size();
+  fPairTypeIds[pairType] = id;
+  fPairTypeNames.push_back(pairType);
+  fPairTypeSelected.push_back(fSelectedPairTypes.IsNull() || IsSelectedPairType(pairType));
+  fPairTypeSkimIndex.push_back(( fSkimWriter && pairType != MixedPairType() ) ? fSkimWriter->GetPairTypeIndex(pairType.Data()) : 0);
+  return id;
+}
+
+//________________________________________________________________________
+THnSparse* AliAnalysisTaskDimu::CreatePairSparse ( Int_t trigClassId, Int_t pairTypeId, Int_t icut, Int_t icharge )
+{
+  /// Get the pair sparse from the collection and keep it in the cache of the trigger class:
+  /// the identifier is built once per sparse in the job
+  Int_t nCuts = fTrackletDistCutsNames.size();
+  std::vector<THnSparse*>& sparses = fPairSparses[trigClassId];
+  size_t isparse = ( pairTypeId * nCuts + icut ) * 2 + icharge;
+  if ( isparse >= sparses.size() ) sparses.resize(( pairTypeId + 1 ) * nCuts * 2, 0x0);
+  TString identifier = Form("/%s/%s/%s/%s",fTrigClassNames[trigClassId].Data(),fTrackletDistCutsNames[icut].Data(),fPairTypeNames[pairTypeId].Data(),icharge?"SS":"OS");
+  sparses[isparse] = static_cast<THnSparse*>(GetMergeableObject(identifier, "DimuSparse"));
+  return sparses[isparse];
+}
+
+//________________________________________________________________________
+void AliAnalysisTaskDimu::SetTrigClassPtCutLevel ( Int_t trigClassId )
+{
+  /// Set the trigger pt-cut level of the trigger class and whether it is a dimuon trigger
+  /// for the current run. The generated particles have no trigger cut
+  const TString& trigClass = fTrigClassNames[trigClassId];
+  Int_t ptCutLevel = 0;
+  Bool_t isDimuon = kFALSE;
+  if ( trigClass != "generated" ) {
+    TArrayI classPtCutLevel = fMuonEventCuts.GetTrigClassPtCutLevel(trigClass);
+    ptCutLevel = classPtCutLevel[0];
+    isDimuon = ( classPtCutLevel[1] > 0 );
+  }
+  fTrigClassPtCutLevel[trigClassId] = ptCutLevel;
+  fTrigClassIsDimuon[trigClassId] = isDimuon;
+}
+
+//________________________________________________________________________
+Int_t AliAnalysisTaskDimu::GetTrigLevel ( AliVParticle* track, Int_t maxLevel )
+{
+  /// Get the highest trigger pt-cut level passed by the track, up to maxLevel.
+  /// The levels above the highest level of the trigger classes are not needed
+  /// for the pair checks (AliDimuPair::PassTrigPtCut)
+  TArrayI ptCutLevel(2);
+  ptCutLevel.Reset();
+  for ( Int_t ilevel=maxLevel; ilevel>0; --ilevel ) {
+    ptCutLevel[0] = ilevel;
+    if ( fMuonPairCuts.GetMuonTrackCuts().TrackPtCutMatchTrigClass(track,ptCutLevel) ) return ilevel;
+  }
+  return 0;
+}
+
+//________________________________________________________________________
+void AliAnalysisTaskDimu::LoadTracklets ( AliMultiplicity* mult )
+{
+  /// Get the tracklet phi and distance once per event
+  Int_t nTracklets = mult->GetNumberOfTracklets();
+  fTrackletPhi.resize(nTracklets);
+  fTrackletDist.resize(nTracklets);
+  for ( Int_t itrk=0; itrk<nTracklets; ++itrk ) {
+    fTrackletPhi[itrk] = mult->GetPhi(itrk);
+    fTrackletDist[itrk] = mult->CalcDist(itrk);
+  }
+  fTrackletsLoaded = kTRUE;
+}
+
+//________________________________________________________________________
+void AliAnalysisTaskDimu::CountTracklets ( AliMultiplicity* mult, Double_t phi, std::vector<Int_t>& nTrackletsPerCut, Int_t nCuts )
+{
+  /// Count the tracklets in the hemisphere of the pair for the first nCuts tracklet distance cuts
+  /// (all if negative).
+  /// The element nCuts is the number of tracklets without distance cut
+  if ( ! mult ) return;
+  if ( ! fTrackletsLoaded ) LoadTracklets(mult);
+  if ( nCuts < 0 ) nCuts = fTrackletDistCuts.size();
+  AliDimuPair::CountTracklets(phi, fTrackletPhi.data(), fTrackletDist.data(), fTrackletPhi.size(), fTrackletDistCuts.data(), nCuts, nTrackletsPerCut.data());
+}
+
+//________________________________________________________________________
+void AliAnalysisTaskDimu::MixEvent ( const std::vector<AliDimuMuon>& muons, const std::vector<Int_t>& trigClassIds, AliMultiplicity* mult, Double_t* containerInput, std::vector<Int_t>& nTrackletsPerCut )
+{
+  /// Pair the muons of the current event with the ones in the pool,
+  /// then add the current event to the pool.
+  /// The tracklets are counted in the current event.
+  /// The sparses are looked up by index, as for the same-event pairs
+  Int_t nMuons = muons.size();
+  if ( nMuons == 0 ) return;
+  Int_t ipool = fEventMixer->FindPool(containerInput[kHcentrality], mult ? mult->GetNumberOfTracklets() : 0);
+  if ( ipool < 0 ) return;
+
+  Int_t nPoolEvents = fEventMixer->GetNevents(ipool);
+  if ( nPoolEvents > 0 ) {
+    Int_t nTrigClasses = trigClassIds.size();
+    Int_t nCuts = fTrackletDistCutsNames.size();
+
+    // Weight looked up once per pair, unless it depends on the tracklet cut
+    Bool_t weightPerCut = fWeightMap && fWeightMap->UsesVariable(kHtracklets);
+    Double_t weight = 1.;
+
+    for ( Int_t ievent=0; ievent<nPoolEvents; ++ievent ) {
+      Int_t nPoolMuons = 0;
+      const AliDimuMuon* poolMuons = fEventMixer->GetEvent(ipool, ievent, nPoolMuons);
+      for ( Int_t imu=0; imu<nMuons; ++imu ) {
+        for ( Int_t jmu=0; jmu<nPoolMuons; ++jmu ) {
+          Int_t icharge = AliDimuPair::IsSameSign(muons[imu],poolMuons[jmu]) ? 1 : 0;
+          AliDimuPair::Kinematics(muons[imu], poolMuons[jmu], containerInput[kHvarPt], containerInput[kHvarY], containerInput[kHvarPhi], containerInput[kHvarInvMass]);
+          CountTracklets(mult, containerInput[kHvarPhi], nTrackletsPerCut);
+          if ( fWeightMap && ! weightPerCut ) weight = fWeightMap->GetWeight(containerInput);
+          for ( Int_t itrig=0; itrig<nTrigClasses; ++itrig ) {
+            Int_t trigClassId = trigClassIds[itrig];
+            if ( ! AliDimuPair::PassTrigPtCut(muons[imu].fTrigLevel, poolMuons[jmu].fTrigLevel, fTrigClassPtCutLevel[trigClassId], fTrigClassIsDimuon[trigClassId]) ) continue;
+            for ( Int_t icut=0; icut<nCuts; ++icut ) {
+              containerInput[kHtracklets] = nTrackletsPerCut[icut];
+              if ( weightPerCut ) weight = fWeightMap->GetWeight(containerInput);
+              GetPairSparse(trigClassId, fMixedPairTypeId, icut, icharge)->Fill(containerInput,weight);
+            } // loop on tracklet cuts
+          } // loop on trigger classes
+        } // loop on pool muons
+      } // loop on muons
+    } // loop on pool events
+  }
+
+  fEventMixer->AddEvent(ipool, muons.data(), nMuons);
+}
+
+//________________________________________________________________________
+void AliAnalysisTaskDimu::SelectExecVariant ()
+{
+  /// Choose the specialization of the event loop for the current run:
+  /// MC or data, pair type selection.
+  /// Configure the track prefilter and the track access (AOD fast path)
+  /// and set the trigger pt-cut levels of the known trigger classes for the run
+  /// (at the first event, once the event cuts are set for the run)
+  Bool_t isMC = ( MCEvent() != 0x0 );
+  Bool_t hasPairSelection = ! fSelectedPairTypes.IsNull();
+  fExecVariant = ( isMC ? 2 : 0 ) + ( hasPairSelection ? 1 : 0 );
+  for ( size_t itrig=0; itrig<fTrigClassNames.size(); ++itrig ) SetTrigClassPtCutLevel(itrig);
+
+  // Prefilter with the cuts of the filter mask of the track cuts
+  UInt_t filterMask = fMuonPairCuts.GetMuonTrackCuts().GetFilterMask();
+  fTrackPrefilter.Configure(filterMask);
+
+  // Direct access to the AOD tracks.
+  // The track cuts reject the tracks that are not muon tracks unless no cut is applied
+  fAODFastPath = fUseAODFastPath && AliAnalysisMuonUtility::IsAODEvent(InputEvent());
+  fMuonTracksOnly = ( filterMask != 0 );
+  AliInfo(Form("Event loop: %s, %s pair selection, %s tracks",isMC?"MC":"data",hasPairSelection?"with":"no",fAODFastPath?"direct AOD":"generic"));
+}
+
+//________________________________________________________________________
+template <Bool_t isMC, Bool_t hasPairSelection>
+Int_t AliAnalysisTaskDimu::ProcessSteps ( const TObjArray* selectTrigClasses, AliMultiplicity* mult, const std::vector<TString>& trackletDistCutsName, std::vector<Int_t>& nTrackletsPerCut, Double_t* containerInput, Long64_t& stageTime )
+{
+  /// Process the reconstructed tracks and, in MC, the generated particles.
+  /// Returns the number of muon candidates
+  Int_t nCandidates = ProcessStep<isMC,hasPairSelection,kStepReconstructed>(selectTrigClasses, mult, trackletDistCutsName, nTrackletsPerCut, containerInput, stageTime);
+  if ( isMC ) ProcessStep<isMC,hasPairSelection,kStepGeneratedMC>(selectTrigClasses, mult, trackletDistCutsName, nTrackletsPerCut, containerInput, stageTime);
+  return nCandidates;
+}
+
+//________________________________________________________________________
+template <Bool_t isMC, Bool_t hasPairSelection, Int_t step>
+Int_t AliAnalysisTaskDimu::ProcessStep ( const TObjArray* selectTrigClasses, AliMultiplicity* mult, const std::vector<TString>& trackletDistCutsName, std::vector<Int_t>& nTrackletsPerCut, Double_t* containerInput, Long64_t& stageTime )
+{
+  /// Select the tracks of the step and fill the pairs.
+  /// The configuration is known at compile time, so that the data
+  /// and the reconstructed step have no branches for the MC and the disabled features.
+  /// Returns the number of tracks of the step
+  // Trigger classes by index: the objects and the pt-cut levels of the classes are cached
+  std::vector<Int_t> trigClassIds;
+  if ( step == kStepReconstructed ) {
+    TIter nextTrig(selectTrigClasses);
+    TObject* obj;
+    while ( (obj = nextTrig()) ) trigClassIds.push_back(GetTrigClassId(obj->GetName()));
+  }
+  else trigClassIds.push_back(GetTrigClassId("generated"));
+
+  for ( Int_t trigClassId : trigClassIds ) fTrigClassEvents[trigClassId]->Fill(1.);
+
+  // Reconstructed tracks: list of the candidates and batch prefilter.
+  // Only the tracks that pass the prefilter are checked with the full track cuts
+  // (all of them in the cross-check mode)
+  stageTime = AliDimuStageTimers::Now();
+  Int_t nTracks = ( step == kStepReconstructed ) ? LoadRecoTracks() : MCEvent()->GetNumberOfTracks();
+  Int_t nStepTracks = ( step == kStepReconstructed ) ? (Int_t)fRecoTracks.size() : nTracks;
+  fTimers.Count(AliDimuStageTimers::kCandidates, nTracks);
+  Bool_t usePrefilter = ( step == kStepReconstructed && fUseTrackPrefilter );
+  // AOD fast path: the compact muons are already built, with the trigger matching level
+  Bool_t useAODMuons = ( step == kStepReconstructed && fAODFastPath );
+
+  // First select tracks
+  TObjArray selectedTracks(nStepTracks);
+  selectedTracks.SetOwner();
+  std::vector<AliDimuMuon> selectedMuons;
+  Int_t nSelected = 0;
+  AliTrackMore* trackMore = 0x0, *trackMore2 = 0x0;
+  AliVParticle* track = 0x0, *track2 = 0x0;
+  for (Int_t itrack = 0; itrack < nStepTracks; itrack++) {
+    if ( usePrefilter && ! fTrackPrefilterCheck && ! fTrackPrefilter.Pass(itrack) ) continue;
+    track = ( step == kStepReconstructed ) ? fRecoTracks[itrack] : MCEvent()->GetTrack(itrack);
+
+    // In case of MC we usually ask that the particle is a muon
+    // However, in W or Z simulations, Pythia stores both the initial muon
+    // (before ISR, FSR and kt kick) and the final state one.
+    // The first muon is of course there only for information and should be rejected.
+    // The Pythia code for initial state particles is 21
+    // When running with POWHEG, Pythia puts the hard process input of POWHEG in the stack
+    // with state 21, and then re-add it to stack before applying ISR, FSR and kt kick.
+    // This muon produces the final state muon, and its status code is 11
+    // To avoid all problems, keep only final state muon (status code <10)
+    // FIXME: is the convention valid for other generators as well?
+    Bool_t isSelected = ( step == kStepReconstructed ) ? fMuonPairCuts.GetMuonTrackCuts().IsSelected(track) : ( TMath::Abs(track->PdgCode()) == 13 && AliAnalysisMuonUtility::GetStatusCode(track) < 10 ) && track->Eta() < -2.5 && track->Eta() > -4.;
+    if ( usePrefilter && fTrackPrefilterCheck && isSelected && ! fTrackPrefilter.Pass(itrack) ) {
+      if ( fTrackPrefilterMismatches++ < 10 ) AliError(Form("Track %i of entry %lld selected but rejected by the prefilter (eta %g theta_abs %g match %i)",itrack,Entry(),track->Eta(),AliAnalysisMuonUtility::GetThetaAbsDeg(track),AliAnalysisMuonUtility::GetMatchTrigger(track)));
+    }
+    if ( ! isSelected ) continue;
+    stageTime = fTimers.Stop(AliDimuStageTimers::kTrackSelection, stageTime);
+
+    // Add per trigger information
+    trackMore = new AliTrackMore(track);
+    if ( isMC ) trackMore->SetParticleType(fUtilityDimuonSource.GetParticleType(track,MCEvent()));
+    else {
+      // Without MC the source is the same for all tracks: classify the first one of the run
+      if ( ! fDataParticleTypeCached ) {
+        fDataParticleType = fUtilityDimuonSource.GetParticleType(track,0x0);
+        fDataParticleTypeCached = kTRUE;
+      }
+      trackMore->SetParticleType(fDataParticleType);
+    }
+    if ( isMC ) trackMore->SetHistory(AliAnalysisMuonUtility::GetTrackHistory(track,MCEvent()));
+    trackMore->SetLabel((step==kStepReconstructed)?track->GetLabel():itrack);
+    stageTime = fTimers.Stop(AliDimuStageTimers::kParticleType, stageTime);
+    // if ( step == kStepReconstructed ) {
+    //   for ( auto& trigClassId : trigClassIds ) {
+    //     if ( fMuonPairCuts.GetMuonTrackCuts().TrackPtCutMatchTrigClass(track,fMuonEventCuts.GetTrigClassPtCutLevel(trigClass)) ) trackMore->SetPassTrigClassCut(itrig);
+    //   }
+    // }
+
+    if ( useAODMuons ) selectedMuons.push_back(fAODMuons.GetMuon(itrack));
+    else {
+      AliDimuMuon muon;
+      Double_t trackP = track->P();
+      muon.Set(track->Px(), track->Py(), track->Pz(), TMath::Sqrt(trackP*trackP + AliAnalysisMuonUtility::MuonMass2()), track->Charge(), 0);
+      selectedMuons.push_back(muon);
+    }
+
+    selectedTracks[nSelected++] = trackMore;
+  } // loop on tracks
+
+  // Trigger pt-cut levels of the selected trigger classes (per run, by index):
+  // the pair check is a comparison with the levels of the muons
+  const Int_t nTrigClasses = trigClassIds.size();
+  if ( step == kStepReconstructed ) {
+    // The trigger level of the muons is only needed for the pairs of the event,
+    // up to the highest level of its classes, or, in full, for the mixing pools and the skim
+    Int_t maxLevel = 0;
+    if ( fEventMixer || fSkimWriter ) maxLevel = 3;
+    else if ( nSelected >= 2 ) {
+      for ( Int_t itrig=0; itrig<nTrigClasses; ++itrig ) maxLevel = TMath::Max(maxLevel,fTrigClassPtCutLevel[trigClassIds[itrig]]);
+    }
+    // AOD fast path without sharp pt cut in the matching: the level passed
+    // is the trigger matching level read with the muon (as in TrackPtCutMatchTrigClass)
+    Bool_t isMatchLevel = ( useAODMuons && ! fMuonPairCuts.GetMuonTrackCuts().IsApplySharpPtCutInMatching() );
+    for ( Int_t imu=0; imu<nSelected; ++imu ) {
+      if ( isMatchLevel ) selectedMuons[imu].fTrigLevel = TMath::Min((Int_t)selectedMuons[imu].fTrigLevel, maxLevel);
+      else selectedMuons[imu].fTrigLevel = ( maxLevel > 0 ) ? GetTrigLevel(static_cast<AliTrackMore*>(selectedTracks.UncheckedAt(imu))->GetTrack(), maxLevel) : 0;
+    }
+  }
+  if ( fSkimWriter ) {
+    for ( Int_t imu=0; imu<nSelected; ++imu ) {
+      trackMore = static_cast<AliTrackMore*>(selectedTracks.UncheckedAt(imu));
+      fSkimWriter->AddMuon(selectedMuons[imu], step, trackMore->GetParticleType(), trackMore->GetLabel());
+    }
+  }
+  stageTime = fTimers.Stop(AliDimuStageTimers::kTrackSelection, stageTime);
+  fTimers.Count(AliDimuStageTimers::kSelectedMuons, nSelected);
+
+  if ( fEventMixer && step == kStepReconstructed ) {
+    MixEvent(selectedMuons, trigClassIds, mult, containerInput, nTrackletsPerCut);
+    stageTime = fTimers.Stop(AliDimuStageTimers::kEventMixing, stageTime);
+  }
+
+  if ( nSelected < 2 ) return nTracks;
+
+  // Tracklet distance cuts, then the count without cut
+  const Int_t nTrackletDistCuts = fTrackletDistCuts.size();
+  const Int_t nCuts = nTrackletDistCuts+1;
+
+  // Weight looked up once per pair, unless it depends on the tracklet cut
+  Bool_t applyWeight = fWeightMap && ( step == kStepReconstructed || fWeightGenerated );
+  Bool_t weightPerCut = applyWeight && fWeightMap->UsesVariable(kHtracklets);
+  Double_t weight = 1.;
+
+  // Pair sources: in data, the ones of the first pair of the job
+  Int_t pairTypeId = isMC ? -1 : fDataPairTypeId;
+  Int_t commonAncestor = isMC ? -1 : fDataCommonAncestor;
+
+  // Loop on selected tracks
+  for ( Int_t itrack=0; itrack<nSelected; itrack++) {
+    trackMore = static_cast<AliTrackMore*>(selectedTracks.UncheckedAt(itrack));
+    track = trackMore->GetTrack();
+
+    // Check dimuons
+    for ( Int_t jtrack=itrack+1; jtrack<nSelected; jtrack++ ) {
+      trackMore2 = static_cast<AliTrackMore*>(selectedTracks.UncheckedAt(jtrack));
+      track2 = trackMore2->GetTrack();
+      // if ( track->Charge() * track2->Charge() >= 0 ) continue;
+      Int_t icharge = AliDimuPair::IsSameSign(selectedMuons[itrack],selectedMuons[jtrack]) ? 1 : 0;
+
+      if ( isMC ) {
+        commonAncestor = fUtilityDimuonSource.GetCommonAncestor(track,track2,MCEvent());
+        pairTypeId = GetPairTypeId(fUtilityDimuonSource.GetPairType(trackMore->GetParticleType(), trackMore2->GetParticleType(), commonAncestor, MCEvent()));
+      }
+      else if ( pairTypeId < 0 ) {
+        // Without MC the pair type is the same for all pairs: classify the first one of the job
+        // with the utility, so that the identifiers and the pair selection use its name
+        fDataCommonAncestor = fUtilityDimuonSource.GetCommonAncestor(track,track2,0x0);
+        fDataPairTypeId = GetPairTypeId(fUtilityDimuonSource.GetPairType(trackMore->GetParticleType(), trackMore2->GetParticleType(), fDataCommonAncestor, 0x0));
+        pairTypeId = fDataPairTypeId;
+        commonAncestor = fDataCommonAncestor;
+      }
+      if ( fSkimWriter ) fSkimWriter->AddPair(fPairTypeSkimIndex[pairTypeId], commonAncestor);
+      Bool_t isSelectedPair = hasPairSelection ? fPairTypeSelected[pairTypeId] : kTRUE;
+      stageTime = fTimers.Stop(AliDimuStageTimers::kPairClassification, stageTime);
+      if ( ! isSelectedPair ) continue;
+      fTimers.Count(AliDimuStageTimers::kPairs);
+
+      AliDimuPair::Kinematics(selectedMuons[itrack], selectedMuons[jtrack], containerInput[kHvarPt], containerInput[kHvarY], containerInput[kHvarPhi], containerInput[kHvarInvMass]);
+      // The weight does not depend on the tracklets here
+      if ( applyWeight && ! weightPerCut ) weight = fWeightMap->GetWeight(containerInput);
+      stageTime = fTimers.Stop(AliDimuStageTimers::kPairKinematics, stageTime);
+
+      CountTracklets(mult, containerInput[kHvarPhi], nTrackletsPerCut, nTrackletDistCuts);
+      stageTime = fTimers.Stop(AliDimuStageTimers::kTrackletCounting, stageTime);
+
+      AliDebug(1,Form("Srcs: %i %i  ancestor %i Type %s\n%s\n%s\n",trackMore->GetParticleType(), trackMore2->GetParticleType(), commonAncestor, fPairTypeNames[pairTypeId].Data(), trackMore->GetHistory().Data(), trackMore2->GetHistory().Data()));
+
+      for ( Int_t itrig=0; itrig<nTrigClasses; ++itrig ) {
+        if ( step == kStepReconstructed ) {
+          Int_t trigClassId = trigClassIds[itrig];
+          if ( ! AliDimuPair::PassTrigPtCut(selectedMuons[itrack].fTrigLevel, selectedMuons[jtrack].fTrigLevel, fTrigClassPtCutLevel[trigClassId], fTrigClassIsDimuon[trigClassId]) ) continue;
+        }
+        for ( Int_t icut=0; icut<nCuts; ++icut ) {
+          containerInput[kHtracklets] = nTrackletsPerCut[icut];
+          if ( applyWeight && weightPerCut ) weight = fWeightMap->GetWeight(containerInput);
+          GetPairSparse(trigClassIds[itrig], pairTypeId, icut, icharge)->Fill(containerInput,weight);
+          fTimers.Count(AliDimuStageTimers::kFills);
+        } // loop on tracklets cuts
+      } // loop on selected trigger classes
+      stageTime = fTimers.Stop(AliDimuStageTimers::kFill, stageTime);
+    } // loop on second track
+  } // loop on tracks
+
+  return nTracks;
+}
+
 //________________________________________________________________________
 void AliAnalysisTaskDimu::UserExec ( Option_t * /*option*/ )
 {
@@ -234,247 +1059,400 @@ void AliAnalysisTaskDimu::UserExec ( Option_t * /*option*/ )
   /// Fill output objects
   //
 
-  if ( ! fMuonEventCuts.IsSelected(fInputHandler) ) return;
+  if ( fDryRunEvents > 0 && fDryRunStop && fDryRunProcessed >= fDryRunEvents ) return;
+
+  // Stage timers: each Stop returns the start time of the next stage
+  Long64_t startTime = AliDimuStageTimers::Now();
+  if ( fDryRunEvents > 0 && fDryRunProcessed == 0 ) {
+    fDryRunStartTime = startTime;
+    fDryRunStartCpu = (Double_t)std::clock() / CLOCKS_PER_SEC;
+  }
+  fTimers.BeginEvent();
+  fTimers.Count(AliDimuStageTimers::kEvents);
+  Bool_t isSelectedEvent = fMuonEventCuts.IsSelected(fInputHandler);
+  Long64_t stageTime = fTimers.Stop(AliDimuStageTimers::kEventCuts, startTime);
+  if ( ! isSelectedEvent ) {
+    EndEventTimers(startTime, 0, 0x0);
+    return;
+  }
+  fTimers.Count(AliDimuStageTimers::kSelectedEvents);
 
   AliMultiplicity* mult = dynamic_cast<AliMultiplicity*>(InputEvent()->GetMultiplicity());
+  fTrackletsLoaded = kFALSE;
   int nTrackletDistCuts = fTrackletDistCuts.size();
   std::vector<Int_t> nTrackletsPerCut(nTrackletDistCuts+1,0);
-  std::vector<TString> trackletDistCutsName;
-  for ( auto & val : fTrackletDistCuts ) {
-    trackletDistCutsName.push_back(Form("trackletDistCuts_%g",val));
-  }
-  trackletDistCutsName.push_back(Form("trackletDistCuts_none"));
+  const std::vector<TString>& trackletDistCutsName = fTrackletDistCutsNames;
 
   const TObjArray* selectTrigClasses = fMuonEventCuts.GetSelectedTrigClassesInEvent(fInputHandler);
 
   Double_t containerInput[kNvars];
   containerInput[kHcentrality] = fMuonEventCuts.GetCentrality(InputEvent());
-  AliTrackMore* trackMore = 0x0, *trackMore2 = 0x0;
-  AliVParticle* track = 0x0, *track2 = 0x0;
-
-  Int_t nSteps = MCEvent() ? 2 : 1;
-  for ( Int_t istep = 0; istep<nSteps; ++istep ) {
-    std::vector<TString> selTrigClasses;
-    if ( istep == kStepReconstructed ) {
-      TIter nextTrig(selectTrigClasses);
-      TObject* obj;
-      while ( (obj = nextTrig()) ) selTrigClasses.push_back(obj->GetName());
-    }
-    else selTrigClasses.push_back("generated");
 
-    for ( auto& trigClass : selTrigClasses ) {
-      TString identifier = Form("/%s",trigClass.Data());
-      static_cast<TH1*>(GetMergeableObject(identifier, "nevents"))->Fill(1.);
-    }
+  // Event loop specialized for the configuration of the run
+  // (chosen before the skim event, which needs the trigger pt-cut levels of the run)
+  if ( fExecVariant < 0 ) SelectExecVariant();
+  if ( fSkimWriter ) {
+    stageTime = AliDimuStageTimers::Now();
+    BeginSkimEvent(selectTrigClasses, containerInput[kHcentrality]);
+    fTimers.Stop(AliDimuStageTimers::kSkim, stageTime);
+  }
+  static const ProcessStepsFunc kProcessSteps[4] = {
+    &AliAnalysisTaskDimu::ProcessSteps<kFALSE,kFALSE>,
+    &AliAnalysisTaskDimu::ProcessSteps<kFALSE,kTRUE>,
+    &AliAnalysisTaskDimu::ProcessSteps<kTRUE,kFALSE>,
+    &AliAnalysisTaskDimu::ProcessSteps<kTRUE,kTRUE>
+  };
+  Int_t nCandidates = (this->*kProcessSteps[fExecVariant])(selectTrigClasses, mult, trackletDistCutsName, nTrackletsPerCut, containerInput, stageTime);
+
+  if ( fSkimWriter ) {
+    stageTime = AliDimuStageTimers::Now();
+    EndSkimEvent(mult);
+    fTimers.Stop(AliDimuStageTimers::kSkim, stageTime);
+  }
+  EndEventTimers(startTime, nCandidates, mult);
 
-    Int_t nTracks = ( istep == kStepReconstructed ) ? AliAnalysisMuonUtility::GetNTracks(InputEvent()) : MCEvent()->GetNumberOfTracks();
-
-
-    // First select tracks
-    TObjArray selectedTracks(nTracks);
-    selectedTracks.SetOwner();
-    Int_t nSelected = 0;
-    for (Int_t itrack = 0; itrack < nTracks; itrack++) {
-      track = ( istep == kStepReconstructed ) ? AliAnalysisMuonUtility::GetTrack(itrack,InputEvent()) : MCEvent()->GetTrack(itrack);
-
-      // In case of MC we usually ask that the particle is a muon
-      // However, in W or Z simulations, Pythia stores both the initial muon
-      // (before ISR, FSR and kt kick) and the final state one.
-      // The first muon is of course there only for information and should be rejected.
-      // The Pythia code for initial state particles is 21
-      // When running with POWHEG, Pythia puts the hard process input of POWHEG in the stack
-      // with state 21, and then re-add it to stack before applying ISR, FSR and kt kick.
-      // This muon produces the final state muon, and its status code is 11
-      // To avoid all problems, keep only final state muon (status code <10)
-      // FIXME: is the convention valid for other generators as well?
-      Bool_t isSelected = ( istep == kStepReconstructed ) ? fMuonPairCuts.GetMuonTrackCuts().IsSelected(track) : ( TMath::Abs(track->PdgCode()) == 13 && AliAnalysisMuonUtility::GetStatusCode(track) < 10 ) && track->Eta() < -2.5 && track->Eta() > -4.;
-      if ( ! isSelected ) continue;
-
-      // Add per trigger information
-      trackMore = new AliTrackMore(track);
-      trackMore->SetParticleType(fUtilityDimuonSource.GetParticleType(track,MCEvent()));
-      trackMore->SetHistory(AliAnalysisMuonUtility::GetTrackHistory(track,MCEvent()));
-      trackMore->SetLabel((istep==kStepReconstructed)?track->GetLabel():itrack);
-      // if ( istep == kStepReconstructed ) {
-      //   for ( auto& trigClass : selTrigClasses ) {
-      //     if ( fMuonPairCuts.GetMuonTrackCuts().TrackPtCutMatchTrigClass(track,fMuonEventCuts.GetTrigClassPtCutLevel(trigClass)) ) trackMore->SetPassTrigClassCut(itrig);
-      //   }
-      // }
-
-      selectedTracks[nSelected++] = trackMore;
-    } // loop on tracks
-
-    if ( nSelected < 2 ) continue;
-
-    // Loop on selected tracks
-    for ( Int_t itrack=0; itrack<nSelected; itrack++) {
-      trackMore = static_cast<AliTrackMore*>(selectedTracks.UncheckedAt(itrack));
-      track = trackMore->GetTrack();
-
-      // Check dimuons
-      for ( Int_t jtrack=itrack+1; jtrack<nSelected; jtrack++ ) {
-        trackMore2 = static_cast<AliTrackMore*>(selectedTracks.UncheckedAt(jtrack));
-        track2 = trackMore2->GetTrack();
-        // if ( track->Charge() * track2->Charge() >= 0 ) continue;
-        TString chargeType = ( track->Charge() * track2->Charge() >= 0 ) ? "SS" : "OS";
-
-        Int_t commonAncestor = fUtilityDimuonSource.GetCommonAncestor(track,track2,MCEvent());
-        TString pairType = fUtilityDimuonSource.GetPairType(trackMore->GetParticleType(), trackMore2->GetParticleType(), commonAncestor, MCEvent());
-
-        if ( ! fSelectedPairTypes.IsNull() ) {
-          TPRegexp re(Form("(^|,)%s(,|$)",pairType.Data()));
-          if ( ! fSelectedPairTypes.Contains(re) ) continue;
-        }
+  PostData(1,fMergeableCollection);
+}
 
-        TLorentzVector dimuPair = AliAnalysisMuonUtility::GetTrackPair(track,track2);
-
-        Double_t phi = dimuPair.Phi();
-
-        if ( phi < 0. ) phi += 2.*TMath::Pi(); // phi in [0,2pi]
-
-        containerInput[kHvarPt]         = dimuPair.Pt();
-        containerInput[kHvarY]          = dimuPair.Rapidity();
-        containerInput[kHvarPhi]        = phi;
-        containerInput[kHvarInvMass]    = dimuPair.M();
-
-        if ( mult ) {
-          std::fill(nTrackletsPerCut.begin(), nTrackletsPerCut.end(), 0);
-          Int_t nTracklets = mult->GetNumberOfTracklets();
-          for ( Int_t itrk=0; itrk<nTracklets; ++itrk ) {
-            if ( TMath::Abs(phi - mult->GetPhi(itrk)) > TMath::Pi()/2. ) continue; // MODIFY ME!
-            Double_t dist = mult->CalcDist(itrk);
-            // printf ("Track %i  dist %g  pass:",itrk,dist); // REMEMBER TO CUT
-            for ( Int_t icut=0; icut<nTrackletDistCuts; ++icut ) {
-              // Cuts are ordered, so if it does not pass this cut
-              // it will not pass the following either
-              if ( dist > fTrackletDistCuts[icut] ) break;
-              // printf (" %g (%i)",fTrackletDistCuts[icut],nTrackletsPerCut[icut]); // REMEMBER TO CUT
-              ++nTrackletsPerCut[icut];
-            }
-            // printf("\n"); // REMEMBER TO CUT
-            ++nTrackletsPerCut[nTrackletDistCuts];
-          }
-        }
 
+//________________________________________________________________________
+void AliAnalysisTaskDimu::FindBinRange ( const TAxis* axis, Double_t xMin, Double_t xMax, Int_t& minBin, Int_t& maxBin )
+{
+  /// Bins inside [xMin, xMax]: a bin is excluded if it only touches the range at its edge
+  minBin = axis->FindFixBin(xMin);
+  if ( minBin <= axis->GetNbins() && axis->GetBinUpEdge(minBin) <= xMin + 1.e-6 * axis->GetBinWidth(minBin) ) ++minBin;
+  maxBin = axis->FindFixBin(xMax);
+  if ( maxBin >= 1 && axis->GetBinLowEdge(maxBin) >= xMax - 1.e-6 * axis->GetBinWidth(maxBin) ) --maxBin;
+}
 
-        AliDebug(1,Form("Srcs: %i %i  ancestor %i Type %s\n%s\n%s\n",trackMore->GetParticleType(), trackMore2->GetParticleType(), commonAncestor, pairType.Data(), trackMore->GetHistory().Data(), trackMore2->GetHistory().Data()));
+//________________________________________________________________________
+void AliAnalysisTaskDimu::GetEffMassRange ( const TAxis* axis, Double_t& massMin, Double_t& massMax ) const
+{
+  /// Invariant mass range of the efficiencies: the full axis unless a window is set
+  if ( fEffMassMax > fEffMassMin ) {
+    massMin = fEffMassMin;
+    massMax = fEffMassMax;
+  }
+  else {
+    massMin = axis->GetXmin();
+    massMax = axis->GetXmax();
+  }
+}
 
-        for ( auto& trigClass : selTrigClasses ) {
-          if ( istep == kStepReconstructed ) {
-            if ( ! fMuonPairCuts.TrackPtCutMatchTrigClass(track,track2,fMuonEventCuts.GetTrigClassPtCutLevel(trigClass)) ) continue;
-          }
-          for ( Int_t icut=0; icut<nTrackletDistCuts+1; ++icut ) {
-            containerInput[kHtracklets] = nTrackletsPerCut[icut];
-            TString identifier = Form("/%s/%s/%s/%s",trigClass.Data(),trackletDistCutsName[icut].Data(),pairType.Data(),chargeType.Data());
-            static_cast<THnSparse*>(GetMergeableObject(identifier, "DimuSparse"))->Fill(containerInput,1.);
-          } // loop on tracklets cuts
-        } // loop on selected trigger classes
-      } // loop on second track
-    } // loop on tracks
-  } // loop on container steps
+//________________________________________________________________________
+void AliAnalysisTaskDimu::RunJobs ( Int_t nJobs, Int_t nThreads, const std::function<void(Int_t)>& job )
+{
+  /// Run the independent jobs 0..nJobs-1 on nThreads threads (0 = number of cores)
+  if ( nThreads <= 0 ) nThreads = std::thread::hardware_concurrency();
+  nThreads = TMath::Max(TMath::Min(nThreads,nJobs),1);
+  if ( nThreads > 1 ) ROOT::EnableThreadSafety();
+  std::atomic<Int_t> nextJob(0);
+  auto worker = [&job,&nextJob,nJobs] () {
+    for ( Int_t ijob = nextJob++; ijob < nJobs; ijob = nextJob++ ) job(ijob);
+  };
+  std::vector<std::thread> threads;
+  for ( Int_t ithread=1; ithread<nThreads; ++ithread ) threads.push_back(std::thread(worker));
+  worker();
+  for ( std::thread& thread : threads ) thread.join();
+}
 
-  PostData(1,fMergeableCollection);
+//________________________________________________________________________
+THnSparse* AliAnalysisTaskDimu::ComputeEfficiencyMap ( const THnSparse* reco, const THnSparse* gen, const std::vector<Int_t>& axes, Int_t rangeAxis, Double_t rangeMin, Double_t rangeMax )
+{
+  /// Efficiency map on the given axes of the reconstructed and generated sparses,
+  /// keeping only the bins of rangeAxis in [rangeMin, rangeMax].
+  /// The filled bins of each sparse are summed by key (the bin coordinates on the axes),
+  /// then the two are joined on the key: the cost is linear in the filled bins.
+  /// The errors are binomial, as in TH1::Divide with option "B".
+  /// Only the bins with generated entries are filled.
+  Int_t nAxes = axes.size();
+  std::vector<Long64_t> radix(nAxes);
+  Long64_t nKeys = 1;
+  for ( Int_t iaxis=0; iaxis<nAxes; ++iaxis ) {
+    radix[iaxis] = nKeys;
+    nKeys *= gen->GetAxis(axes[iaxis])->GetNbins() + 2;
+  }
+  Int_t minRangeBin = 0, maxRangeBin = 0;
+  FindBinRange(gen->GetAxis(rangeAxis), rangeMin, rangeMax, minRangeBin, maxRangeBin);
+
+  // Sum of weights and of squared weights per key
+  typedef std::unordered_map<Long64_t,std::pair<Double_t,Double_t> > SumMap;
+  auto sumBins = [&] ( const THnSparse* sparse, SumMap& sums ) {
+    std::vector<Int_t> coord(sparse->GetNdimensions());
+    Bool_t hasErrors = sparse->GetCalculateErrors();
+    sums.reserve(sparse->GetNbins());
+    for ( Long64_t ibin=0; ibin<sparse->GetNbins(); ++ibin ) {
+      Double_t content = sparse->GetBinContent(ibin, coord.data());
+      if ( coord[rangeAxis] < minRangeBin || coord[rangeAxis] > maxRangeBin ) continue;
+      Long64_t key = 0;
+      for ( Int_t iaxis=0; iaxis<nAxes; ++iaxis ) key += coord[axes[iaxis]] * radix[iaxis];
+      std::pair<Double_t,Double_t>& sum = sums[key];
+      sum.first += content;
+      sum.second += hasErrors ? sparse->GetBinError2(ibin) : content;
+    }
+  };
+  SumMap recoSums, genSums;
+  sumBins(reco, recoSums);
+  sumBins(gen, genSums);
+
+  std::vector<Int_t> nBins(nAxes);
+  for ( Int_t iaxis=0; iaxis<nAxes; ++iaxis ) nBins[iaxis] = gen->GetAxis(axes[iaxis])->GetNbins();
+  THnSparse* effMap = new THnSparseF(Form("%s_EffMap",reco->GetName()), "Efficiency", nAxes, nBins.data());
+  for ( Int_t iaxis=0; iaxis<nAxes; ++iaxis ) {
+    const TAxis* axis = gen->GetAxis(axes[iaxis]);
+    std::vector<Double_t> edges(nBins[iaxis]+1);
+    for ( Int_t ibin=1; ibin<=nBins[iaxis]+1; ++ibin ) edges[ibin-1] = axis->GetBinLowEdge(ibin);
+    effMap->SetBinEdges(iaxis, edges.data());
+    effMap->GetAxis(iaxis)->SetTitle(axis->GetTitle());
+  }
+  effMap->Sumw2();
+
+  std::vector<Int_t> coord(nAxes);
+  for ( auto& genBin : genSums ) {
+    Double_t den = genBin.second.first;
+    if ( den <= 0. ) continue;
+    SumMap::const_iterator recoBin = recoSums.find(genBin.first);
+    Double_t num = ( recoBin == recoSums.end() ) ? 0. : recoBin->second.first;
+    Double_t num2 = ( recoBin == recoSums.end() ) ? 0. : recoBin->second.second;
+    Double_t eff = num / den;
+    Double_t err2 = TMath::Abs( ( 1. - 2. * eff ) * num2 + eff * eff * genBin.second.second ) / ( den * den );
+    Long64_t key = genBin.first;
+    for ( Int_t iaxis=nAxes-1; iaxis>=0; --iaxis ) {
+      coord[iaxis] = key / radix[iaxis];
+      key -= coord[iaxis] * radix[iaxis];
+    }
+    Long64_t ibin = effMap->GetBin(coord.data());
+    effMap->SetBinContent(ibin, eff);
+    effMap->SetBinError2(ibin, err2);
+  }
+  return effMap;
 }
 
+//________________________________________________________________________
+Double_t AliAnalysisTaskDimu::ProjectSparse ( const THnSparse* sparse, Int_t rangeAxis, Double_t rangeMin, Double_t rangeMax, TH1** projections )
+{
+  /// Fill the 1D projections on all the axes of the sparse with a single loop
+  /// on the filled bins, keeping only the bins of rangeAxis in [rangeMin, rangeMax].
+  /// As in THnSparse::Projection with a range, the projection on rangeAxis
+  /// only covers the bins in range.
+  /// The caller owns the projections. Returns the integral in range.
+  Int_t nDims = sparse->GetNdimensions();
+  TAxis* rangeAx = sparse->GetAxis(rangeAxis);
+  Int_t minRangeBin = rangeAx->FindBin(rangeMin);
+  Int_t maxRangeBin = rangeAx->FindBin(rangeMax);
+  std::vector<Int_t> firstBin(nDims,0);
+  std::vector<std::vector<Double_t> > contents(nDims), errors2(nDims);
+  for ( Int_t idim=0; idim<nDims; ++idim ) {
+    TAxis* axis = sparse->GetAxis(idim);
+    Int_t nBins = axis->GetNbins();
+    if ( idim == rangeAxis ) {
+      firstBin[idim] = minRangeBin - 1;
+      nBins = maxRangeBin - minRangeBin + 1;
+    }
+    contents[idim].assign(nBins+2,0.);
+    errors2[idim].assign(nBins+2,0.);
+  }
+
+  Bool_t hasErrors = sparse->GetCalculateErrors();
+  std::vector<Int_t> coord(nDims);
+  Double_t integral = 0.;
+  for ( Long64_t ibin=0; ibin<sparse->GetNbins(); ++ibin ) {
+    Double_t content = sparse->GetBinContent(ibin, coord.data());
+    if ( coord[rangeAxis] < minRangeBin || coord[rangeAxis] > maxRangeBin ) continue;
+    Double_t error2 = hasErrors ? sparse->GetBinError2(ibin) : content;
+    integral += content;
+    for ( Int_t idim=0; idim<nDims; ++idim ) {
+      Int_t jbin = coord[idim] - firstBin[idim];
+      contents[idim][jbin] += content;
+      errors2[idim][jbin] += error2;
+    }
+  }
+
+  for ( Int_t idim=0; idim<nDims; ++idim ) {
+    TAxis* axis = sparse->GetAxis(idim);
+    Int_t nBins = contents[idim].size() - 2;
+    std::vector<Double_t> edges(nBins+1);
+    for ( Int_t jbin=1; jbin<=nBins+1; ++jbin ) edges[jbin-1] = axis->GetBinLowEdge(firstBin[idim]+jbin);
+    TH1* histo = new TH1D(Form("%s_proj_%i",sparse->GetName(),idim), axis->GetTitle(), nBins, edges.data());
+    histo->SetDirectory(0);
+    histo->GetXaxis()->SetTitle(axis->GetTitle());
+    histo->Sumw2();
+    for ( Int_t jbin=0; jbin<=nBins+1; ++jbin ) {
+      histo->SetBinContent(jbin, contents[idim][jbin]);
+      histo->SetBinError(jbin, TMath::Sqrt(errors2[idim][jbin]));
+    }
+    histo->SetEntries(integral);
+    projections[idim] = histo;
+  }
+  return integral;
+}
 
 //________________________________________________________________________
 void AliAnalysisTaskDimu::Terminate(Option_t *)
 {
   //
-  /// Draw some histograms at the end.
+  /// Project the sparses and compute the efficiencies.
+  /// The results are drawn and/or written to file (see SetTerminateOutput).
   //
 
   fMergeableCollection = static_cast<AliMergeableCollection*>(GetOutputData(1));
 
   if ( ! fMergeableCollection ) return;
 
-  Int_t srcColors[] = {kBlack, kRed, kSpring, kTeal, kBlue, kViolet, kMagenta, kOrange, kGray};
-  Int_t nColors = sizeof(srcColors)/sizeof(srcColors[0]);
+  AliDimuSlowEvents* slowEvents = static_cast<AliDimuSlowEvents*>(fMergeableCollection->GetObject("/perf","slowEvents"));
+  if ( slowEvents ) slowEvents->Print();
+  fOccupancy = 0x0;
+  PrintOccupancyReport();
+
+  // Index of the identifiers that really exist (/trigClass/trackletDistCut/src/chargeType/).
+  // Each one is a projection job, writing in its own slots of the store.
+  AliDimuProjectionStore store(kNvars);
+  // The drawn histograms must survive the canvases
+  store.SetOwner(!fTerminateDraw);
+  std::vector<Int_t> jobKeys;
+  std::vector<THnSparse*> jobSparses;
+  TObjArray* identifiers = fMergeableCollection->SortAllIdentifiers();
+  TIter nextIdentifier(identifiers);
+  TObjString* identifier = 0x0;
+  while ( (identifier = static_cast<TObjString*>(nextIdentifier())) ) {
+    TObjArray* keys = identifier->String().Tokenize("/");
+    if ( keys->GetEntries() == AliDimuProjectionStore::kNkeys ) {
+      THnSparse* sparse = static_cast<THnSparse*>(fMergeableCollection->GetObject(identifier->GetName(),"DimuSparse"));
+      if ( sparse ) {
+        for ( Int_t ikey=0; ikey<AliDimuProjectionStore::kNkeys; ++ikey ) jobKeys.push_back(store.AddKey(ikey,keys->At(ikey)->GetName()));
+        jobSparses.push_back(sparse);
+      }
+    }
+    delete keys;
+  }
+  delete identifiers;
+  store.Book();
+  for ( size_t ijob=0; ijob<jobSparses.size(); ++ijob ) {
+    const Int_t* keys = &jobKeys[ijob*AliDimuProjectionStore::kNkeys];
+    store.SparseAt(keys[0],keys[1],keys[2],keys[3]) = jobSparses[ijob];
+  }
 
-  TList* trigClasses = fMergeableCollection->CreateListOfKeys(0);
-  TList* trackletDistCuts = fMergeableCollection->CreateListOfKeys(1);
-  TList* srcs = fMergeableCollection->CreateListOfKeys(2);
-  TList* chargeTypes = fMergeableCollection->CreateListOfKeys(3);
-  TIter nextClass(trigClasses);
-  TIter nextTrackletDistCut(trackletDistCuts);
-  TIter nextSrc(srcs);
-  TIter nextCharge(chargeTypes);
-  TObjString *trigClass = 0x0, *trackletDistCut = 0x0, *src = 0x0, *chargeType = 0x0;
-
-  TString genName = "generated";
-
-  THashList histoList;
-
-  while ( (trigClass = static_cast<TObjString*>(nextClass())) ) {
-    nextTrackletDistCut.Reset();
-    while ( (trackletDistCut = static_cast<TObjString*>(nextTrackletDistCut())) ) {
-      nextCharge.Reset();
-      while ( (chargeType = static_cast<TObjString*>(nextCharge())) ) {
-        nextSrc.Reset();
-        while ( (src = static_cast<TObjString*>(nextSrc()) ) ) {
-          TString identifier =  Form("/%s/%s/%s/%s",trigClass->GetName(),trackletDistCut->GetName(),src->GetName(),chargeType->GetName());
-          THnSparse* sparse = static_cast<THnSparse*>(fMergeableCollection->GetObject(Form("%s/DimuSparse",identifier.Data()))); ;
-          if ( ! sparse ) continue;
-          AliCFGridSparse gridSparse;
-          gridSparse.SetGrid(static_cast<THnSparse*>(sparse->Clone()));
-          AliAnalysisMuonUtility::SetSparseRange(&gridSparse, kHvarY, "", -3.999, -2.501);
+  Int_t nJobs = jobSparses.size();
+  RunJobs(nJobs, fTerminateThreads, [&jobSparses,&jobKeys,&store] ( Int_t ijob ) {
+    TH1* projections[kNvars];
+    const Int_t* keys = &jobKeys[ijob*AliDimuProjectionStore::kNkeys];
+    Bool_t isEmpty = ( ProjectSparse(jobSparses[ijob], kHvarY, -3.999, -2.501, projections) == 0. );
+    for ( Int_t iproj=0; iproj<kNvars; ++iproj ) {
+      if ( isEmpty ) delete projections[iproj];
+      else store.At(keys[0],keys[1],keys[2],keys[3],iproj) = projections[iproj];
+    }
+  });
+
+  // Name the projections and compute the efficiencies
+  Int_t nTrigClasses = store.GetNkeys(AliDimuProjectionStore::kTrigClass);
+  Int_t nCuts = store.GetNkeys(AliDimuProjectionStore::kTrackletDistCut);
+  Int_t nSrcs = store.GetNkeys(AliDimuProjectionStore::kSrc);
+  Int_t nChargeTypes = store.GetNkeys(AliDimuProjectionStore::kChargeType);
+  Int_t genClass = store.GetGeneratedTrigClass();
+  std::vector<MassWindowEff> massWindowEffs;
+  // The names are built once per key combination: only the projection suffix is added per histogram
+  TString projSuffix[kNvars];
+  for ( Int_t iproj=0; iproj<kNvars; ++iproj ) projSuffix[iproj] = Form("_proj%i",iproj);
+  const TString effSuffix = "_Efficiency";
+  for ( Int_t itrig=0; itrig<nTrigClasses; ++itrig ) {
+    const TString& trigName = store.GetKeyName(AliDimuProjectionStore::kTrigClass,itrig);
+    for ( Int_t icut=0; icut<nCuts; ++icut ) {
+      TString cutPrefix = trigName + "_" + store.GetKeyName(AliDimuProjectionStore::kTrackletDistCut,icut) + "_";
+      for ( Int_t icharge=0; icharge<nChargeTypes; ++icharge ) {
+        TString chargePrefix = cutPrefix + store.GetKeyName(AliDimuProjectionStore::kChargeType,icharge) + "_";
+        for ( Int_t isrc=0; isrc<nSrcs; ++isrc ) {
+          TString prefix;
           for ( Int_t iproj=0; iproj<kNvars; ++iproj ) {
-            TH1* histo = gridSparse.Project(iproj);
-            if ( histo->GetEntries() == 0 ) {
-              delete histo;
-              continue;
-            }
-            TString histoName = Form("%s_%s_%s_%s_proj%i",trigClass->GetName(),trackletDistCut->GetName(),chargeType->GetName(),src->GetName(),iproj);
+            TH1* histo = store.Get(itrig,icut,isrc,icharge,iproj);
+            if ( ! histo ) continue;
+            if ( prefix.IsNull() ) prefix = chargePrefix + store.GetKeyName(AliDimuProjectionStore::kSrc,isrc);
+            TString histoName = prefix + projSuffix[iproj];
             histo->SetName(histoName.Data());
-            histo->SetDirectory(0);
-            histo->Sumw2();
-            histoList.Add(histo);
+            if ( itrig == genClass ) continue;
+            TH1* genHisto = store.Get(genClass,icut,isrc,icharge,iproj);
+            if ( ! genHisto ) continue;
+            if ( iproj == kHvarInvMass ) {
+              TAxis* axis = histo->GetXaxis();
+              Int_t minBin = 0, maxBin = 0;
+              Double_t massMin = 0., massMax = 0.;
+              GetEffMassRange(axis, massMin, massMax);
+              FindBinRange(axis, massMin, massMax, minBin, maxBin);
+              Double_t num = histo->Integral(minBin,maxBin);
+              Double_t den = genHisto->Integral(minBin,maxBin);
+              printf("\nEff for %s in (%g<%s<%g): %g / %g = %g\n", histoName.Data(),axis->GetBinLowEdge(minBin),axis->GetTitle(),axis->GetBinUpEdge(maxBin),num,den,den==0.?0.:num/den);
+              MassWindowEff massWindowEff = { itrig, icut, isrc, icharge, axis->GetBinLowEdge(minBin), axis->GetBinUpEdge(maxBin), num, den };
+              massWindowEffs.push_back(massWindowEff);
+            }
+            TH1* effHisto = static_cast<TH1*>(histo->Clone((histoName+effSuffix).Data()));
+            // Reset maximum or the "beutify" later on will not work properly
+            effHisto->SetMaximum(-1111);
+            effHisto->Divide(genHisto);
+            store.At(itrig,icut,isrc,icharge,iproj,AliDimuProjectionStore::kEfficiency) = effHisto;
           } // loop on projections
         } // loop on sources
       } // loop on OS/SS
     } // loop on tracklet dist cuts
   } // loop on trigger classes
 
-  nextClass.Reset();
-  while ( (trigClass = static_cast<TObjString*>(nextClass())) ) {
-    nextTrackletDistCut.Reset();
-    while ( (trackletDistCut = static_cast<TObjString*>(nextTrackletDistCut())) ) {
-      nextCharge.Reset();
-      while ( (chargeType = static_cast<TObjString*>(nextCharge())) ) {
+  // Multi-dimensional efficiency maps in the mass range (only written to file)
+  if ( ! fTerminateOutput.IsNull() && genClass >= 0 && ! fEffMapAxes.empty() ) {
+    std::vector<Int_t> mapJobs;
+    for ( Int_t ijob=0; ijob<nJobs; ++ijob ) {
+      const Int_t* keys = &jobKeys[ijob*AliDimuProjectionStore::kNkeys];
+      if ( keys[0] != genClass && store.GetSparse(genClass,keys[1],keys[2],keys[3]) ) mapJobs.push_back(ijob);
+    }
+    // The generated sparse of a key is read by the threads of all the trigger classes.
+    // THnSparse::GetBinContent(bin,coord) only reads the sparse once its compact
+    // coordinate helper (fCompactCoord) exists, but it creates it on the first call:
+    // it is created here, before the threads are started
+    // (the projections above already did it for the non-empty sparses)
+    for ( Int_t imap : mapJobs ) {
+      const Int_t* keys = &jobKeys[imap*AliDimuProjectionStore::kNkeys];
+      THnSparse* gen = store.GetSparse(genClass,keys[1],keys[2],keys[3]);
+      std::vector<Int_t> coord(gen->GetNdimensions());
+      if ( gen->GetNbins() > 0 ) gen->GetBinContent(0, coord.data());
+    }
+    RunJobs(mapJobs.size(), fTerminateThreads, [this,&mapJobs,&jobKeys,&store,genClass] ( Int_t imap ) {
+      const Int_t* keys = &jobKeys[mapJobs[imap]*AliDimuProjectionStore::kNkeys];
+      THnSparse* reco = store.GetSparse(keys[0],keys[1],keys[2],keys[3]);
+      THnSparse* gen = store.GetSparse(genClass,keys[1],keys[2],keys[3]);
+      Double_t massMin = 0., massMax = 0.;
+      GetEffMassRange(gen->GetAxis(kHvarInvMass), massMin, massMax);
+      store.EffMapAt(keys[0],keys[1],keys[2],keys[3]) = ComputeEfficiencyMap(reco, gen, fEffMapAxes, kHvarInvMass, massMin, massMax);
+    });
+  }
+
+  if ( ! fTerminateOutput.IsNull() ) WriteTerminateOutput(store, massWindowEffs);
+  if ( fTerminateDraw ) DrawProjections(store);
+}
+
+//________________________________________________________________________
+void AliAnalysisTaskDimu::DrawProjections ( AliDimuProjectionStore& store )
+{
+  /// Draw the projections and the efficiencies
+  Int_t srcColors[] = {kBlack, kRed, kSpring, kTeal, kBlue, kViolet, kMagenta, kOrange, kGray};
+  Int_t nColors = sizeof(srcColors)/sizeof(srcColors[0]);
+
+  Int_t nTrigClasses = store.GetNkeys(AliDimuProjectionStore::kTrigClass);
+  Int_t nCuts = store.GetNkeys(AliDimuProjectionStore::kTrackletDistCut);
+  Int_t nSrcs = store.GetNkeys(AliDimuProjectionStore::kSrc);
+  Int_t nChargeTypes = store.GetNkeys(AliDimuProjectionStore::kChargeType);
+  for ( Int_t itrig=0; itrig<nTrigClasses; ++itrig ) {
+    for ( Int_t icut=0; icut<nCuts; ++icut ) {
+      for ( Int_t icharge=0; icharge<nChargeTypes; ++icharge ) {
+        // Canvas name built once per key combination, when the first histogram is found
+        TString canPrefix;
         for ( Int_t ieff=0; ieff<2; ieff++ ) {
-          if ( ieff == 1 && trigClass->String() == genName ) continue;
+          Int_t type = ( ieff == 0 ) ? AliDimuProjectionStore::kYield : AliDimuProjectionStore::kEfficiency;
           TCanvas* can = NULL;
           TLegend* leg = NULL;
-          nextSrc.Reset();
-          Int_t isrc = -1;
-          while ( (src = static_cast<TObjString*>(nextSrc()) ) ) {
-            ++isrc;
+          for ( Int_t isrc=0; isrc<nSrcs; ++isrc ) {
             for ( Int_t iproj=0; iproj<kNvars; ++iproj ) {
-              TString histoName = Form("%s_%s_%s_%s_proj%i",trigClass->GetName(),trackletDistCut->GetName(),chargeType->GetName(),src->GetName(),iproj);
-              TH1* histo = static_cast<TH1*>(histoList.FindObject(histoName.Data()));
+              TH1* histo = store.Get(itrig,icut,isrc,icharge,iproj,type);
               if ( ! histo ) continue;
-              if ( ieff == 1 ) {
-                TString genHistoName = histoName;
-                genHistoName.ReplaceAll(trigClass->GetName(),genName.Data());
-                TH1* genHisto = static_cast<TH1*>(histoList.FindObject(genHistoName.Data()));
-                if ( ! genHisto ) continue;
-                if ( iproj == kHvarInvMass ) {
-                  TAxis* axis = histo->GetXaxis();
-                  Int_t minBin = axis->FindBin(60.001);
-                  Int_t maxBin = axis->FindBin(119.999);
-                  Double_t num = histo->Integral(minBin,maxBin);
-                  Double_t den = genHisto->Integral(minBin,maxBin);
-                  printf("\nEff for %s in (%g<%s<%g): %g / %g = %g\n", histoName.Data(),axis->GetBinLowEdge(minBin),axis->GetTitle(),axis->GetBinUpEdge(maxBin),num,den,den==0.?0.:num/den);
-                }
-                histoName.Append("_Efficiency");
-                histo = static_cast<TH1*>(histo->Clone(histoName));
-                // Reset maximum or the "beutify" later on will not work properly
-                histo->SetMaximum(-1111);
-                histo->Divide(genHisto);
-              }
               if ( ! can ) {
-                TString canName = Form("%s_%s_%s_%s", GetName(), trigClass->GetName(), trackletDistCut->GetName(), chargeType->GetName());
-                if ( ieff == 1 ) canName.Append("_Efficiency");
+                if ( canPrefix.IsNull() ) canPrefix = Form("%s_%s_%s_%s", GetName(), store.GetKeyName(AliDimuProjectionStore::kTrigClass,itrig).Data(), store.GetKeyName(AliDimuProjectionStore::kTrackletDistCut,icut).Data(), store.GetKeyName(AliDimuProjectionStore::kChargeType,icharge).Data());
+                TString canName = ( ieff == 1 ) ? canPrefix + "_Efficiency" : canPrefix;
                 can = new TCanvas(canName.Data(),canName.Data(),200+50*ieff,100+50*ieff,800,600);
                 can->Divide(3,2);
                 leg = new TLegend(0.5,0.5,0.9,0.9);
@@ -489,13 +1467,12 @@ void AliAnalysisTaskDimu::Terminate(Option_t *)
               histo->SetMarkerStyle(20+isrc);
 
               //          histo->GetYaxis()->SetRangeUser(minY,maxY);
-              TString drawOpt = ( gPad->GetListOfPrimitives() == 0 ) ? "e" : "esames";
-              histo->Draw(drawOpt.Data());
+              histo->Draw(( gPad->GetListOfPrimitives() == 0 ) ? "e" : "esames");
               gPad->Modified();
               gPad->Update();
               TPaveStats* paveStats = static_cast<TPaveStats*>(histo->FindObject("stats"));
               if ( paveStats ) paveStats->SetTextColor(icolor);
-              if ( iproj == 0 ) leg->AddEntry(histo,src->GetName(),"lp");
+              if ( iproj == 0 ) leg->AddEntry(histo,store.GetKeyName(AliDimuProjectionStore::kSrc,isrc).Data(),"lp");
             } // loop on projections
           } // loop on srcs
 
@@ -531,10 +1508,85 @@ void AliAnalysisTaskDimu::Terminate(Option_t *)
         } // loop on yields/efficiency
       } // loop on OS/SS
     } // loop on tracklet dist cuts
-  } // loop on event type
-  delete trigClasses;
-  delete srcs;
-  delete chargeTypes;
+  } // loop on trigger classes
+}
+
+//________________________________________________________________________
+void AliAnalysisTaskDimu::WriteTerminateOutput ( const AliDimuProjectionStore& store, const std::vector<MassWindowEff>& massWindowEffs ) const
+{
+  /// Write the projections, the efficiencies and the efficiency maps in fTerminateOutput,
+  /// in directories trigClass/trackletDistCut/chargeType,
+  /// and the efficiencies in the mass window in the tree massWindowEff
+  TFile* file = TFile::Open(fTerminateOutput.Data(),"RECREATE");
+  if ( ! file || file->IsZombie() ) {
+    AliError(Form("Cannot create %s",fTerminateOutput.Data()));
+    delete file;
+    return;
+  }
+
+  Int_t nTrigClasses = store.GetNkeys(AliDimuProjectionStore::kTrigClass);
+  Int_t nCuts = store.GetNkeys(AliDimuProjectionStore::kTrackletDistCut);
+  Int_t nSrcs = store.GetNkeys(AliDimuProjectionStore::kSrc);
+  Int_t nChargeTypes = store.GetNkeys(AliDimuProjectionStore::kChargeType);
+  for ( Int_t itrig=0; itrig<nTrigClasses; ++itrig ) {
+    for ( Int_t icut=0; icut<nCuts; ++icut ) {
+      for ( Int_t icharge=0; icharge<nChargeTypes; ++icharge ) {
+        TDirectory* dir = 0x0;
+        auto GetDir = [&] () {
+          if ( dir ) return dir;
+          dir = file;
+          const TString* dirNames[3] = { &store.GetKeyName(AliDimuProjectionStore::kTrigClass,itrig), &store.GetKeyName(AliDimuProjectionStore::kTrackletDistCut,icut), &store.GetKeyName(AliDimuProjectionStore::kChargeType,icharge) };
+          for ( const TString* dirName : dirNames ) {
+            TDirectory* subDir = dir->GetDirectory(dirName->Data());
+            dir = subDir ? subDir : dir->mkdir(dirName->Data());
+          }
+          return dir;
+        };
+        for ( Int_t isrc=0; isrc<nSrcs; ++isrc ) {
+          for ( Int_t itype=0; itype<AliDimuProjectionStore::kNtypes; ++itype ) {
+            for ( Int_t iproj=0; iproj<kNvars; ++iproj ) {
+              TH1* histo = store.Get(itrig,icut,isrc,icharge,iproj,itype);
+              if ( ! histo ) continue;
+              GetDir()->WriteTObject(histo);
+            } // loop on projections
+          } // loop on types
+          THnSparse* effMap = store.GetEffMap(itrig,icut,isrc,icharge);
+          if ( effMap ) GetDir()->WriteTObject(effMap, Form("%s_%s_%s_%s_EffMap",store.GetKeyName(AliDimuProjectionStore::kTrigClass,itrig).Data(),store.GetKeyName(AliDimuProjectionStore::kTrackletDistCut,icut).Data(),store.GetKeyName(AliDimuProjectionStore::kChargeType,icharge).Data(),store.GetKeyName(AliDimuProjectionStore::kSrc,isrc).Data()));
+        } // loop on sources
+      } // loop on OS/SS
+    } // loop on tracklet dist cuts
+  } // loop on trigger classes
+
+  file->cd();
+  Char_t trigClass[256], trackletDistCut[256], src[256], chargeType[256];
+  Double_t massMin = 0., massMax = 0., num = 0., den = 0., eff = 0.;
+  TTree* tree = new TTree("massWindowEff","Efficiency in the mass window");
+  tree->Branch("trigClass",trigClass,"trigClass/C");
+  tree->Branch("trackletDistCut",trackletDistCut,"trackletDistCut/C");
+  tree->Branch("src",src,"src/C");
+  tree->Branch("chargeType",chargeType,"chargeType/C");
+  tree->Branch("massMin",&massMin,"massMin/D");
+  tree->Branch("massMax",&massMax,"massMax/D");
+  tree->Branch("num",&num,"num/D");
+  tree->Branch("den",&den,"den/D");
+  tree->Branch("eff",&eff,"eff/D");
+  for ( const MassWindowEff& massWindowEff : massWindowEffs ) {
+    strncpy(trigClass,store.GetKeyName(AliDimuProjectionStore::kTrigClass,massWindowEff.fTrigClass).Data(),sizeof(trigClass)-1);
+    strncpy(trackletDistCut,store.GetKeyName(AliDimuProjectionStore::kTrackletDistCut,massWindowEff.fTrackletDistCut).Data(),sizeof(trackletDistCut)-1);
+    strncpy(src,store.GetKeyName(AliDimuProjectionStore::kSrc,massWindowEff.fSrc).Data(),sizeof(src)-1);
+    strncpy(chargeType,store.GetKeyName(AliDimuProjectionStore::kChargeType,massWindowEff.fChargeType).Data(),sizeof(chargeType)-1);
+    trigClass[sizeof(trigClass)-1] = trackletDistCut[sizeof(trackletDistCut)-1] = src[sizeof(src)-1] = chargeType[sizeof(chargeType)-1] = '\0';
+    massMin = massWindowEff.fMassMin;
+    massMax = massWindowEff.fMassMax;
+    num = massWindowEff.fNum;
+    den = massWindowEff.fDen;
+    eff = ( den == 0. ) ? 0. : num / den;
+    tree->Fill();
+  }
+  tree->Write();
+  file->Close();
+  delete file;
+  AliInfo(Form("Terminate output written in %s",fTerminateOutput.Data()));
 }
 
 
@@ -10,16 +10,33 @@
 //  Author: Diego Stocco
 //
 
+#include <functional>
+#include <map>
 #include <vector>
 #include "TString.h"
 #include "AliAnalysisTaskSE.h"
 #include "AliMuonEventCuts.h"
 #include "AliMuonPairCuts.h"
 #include "AliUtilityDimuonSource.h"
+#include "AliDimuMuon.h"
+#include "AliDimuBinning.h"
+#include "AliDimuStageTimers.h"
+#include "AliDimuTrackPrefilter.h"
+#include "AliDimuAODMuons.h"
 
 class TObjArray;
 class THnSparse;
+class TH1;
+class TAxis;
+class AliVParticle;
 class AliMergeableCollection;
+class AliMultiplicity;
+class AliDimuEventMixer;
+class AliDimuSkimWriter;
+class AliDimuProjectionStore;
+class AliDimuWeightMap;
+class AliDimuSlowEvents;
+class AliDimuOccupancy;
 
 class AliAnalysisTaskDimu : public AliAnalysisTaskSE {
  public:
@@ -30,6 +47,7 @@ class AliAnalysisTaskDimu : public AliAnalysisTaskSE {
   virtual void UserCreateOutputObjects();
   virtual void UserExec(Option_t *option);
   virtual void NotifyRun();
+  virtual void FinishTaskOutput();
   virtual void Terminate(Option_t *option);
 
   /// Get muon event cuts
@@ -37,6 +55,10 @@ class AliAnalysisTaskDimu : public AliAnalysisTaskSE {
   /// Get muon pair cuts
   AliMuonPairCuts* GetMuonPairCuts() { return &fMuonPairCuts; }
 
+  /// Get binning of the output sparse
+  AliDimuBinning* GetBinning() { return &fBinning; }
+  Bool_t SetBinningSchema ( const char* fileName );
+
   /// Set muon event cuts
   void SetMuonEventCuts ( AliMuonEventCuts* muonEventCuts ) { fMuonEventCuts = *muonEventCuts; }
   /// Set muon pair cuts
@@ -49,6 +71,43 @@ class AliAnalysisTaskDimu : public AliAnalysisTaskSE {
 
   void SetTrackletDistCuts ( Double_t* cuts, Int_t nCuts );
 
+  void SetEventMixing ( Int_t poolDepth, Double_t* centralityEdges, Int_t nCentralityEdges, Double_t* trackletEdges, Int_t nTrackletEdges, Int_t maxMuonsPerEvent = 4 );
+
+  void SetSkimOutput ( const char* fileName, Int_t blockSize = 8192 );
+
+  /// Number of threads used in Terminate (0 = number of cores)
+  void SetTerminateThreads ( Int_t nThreads ) { fTerminateThreads = nThreads; }
+
+  /// Write the Terminate projections and efficiencies to file (nothing written if empty)
+  void SetTerminateOutput ( const char* fileName ) { fTerminateOutput = fileName; }
+  /// Draw the Terminate projections and efficiencies
+  void SetTerminateDraw ( Bool_t draw ) { fTerminateDraw = draw; }
+
+  /// Invariant mass range of the efficiencies computed in Terminate
+  /// (full range of the mass axis by default, or if massMax <= massMin)
+  void SetEfficiencyMassRange ( Double_t massMin, Double_t massMax ) { fEffMassMin = massMin; fEffMassMax = massMax; }
+  void SetEfficiencyMapAxes ( const Int_t* axes, Int_t nAxes );
+
+  void SetWeightMap ( AliDimuWeightMap* weightMap, Bool_t applyToGenerated = kFALSE );
+
+  /// Number of slowest events kept in the output (0 = none)
+  void SetSlowEvents ( Int_t maxEvents ) { fSlowEventsMax = maxEvents; }
+  /// Sample the filled bins of the sparses every nEvents events (0 = no sampling)
+  void SetOccupancySampling ( Int_t nEvents ) { fOccupancySampling = nEvents; }
+
+  void PrintOccupancyReport () const;
+
+  void SetTrackPrefilter ( Bool_t usePrefilter, Bool_t crossCheck = kFALSE );
+  /// Read the AOD muon tracks directly, in a single sweep, instead of through AliAnalysisMuonUtility (AOD input only)
+  void SetAODFastPath ( Bool_t useFastPath ) { fUseAODFastPath = useFastPath; }
+
+  void SetDryRun ( Long64_t nEvents, Long64_t datasetEvents, Bool_t stopAfter = kTRUE );
+  /// Limits of the dry-run extrapolation: merged output memory (MB) and total CPU time of the process (hours). 0 = no limit
+  void SetDryRunLimits ( Double_t maxOutputMB, Double_t maxCpuHours ) { fDryRunMaxOutputMB = maxOutputMB; fDryRunMaxCpuHours = maxCpuHours; }
+
+  static Double_t ProjectSparse ( const THnSparse* sparse, Int_t rangeAxis, Double_t rangeMin, Double_t rangeMax, TH1** projections );
+  static THnSparse* ComputeEfficiencyMap ( const THnSparse* reco, const THnSparse* gen, const std::vector<Int_t>& axes, Int_t rangeAxis, Double_t rangeMin, Double_t rangeMax );
+
   enum {
     kStepReconstructed,  ///< Reconstructed tracks
     kStepGeneratedMC,    ///< Generated tracks (MC)
@@ -56,17 +115,68 @@ class AliAnalysisTaskDimu : public AliAnalysisTaskSE {
   };
 
   enum {
-    kHvarPt,         ///< Pt
-    kHvarY,          ///< Rapidity
-    kHvarPhi,        ///< Phi
-    kHvarInvMass,    ///< Invariant mass
-    kHcentrality,    ///< event centrality
-    kHtracklets,     ///< Number of SPD tracklets
-    kNvars           ///< THnSparse dimensions
+    kHvarPt = AliDimuBinning::kPt,                ///< Pt
+    kHvarY = AliDimuBinning::kY,                  ///< Rapidity
+    kHvarPhi = AliDimuBinning::kPhi,              ///< Phi
+    kHvarInvMass = AliDimuBinning::kInvMass,      ///< Invariant mass
+    kHcentrality = AliDimuBinning::kCentrality,   ///< event centrality
+    kHtracklets = AliDimuBinning::kTracklets,     ///< Number of SPD tracklets
+    kNvars = AliDimuBinning::kNaxes               ///< THnSparse dimensions
   };
 
  private:
+  /// Efficiency in the mass window
+  struct MassWindowEff {
+    Int_t fTrigClass;       ///< Trigger class id
+    Int_t fTrackletDistCut; ///< Tracklet distance cut id
+    Int_t fSrc;             ///< Source id
+    Int_t fChargeType;      ///< Charge type id
+    Double_t fMassMin;      ///< Lower edge of the mass window
+    Double_t fMassMax;      ///< Upper edge of the mass window
+    Double_t fNum;          ///< Reconstructed
+    Double_t fDen;          ///< Generated
+  };
+
+  /// Event loop specialized for the configuration (see SelectExecVariant)
+  typedef Int_t (AliAnalysisTaskDimu::*ProcessStepsFunc) ( const TObjArray*, AliMultiplicity*, const std::vector<TString>&, std::vector<Int_t>&, Double_t*, Long64_t& );
+
+  void SelectExecVariant ();
+  template <Bool_t isMC, Bool_t hasPairSelection>
+  Int_t ProcessSteps ( const TObjArray* selectTrigClasses, AliMultiplicity* mult, const std::vector<TString>& trackletDistCutsName, std::vector<Int_t>& nTrackletsPerCut, Double_t* containerInput, Long64_t& stageTime );
+  template <Bool_t isMC, Bool_t hasPairSelection, Int_t step>
+  Int_t ProcessStep ( const TObjArray* selectTrigClasses, AliMultiplicity* mult, const std::vector<TString>& trackletDistCutsName, std::vector<Int_t>& nTrackletsPerCut, Double_t* containerInput, Long64_t& stageTime );
+
+  static void FindBinRange ( const TAxis* axis, Double_t xMin, Double_t xMax, Int_t& minBin, Int_t& maxBin );
+  void GetEffMassRange ( const TAxis* axis, Double_t& massMin, Double_t& massMax ) const;
+  static void RunJobs ( Int_t nJobs, Int_t nThreads, const std::function<void(Int_t)>& job );
+
   TObject* GetMergeableObject ( TString identifier, TString objectName );
+  void FlushStageTimers ();
+  void EndEventTimers ( Long64_t startTime, Int_t nCandidates, AliMultiplicity* mult );
+  void CheckDryRun ();
+  Int_t LoadRecoTracks ();
+  Bool_t IsSelectedPairType ( const TString& pairType ) const;
+  Int_t GetTrigClassId ( const TString& trigClass );
+  Int_t GetPairTypeId ( const TString& pairType );
+  THnSparse* CreatePairSparse ( Int_t trigClassId, Int_t pairTypeId, Int_t icut, Int_t icharge );
+  /// Pair sparse of the trigger class, pair type, tracklet cut and charge (0 = OS, 1 = SS), created at the first use
+  THnSparse* GetPairSparse ( Int_t trigClassId, Int_t pairTypeId, Int_t icut, Int_t icharge )
+  {
+    const std::vector<THnSparse*>& sparses = fPairSparses[trigClassId];
+    size_t isparse = ( pairTypeId * fTrackletDistCutsNames.size() + icut ) * 2 + icharge;
+    return ( isparse < sparses.size() && sparses[isparse] ) ? sparses[isparse] : CreatePairSparse(trigClassId, pairTypeId, icut, icharge);
+  }
+  /// Pair type of the mixed-event pairs
+  static const char* MixedPairType () { return "ME"; }
+  Int_t GetTrigLevel ( AliVParticle* track, Int_t maxLevel = 3 );
+  void SetTrigClassPtCutLevel ( Int_t trigClassId );
+  void LoadTracklets ( AliMultiplicity* mult );
+  void CountTracklets ( AliMultiplicity* mult, Double_t phi, std::vector<Int_t>& nTrackletsPerCut, Int_t nCuts = -1 );
+  void BeginSkimEvent ( const TObjArray* selectTrigClasses, Double_t centrality );
+  void EndSkimEvent ( AliMultiplicity* mult );
+  void DrawProjections ( AliDimuProjectionStore& store );
+  void WriteTerminateOutput ( const AliDimuProjectionStore& store, const std::vector<MassWindowEff>& massWindowEffs ) const;
+  void MixEvent ( const std::vector<AliDimuMuon>& muons, const std::vector<Int_t>& trigClassIds, AliMultiplicity* mult, Double_t* containerInput, std::vector<Int_t>& nTrackletsPerCut );
 
   AliAnalysisTaskDimu(const AliAnalysisTaskDimu&);
   AliAnalysisTaskDimu& operator=(const AliAnalysisTaskDimu&);
@@ -77,13 +187,74 @@ class AliAnalysisTaskDimu : public AliAnalysisTaskSE {
   TString fSelectedPairTypes; ///< Selected pair types
   AliMergeableCollection* fMergeableCollection; //!<! collection of mergeable objects
   THnSparse* fSparse; ///< CF container
+  AliDimuBinning fBinning; ///< Binning of the output sparse
   std::vector<Double_t> fTrackletDistCuts; // Number of tracklet distance cuts
+  Int_t fMixingDepth; ///< Number of events per mixing pool (0 = no mixing)
+  Int_t fMixingMaxMuons; ///< Maximum number of muons per event stored in the mixing pools
+  std::vector<Double_t> fMixingCentralityEdges; ///< Centrality bin edges of the mixing pools
+  std::vector<Double_t> fMixingTrackletEdges; ///< Tracklet bin edges of the mixing pools
+  AliDimuEventMixer* fEventMixer; //!<! Mixed-event pools
+  Int_t fMixedPairTypeId; //!<! Pair type of the mixed-event pairs (MixedPairType) in fPairTypeNames
+  TString fSkimFileName; ///< Skim output file name (no skim if empty)
+  Int_t fSkimBlockSize; ///< Number of events per skim block
+  AliDimuSkimWriter* fSkimWriter; //!<! Skim writer
+  std::vector<Double_t> fTrackletPhi; //!<! Tracklet phi in the current event
+  std::vector<Double_t> fTrackletDist; //!<! Tracklet distance in the current event
+  Bool_t fTrackletsLoaded; //!<! Tracklets of the current event are loaded
+  Int_t fExecVariant; //!<! Specialization of the event loop for the current run (-1 = to be chosen)
+  Bool_t fDataParticleTypeCached; //!<! The particle type of the data tracks is cached for the run
+  Int_t fDataParticleType; //!<! Particle type of the data tracks
+  Int_t fDataPairTypeId; //!<! Pair type of the data pairs in fPairTypeNames (-1 = not classified yet)
+  Int_t fDataCommonAncestor; //!<! Common ancestor of the data pairs
+  std::vector<TString> fTrackletDistCutsNames; //!<! Names of the tracklet distance cuts in the identifiers (last: no cut)
+  std::map<TString,Int_t> fTrigClassIds; //!<! Index of the trigger classes in fTrigClassNames
+  std::vector<TString> fTrigClassNames; //!<! Trigger classes seen in the job
+  std::vector<TH1*> fTrigClassEvents; //!<! Event counter per trigger class (in the collection)
+  std::vector<Int_t> fTrigClassPtCutLevel; //!<! Trigger pt-cut level per trigger class in the current run
+  std::vector<Bool_t> fTrigClassIsDimuon; //!<! Dimuon trigger flag per trigger class in the current run
+  std::map<TString,Int_t> fPairTypeIds; //!<! Index of the pair types in fPairTypeNames
+  std::vector<TString> fPairTypeNames; //!<! Pair types seen in the job
+  std::vector<Bool_t> fPairTypeSelected; //!<! The pair type is selected
+  std::vector<UShort_t> fPairTypeSkimIndex; //!<! Skim index of the pair type
+  std::vector<std::vector<THnSparse*> > fPairSparses; //!<! Pair sparses per trigger class, indexed by pair type, tracklet cut and charge (0x0 = not created yet)
+  Bool_t fUseTrackPrefilter; ///< Select the tracks with the batch prefilter before the track cuts
+  Bool_t fTrackPrefilterCheck; ///< Apply the track cuts to all the tracks and check the prefilter
+  AliDimuTrackPrefilter fTrackPrefilter; //!<! Batch prefilter of the tracks of the event
+  Long64_t fTrackPrefilterMismatches; //!<! Selected tracks rejected by the prefilter
+  Bool_t fUseAODFastPath; ///< Read the AOD tracks directly
+  Bool_t fAODFastPath; //!<! Direct AOD track access in the current run
+  Bool_t fMuonTracksOnly; //!<! The track cuts reject the tracks that are not muon tracks
+  std::vector<AliVParticle*> fRecoTracks; //!<! Reconstructed track candidates of the event
+  AliDimuAODMuons fAODMuons; //!<! Compact muons of the candidates read in the AOD fast path
+  Int_t fTerminateThreads; ///< Number of threads used in Terminate
+  TString fTerminateOutput; ///< Output file of Terminate
+  Bool_t fTerminateDraw; ///< Draw in Terminate
+  Double_t fEffMassMin; ///< Lower edge of the invariant mass range of the efficiencies (full axis if fEffMassMax <= fEffMassMin)
+  Double_t fEffMassMax; ///< Upper edge of the invariant mass range of the efficiencies (full axis if fEffMassMax <= fEffMassMin)
+  std::vector<Int_t> fEffMapAxes; ///< Axes of the efficiency maps
+  AliDimuWeightMap* fWeightMap; ///< Pair weights (owned: the task cannot be copied)
+  Bool_t fWeightGenerated; ///< Apply the weights to the generated pairs
+  AliDimuStageTimers fTimers; //!<! Stage timers and counters of the worker
+  Int_t fSlowEventsMax; ///< Number of slowest events kept in the output
+  TH1* fEventLatency; //!<! Processing time per event (in the collection)
+  AliDimuSlowEvents* fSlowEvents; //!<! Slowest events (in the collection)
+  Int_t fOccupancySampling; ///< Number of events between two samples of the filled bins
+  AliDimuOccupancy* fOccupancy; //!<! Growth of the filled bins (in the collection)
+  std::vector<THnSparse*> fSparseList; //!<! Sparses in order of creation (same order as the identifiers of fOccupancy)
+  std::vector<TString> fSparseIdentifiers; //!<! Identifiers of fSparseList
+  Long64_t fDryRunEvents; ///< Number of events of the dry run (0 = no dry run)
+  Long64_t fDryRunDatasetEvents; ///< Number of events of the dataset (extrapolation target)
+  Bool_t fDryRunStop; ///< Skip the events after the dry run
+  Double_t fDryRunMaxOutputMB; ///< Maximum extrapolated memory of the merged output (MB)
+  Double_t fDryRunMaxCpuHours; ///< Maximum extrapolated CPU time (hours)
+  Long64_t fDryRunProcessed; //!<! Events processed in the dry run
+  Long64_t fDryRunStartTime; //!<! Start of the dry run (ns)
+  Double_t fDryRunStartCpu; //!<! CPU time of the process at the start of the dry run (s)
+  std::vector<Long64_t> fDryRunHalfBins; //!<! Filled bins per sparse at half of the dry run
 
-  ClassDef(AliAnalysisTaskDimu, 1); // Muon pair analysis
+  ClassDef(AliAnalysisTaskDimu, 13); // Muon pair analysis
 };
 
-class AliVParticle;
-
 class AliTrackMore : public TObject
 {
 public:
@@ -0,0 +1,69 @@
+#ifndef ALIDIMUAODMUONS_H
+#define ALIDIMUAODMUONS_H
+
+/* $Id$ */
+
+//
+// AliDimuAODMuons
+// Muon track candidates of an AOD event read in a single sweep
+//
+//  Author: Diego Stocco
+//
+
+#include <vector>
+#include "TMath.h"
+#include "AliAODEvent.h"
+#include "AliAODTrack.h"
+#include "AliAnalysisMuonUtility.h"
+#include "AliDimuMuon.h"
+#include "AliDimuTrackPrefilter.h"
+
+/// AOD fast path of AliAnalysisTaskDimu: the track candidates are read once,
+/// with the non-virtual AliAODTrack accessors and without the ESD/AOD checks of
+/// AliAnalysisMuonUtility. The same sweep fills the compact muon (kinematics with
+/// the muon mass, trigger matching level in fTrigLevel) and the track prefilter.
+/// The full track cuts (pDCA, chi2, sharp pt cut) are still applied to the candidates
+/// with AliMuonTrackCuts::IsSelected
+class AliDimuAODMuons {
+ public:
+  AliDimuAODMuons() : fMuons() {}
+
+  /// Read the tracks of the event: only the muon tracks are candidates if muonTracksOnly.
+  /// The candidates are added to tracks (cleared first) and, if prefilter is set,
+  /// the prefilter is evaluated on them. Returns the number of tracks of the event
+  Int_t Load ( const AliAODEvent* aod, Bool_t muonTracksOnly, std::vector<AliVParticle*>& tracks, AliDimuTrackPrefilter* prefilter )
+  {
+    const Double_t muonMass2 = AliAnalysisMuonUtility::MuonMass2();
+    Int_t nTracks = aod->GetNumberOfTracks();
+    tracks.clear();
+    fMuons.clear();
+    if ( prefilter ) prefilter->Resize(nTracks);
+    for ( Int_t itrack=0; itrack<nTracks; ++itrack ) {
+      AliAODTrack* track = static_cast<AliAODTrack*>(aod->GetTrack(itrack));
+      Bool_t isMuon = track->IsMuonTrack();
+      if ( muonTracksOnly && ! isMuon ) continue;
+      Int_t matchTrigger = track->GetMatchTrigger();
+      if ( prefilter ) prefilter->SetTrack(tracks.size(), isMuon, track->AliAODTrack::Eta(), AliDimuTrackPrefilter::GetThetaAbsDeg(track->GetRAtAbsorberEnd()), matchTrigger);
+      Double_t px = track->AliAODTrack::Px(), py = track->AliAODTrack::Py(), pz = track->AliAODTrack::Pz();
+      AliDimuMuon muon;
+      muon.Set(px, py, pz, TMath::Sqrt(px*px + py*py + pz*pz + muonMass2), track->AliAODTrack::Charge(), matchTrigger);
+      fMuons.push_back(muon);
+      tracks.push_back(track);
+    }
+    if ( prefilter ) {
+      prefilter->Resize(tracks.size());
+      prefilter->Select();
+    }
+    return nTracks;
+  }
+
+  /// Number of candidates
+  Int_t GetNcandidates () const { return fMuons.size(); }
+  /// Compact muon of the candidate: fTrigLevel is the trigger matching level
+  const AliDimuMuon& GetMuon ( Int_t icand ) const { return fMuons[icand]; }
+
+ private:
+  std::vector<AliDimuMuon> fMuons; ///< Compact muons of the candidates
+};
+
+#endif
@@ -0,0 +1,236 @@
+/**************************************************************************
+ * Copyright(c) 1998-2007, ALICE Experiment at CERN, All rights reserved. *
+ *                                                                        *
+ * Author: The ALICE Off-line Project.                                    *
+ * Contributors are mentioned in the code where appropriate.              *
+ *                                                                        *
+ * Permission to use, copy, modify and distribute this software and its   *
+ * documentation strictly for non-commercial purposes is hereby granted   *
+ * without fee, provided that the above copyright notice appears in all   *
+ * copies and that both the copyright notice and this permission notice   *
+ * appear in the supporting documentation. The authors make no claims     *
+ * about the suitability of this software for any purpose. It is          *
+ * provided "as is" without express or implied warranty.                  *
+ **************************************************************************/
+
+/* $Id$ */
+
+//-----------------------------------------------------------------------------
+/// \class AliDimuBinning
+/// Binning of the axes of the dimuon sparse.
+/// It is shared by AliAnalysisTaskDimu and by the skim re-analysis,
+/// so that they produce identical outputs.
+/// The default is the binning of the task.
+///
+/// \author Diego Stocco
+//-----------------------------------------------------------------------------
+
+#include "AliDimuBinning.h"
+
+#include <fstream>
+#include <string>
+#include "TMath.h"
+#include "TObjArray.h"
+#include "TObjString.h"
+#include "THnSparse.h"
+#include "TAxis.h"
+
+/// \cond CLASSIMP
+ClassImp(AliDimuBinning) // Class implementation in ROOT context
+/// \endcond
+
+//________________________________________________________________________
+AliDimuBinning::AliDimuBinning() :
+TObject(),
+fEdges(kNaxes),
+fTitles(kNaxes)
+{
+  /// Default ctor.
+  SetAxis(kPt, 100, 0., 100.);
+  SetAxis(kY, 25, -4.5, -2.);
+  SetAxis(kPhi, 36, 0., 2.*TMath::Pi());
+  SetAxis(kInvMass, 750, 0., 15.);
+  SetAxis(kCentrality, 10, 0., 100.);
+  SetAxis(kTracklets, 150, -0.5, 150.-0.5);
+
+  fTitles[kPt] = "p_{T} (GeV/c)";
+  fTitles[kY] = "y";
+  fTitles[kPhi] = "#phi (rad)";
+  fTitles[kInvMass] = "M_{#mu#mu} (GeV/c^{2})";
+  fTitles[kCentrality] = "Centrality";
+  fTitles[kTracklets] = "SPD tracklets";
+}
+
+//________________________________________________________________________
+AliDimuBinning::~AliDimuBinning()
+{
+  /// Dtor.
+}
+
+//________________________________________________________________________
+const char* AliDimuBinning::GetAxisName ( Int_t iaxis )
+{
+  /// Short axis name (used in the axis definitions)
+  static const char* axisNames[kNaxes] = {"pt", "y", "phi", "mass", "centrality", "tracklets"};
+  return ( iaxis >= 0 && iaxis < kNaxes ) ? axisNames[iaxis] : "";
+}
+
+//________________________________________________________________________
+Int_t AliDimuBinning::GetAxisIndex ( const char* axisName )
+{
+  /// Axis index from short name (-1 if not found)
+  for ( Int_t iaxis=0; iaxis<kNaxes; ++iaxis ) {
+    if ( TString(axisName) == GetAxisName(iaxis) ) return iaxis;
+  }
+  return -1;
+}
+
+//________________________________________________________________________
+void AliDimuBinning::SetAxis ( Int_t iaxis, Int_t nBins, Double_t xMin, Double_t xMax )
+{
+  /// Set uniform binning
+  std::vector<Double_t>& edges = fEdges[iaxis];
+  edges.resize(nBins+1);
+  for ( Int_t ibin=0; ibin<=nBins; ibin++ ) edges[ibin] = xMin + ibin * (xMax-xMin)/nBins;
+}
+
+//________________________________________________________________________
+void AliDimuBinning::SetAxis ( Int_t iaxis, Int_t nBins, const Double_t* edges )
+{
+  /// Set variable binning (nBins+1 edges)
+  fEdges[iaxis].assign(edges, edges+nBins+1);
+}
+
+//________________________________________________________________________
+Bool_t AliDimuBinning::SetAxis ( const char* axisDef )
+{
+  /// Set axis from string definition:
+  /// - uniform binning: name:nBins:min:max (e.g. mass:300:0:15)
+  /// - variable binning: name:edge0,edge1,...,edgeN (e.g. pt:0,1,2,4,8,20)
+  /// See GetAxisName for the names
+  TObjArray* tokens = TString(axisDef).Tokenize(":");
+  Int_t nTokens = tokens->GetEntries();
+  Int_t iaxis = ( nTokens > 0 ) ? GetAxisIndex(static_cast<TObjString*>(tokens->At(0))->String().Data()) : -1;
+  Bool_t isOk = kFALSE;
+  if ( iaxis >= 0 ) {
+    if ( nTokens == 4 ) {
+      Int_t nBins = static_cast<TObjString*>(tokens->At(1))->String().Atoi();
+      Double_t xMin = static_cast<TObjString*>(tokens->At(2))->String().Atof();
+      Double_t xMax = static_cast<TObjString*>(tokens->At(3))->String().Atof();
+      if ( nBins > 0 && xMax > xMin ) {
+        SetAxis(iaxis, nBins, xMin, xMax);
+        isOk = kTRUE;
+      }
+    }
+    else if ( nTokens == 2 ) {
+      TObjArray* edgeTokens = static_cast<TObjString*>(tokens->At(1))->String().Tokenize(",");
+      std::vector<Double_t> edges;
+      for ( Int_t iedge=0; iedge<edgeTokens->GetEntries(); ++iedge ) {
+        edges.push_back(static_cast<TObjString*>(edgeTokens->At(iedge))->String().Atof());
+      }
+      delete edgeTokens;
+      isOk = ( edges.size() > 1 );
+      for ( size_t iedge=1; iedge<edges.size(); ++iedge ) {
+        if ( edges[iedge] <= edges[iedge-1] ) isOk = kFALSE;
+      }
+      if ( isOk ) fEdges[iaxis] = edges;
+    }
+  }
+  delete tokens;
+  if ( ! isOk ) printf("E-AliDimuBinning::SetAxis: cannot parse axis definition %s\n", axisDef);
+  return isOk;
+}
+
+//________________________________________________________________________
+TString AliDimuBinning::GetAxisDefinition ( Int_t iaxis ) const
+{
+  /// Axis definition string (see SetAxis): uniform if the bins have the same width
+  const std::vector<Double_t>& edges = fEdges[iaxis];
+  Int_t nBins = GetNbins(iaxis);
+  Double_t width = ( edges.back() - edges.front() ) / nBins;
+  Bool_t isUniform = kTRUE;
+  for ( Int_t ibin=0; ibin<nBins; ++ibin ) {
+    if ( TMath::Abs(edges[ibin+1] - edges[ibin] - width) > 1.e-6 * width ) {
+      isUniform = kFALSE;
+      break;
+    }
+  }
+  if ( isUniform ) return Form("%s:%i:%.10g:%.10g", GetAxisName(iaxis), nBins, edges.front(), edges.back());
+  TString axisDef = Form("%s:", GetAxisName(iaxis));
+  for ( Int_t iedge=0; iedge<=nBins; ++iedge ) axisDef += Form("%s%.10g", ( iedge == 0 ) ? "" : ",", edges[iedge]);
+  return axisDef;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuBinning::ReadSchema ( const char* fileName )
+{
+  /// Read the binning from a schema file: one axis definition per line (see SetAxis).
+  /// Empty lines and lines starting with # are ignored.
+  /// The axes not in the file keep their binning.
+  /// The file is parsed in a copy: the binning is changed only if all the lines are valid
+  std::ifstream inFile(fileName);
+  if ( ! inFile.is_open() ) {
+    printf("E-AliDimuBinning::ReadSchema: cannot open %s\n", fileName);
+    return kFALSE;
+  }
+  AliDimuBinning binning(*this);
+  Bool_t isOk = kTRUE;
+  std::string line;
+  while ( std::getline(inFile,line) ) {
+    TString axisDef(line.c_str());
+    axisDef.Remove(TString::kBoth,' ');
+    if ( axisDef.IsNull() || axisDef.BeginsWith("#") ) continue;
+    if ( ! binning.SetAxis(axisDef.Data()) ) isOk = kFALSE;
+  }
+  if ( inFile.bad() ) {
+    printf("E-AliDimuBinning::ReadSchema: error reading %s\n", fileName);
+    isOk = kFALSE;
+  }
+  if ( ! isOk ) {
+    printf("E-AliDimuBinning::ReadSchema: invalid schema %s: binning unchanged\n", fileName);
+    return kFALSE;
+  }
+  fEdges = binning.fEdges;
+  fTitles = binning.fTitles;
+  return kTRUE;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuBinning::WriteSchema ( const char* fileName, const char* comment ) const
+{
+  /// Write the binning to a schema file that can be read with ReadSchema.
+  /// The comment (possibly multi-line) is written at the top
+  std::ofstream outFile(fileName);
+  if ( ! outFile.is_open() ) {
+    printf("E-AliDimuBinning::WriteSchema: cannot create %s\n", fileName);
+    return kFALSE;
+  }
+  TObjArray* lines = TString(comment).Tokenize("\n");
+  for ( Int_t iline=0; iline<lines->GetEntries(); ++iline ) outFile << "# " << static_cast<TObjString*>(lines->At(iline))->String().Data() << std::endl;
+  delete lines;
+  for ( Int_t iaxis=0; iaxis<kNaxes; ++iaxis ) outFile << GetAxisDefinition(iaxis).Data() << std::endl;
+  return kTRUE;
+}
+
+//________________________________________________________________________
+THnSparse* AliDimuBinning::CreateSparse ( const char* name, const char* title ) const
+{
+  /// Create the sparse with the current binning
+  Int_t nbins[kNaxes];
+  for ( Int_t iaxis=0; iaxis<kNaxes; ++iaxis ) nbins[iaxis] = GetNbins(iaxis);
+  THnSparse* sparse = new THnSparseF(name, title, kNaxes, nbins);
+  for ( Int_t iaxis=0; iaxis<kNaxes; ++iaxis ) {
+    sparse->GetAxis(iaxis)->SetTitle(fTitles[iaxis].Data());
+    sparse->SetBinEdges(iaxis, fEdges[iaxis].data());
+  }
+  return sparse;
+}
+
+//________________________________________________________________________
+void AliDimuBinning::Print ( Option_t* /*option*/ ) const
+{
+  /// Print binning
+  for ( Int_t iaxis=0; iaxis<kNaxes; ++iaxis ) {
+    printf("%-10s %-25s %4i bins in [%g, %g]\n", GetAxisName(iaxis), fTitles[iaxis].Data(), GetNbins(iaxis), fEdges[iaxis].front(), fEdges[iaxis].back());
+  }
+}
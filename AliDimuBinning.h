@@ -0,0 +1,66 @@
+#ifndef ALIDIMUBINNING_H
+#define ALIDIMUBINNING_H
+
+/* $Id$ */
+
+//
+// AliDimuBinning
+// Axes of the dimuon sparse
+//
+//  Author: Diego Stocco
+//
+
+#include <vector>
+#include "TObject.h"
+#include "TString.h"
+
+class THnSparse;
+
+class AliDimuBinning : public TObject {
+ public:
+  AliDimuBinning();
+  virtual ~AliDimuBinning();
+
+  /// Axes (same order as the variables of AliAnalysisTaskDimu)
+  enum {
+    kPt,          ///< Pt
+    kY,           ///< Rapidity
+    kPhi,         ///< Phi
+    kInvMass,     ///< Invariant mass
+    kCentrality,  ///< Event centrality
+    kTracklets,   ///< Number of SPD tracklets
+    kNaxes        ///< Number of axes
+  };
+
+  void SetAxis ( Int_t iaxis, Int_t nBins, Double_t xMin, Double_t xMax );
+  void SetAxis ( Int_t iaxis, Int_t nBins, const Double_t* edges );
+  Bool_t SetAxis ( const char* axisDef );
+  TString GetAxisDefinition ( Int_t iaxis ) const;
+
+  Bool_t ReadSchema ( const char* fileName );
+  Bool_t WriteSchema ( const char* fileName, const char* comment = "" ) const;
+  /// Set axis title
+  void SetAxisTitle ( Int_t iaxis, const char* title ) { fTitles[iaxis] = title; }
+
+  /// Number of bins
+  Int_t GetNbins ( Int_t iaxis ) const { return fEdges[iaxis].size() - 1; }
+  /// Bin edges
+  const std::vector<Double_t>& GetEdges ( Int_t iaxis ) const { return fEdges[iaxis]; }
+  /// Axis title
+  const char* GetAxisTitle ( Int_t iaxis ) const { return fTitles[iaxis].Data(); }
+
+  static const char* GetAxisName ( Int_t iaxis );
+  static Int_t GetAxisIndex ( const char* axisName );
+
+  THnSparse* CreateSparse ( const char* name, const char* title ) const;
+
+  virtual void Print ( Option_t* option = "" ) const;
+
+ private:
+  std::vector<std::vector<Double_t> > fEdges; ///< Bin edges per axis
+  std::vector<TString> fTitles; ///< Axis titles
+
+  ClassDef(AliDimuBinning, 1); // Axes of the dimuon sparse
+};
+
+#endif
@@ -0,0 +1,382 @@
+/**************************************************************************
+ * Copyright(c) 1998-2007, ALICE Experiment at CERN, All rights reserved. *
+ *                                                                        *
+ * Author: The ALICE Off-line Project.                                    *
+ * Contributors are mentioned in the code where appropriate.              *
+ *                                                                        *
+ * Permission to use, copy, modify and distribute this software and its   *
+ * documentation strictly for non-commercial purposes is hereby granted   *
+ * without fee, provided that the above copyright notice appears in all   *
+ * copies and that both the copyright notice and this permission notice   *
+ * appear in the supporting documentation. The authors make no claims     *
+ * about the suitability of this software for any purpose. It is          *
+ * provided "as is" without express or implied warranty.                  *
+ **************************************************************************/
+
+/* $Id$ */
+
+//-----------------------------------------------------------------------------
+/// \class AliDimuCompactSparse
+/// Compact encoding of a THnSparseF/THnSparseD, to be written instead of the sparse.
+///
+/// The THnSparse streamer writes, for each chunk, the packed coordinates
+/// of all the filled bins and a full array of contents (and errors).
+/// Here the filled bins are identified by their linear bin index (key):
+/// the keys are sorted and stored as varint differences, which take
+/// one or two bytes for the densely filled regions. The contents of unweighted
+/// fills are integer and are stored as varints, and the squared errors are
+/// stored only when they differ from the contents. The axes are stored once.
+///
+/// The encoding is lossless for the axes, the bin contents, the errors and
+/// the number of entries (the other THnBase statistics are not kept).
+///
+/// \author Diego Stocco
+//-----------------------------------------------------------------------------
+
+#include "AliDimuCompactSparse.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "TAxis.h"
+#include "THashList.h"
+#include "TObjString.h"
+#include "TMath.h"
+#include "THnSparse.h"
+
+/// \cond CLASSIMP
+ClassImp(AliDimuCompactSparse) // Class implementation in ROOT context
+/// \endcond
+
+//________________________________________________________________________
+AliDimuCompactSparse::AliDimuCompactSparse() :
+TNamed(),
+fData()
+{
+  /// Default ctor.
+}
+
+//________________________________________________________________________
+AliDimuCompactSparse::AliDimuCompactSparse ( const THnSparse* sparse ) :
+TNamed(sparse->GetName(),sparse->GetTitle()),
+fData()
+{
+  /// Ctor. Check IsValid: not all the sparses can be encoded
+  if ( ! Encode(sparse, fData) ) fData.clear();
+}
+
+//________________________________________________________________________
+AliDimuCompactSparse::~AliDimuCompactSparse()
+{
+  /// Dtor.
+}
+
+//________________________________________________________________________
+void AliDimuCompactSparse::PutVarint ( std::vector<UChar_t>& data, ULong64_t value )
+{
+  /// Append the value as varint (7 bits per byte, high bit set if more bytes follow)
+  while ( value >= 0x80 ) {
+    data.push_back(static_cast<UChar_t>(value | 0x80));
+    value >>= 7;
+  }
+  data.push_back(static_cast<UChar_t>(value));
+}
+
+//________________________________________________________________________
+void AliDimuCompactSparse::PutBytes ( std::vector<UChar_t>& data, const void* value, size_t size )
+{
+  /// Append the bytes of the value
+  const UChar_t* bytes = static_cast<const UChar_t*>(value);
+  data.insert(data.end(), bytes, bytes+size);
+}
+
+//________________________________________________________________________
+void AliDimuCompactSparse::PutString ( std::vector<UChar_t>& data, const char* value )
+{
+  /// Append the string (length + characters)
+  size_t length = strlen(value);
+  PutVarint(data, length);
+  PutBytes(data, value, length);
+}
+
+//________________________________________________________________________
+void AliDimuCompactSparse::PutAxis ( std::vector<UChar_t>& data, const TAxis* axis )
+{
+  /// Append the axis definition
+  PutString(data, axis->GetName());
+  PutString(data, axis->GetTitle());
+  Int_t nBins = axis->GetNbins();
+  PutVarint(data, nBins);
+  Bool_t isVariable = axis->IsVariableBinSize();
+  data.push_back(isVariable ? 1 : 0);
+  if ( isVariable ) {
+    for ( Int_t ibin=1; ibin<=nBins+1; ++ibin ) {
+      Double_t edge = axis->GetBinLowEdge(ibin);
+      PutBytes(data, &edge, sizeof(edge));
+    }
+  }
+  else {
+    Double_t xMin = axis->GetXmin(), xMax = axis->GetXmax();
+    PutBytes(data, &xMin, sizeof(xMin));
+    PutBytes(data, &xMax, sizeof(xMax));
+  }
+  THashList* labels = axis->GetLabels();
+  PutVarint(data, labels ? labels->GetEntries() : 0);
+  if ( ! labels ) return;
+  TIter next(labels);
+  TObjString* label = 0x0;
+  while ( (label = static_cast<TObjString*>(next())) ) {
+    PutVarint(data, label->GetUniqueID());
+    PutString(data, label->GetName());
+  }
+}
+
+//________________________________________________________________________
+Bool_t AliDimuCompactSparse::Encode ( const THnSparse* sparse, std::vector<UChar_t>& data )
+{
+  /// Encode the sparse. Returns kFALSE if the sparse is not a THnSparseF/THnSparseD
+  /// or if the bin index does not fit in 64 bits
+  Bool_t isDouble = sparse->InheritsFrom(THnSparseD::Class());
+  if ( ! isDouble && ! sparse->InheritsFrom(THnSparseF::Class()) ) return kFALSE;
+
+  Int_t nDims = sparse->GetNdimensions();
+  std::vector<ULong64_t> radix(nDims);
+  ULong64_t nKeys = 1;
+  for ( Int_t idim=0; idim<nDims; ++idim ) {
+    radix[idim] = nKeys;
+    ULong64_t nBins = sparse->GetAxis(idim)->GetNbins() + 2;
+    if ( nKeys > kMaxULong64 / nBins ) return kFALSE;
+    nKeys *= nBins;
+  }
+
+  // Sort the filled bins by key
+  Long64_t nFilled = sparse->GetNbins();
+  std::vector<Int_t> coord(nDims);
+  std::vector<std::pair<ULong64_t,Long64_t> > keyBins(nFilled);
+  Bool_t isInteger = kTRUE, errorsEqualContents = kTRUE;
+  Bool_t hasErrors = sparse->GetCalculateErrors();
+  for ( Long64_t ibin=0; ibin<nFilled; ++ibin ) {
+    Double_t content = sparse->GetBinContent(ibin, coord.data());
+    ULong64_t key = 0;
+    for ( Int_t idim=0; idim<nDims; ++idim ) key += coord[idim] * radix[idim];
+    keyBins[ibin] = std::make_pair(key,ibin);
+    if ( isInteger && ( content < 0. || content >= 4503599627370496. || content != TMath::Floor(content) ) ) isInteger = kFALSE;
+    if ( hasErrors && errorsEqualContents && sparse->GetBinError2(ibin) != content ) errorsEqualContents = kFALSE;
+  }
+  std::sort(keyBins.begin(), keyBins.end());
+
+  UChar_t flags = 0;
+  if ( isDouble ) flags |= kIsDouble;
+  if ( hasErrors ) flags |= kHasErrors;
+  if ( isInteger ) flags |= kIntegerContents;
+  if ( hasErrors && errorsEqualContents ) flags |= kErrorsEqualContents;
+
+  data.clear();
+  data.reserve(64 + nFilled * 3);
+  UInt_t magic = kMagic;
+  PutBytes(data, &magic, sizeof(magic));
+  data.push_back(kVersion);
+  data.push_back(flags);
+  PutString(data, sparse->GetName());
+  PutString(data, sparse->GetTitle());
+  Double_t entries = sparse->GetEntries();
+  PutBytes(data, &entries, sizeof(entries));
+  PutVarint(data, nDims);
+  for ( Int_t idim=0; idim<nDims; ++idim ) PutAxis(data, sparse->GetAxis(idim));
+
+  PutVarint(data, nFilled);
+  ULong64_t previousKey = 0;
+  for ( const std::pair<ULong64_t,Long64_t>& keyBin : keyBins ) {
+    PutVarint(data, keyBin.first - previousKey);
+    previousKey = keyBin.first;
+  }
+  for ( const std::pair<ULong64_t,Long64_t>& keyBin : keyBins ) {
+    Double_t content = sparse->GetBinContent(keyBin.second);
+    if ( isInteger ) PutVarint(data, static_cast<ULong64_t>(content));
+    else if ( isDouble ) PutBytes(data, &content, sizeof(content));
+    else {
+      Float_t floatContent = content;
+      PutBytes(data, &floatContent, sizeof(floatContent));
+    }
+  }
+  if ( hasErrors && ! errorsEqualContents ) {
+    for ( const std::pair<ULong64_t,Long64_t>& keyBin : keyBins ) {
+      Double_t error2 = sparse->GetBinError2(keyBin.second);
+      PutBytes(data, &error2, sizeof(error2));
+    }
+  }
+  return kTRUE;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuCompactSparse::GetVarint ( const UChar_t* data, size_t size, size_t& pos, ULong64_t& value )
+{
+  /// Read a varint
+  value = 0;
+  for ( Int_t shift=0; shift<64 && pos<size; shift+=7 ) {
+    UChar_t byte = data[pos++];
+    value |= static_cast<ULong64_t>(byte & 0x7f) << shift;
+    if ( ! ( byte & 0x80 ) ) return kTRUE;
+  }
+  return kFALSE;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuCompactSparse::GetBytes ( const UChar_t* data, size_t size, size_t& pos, void* value, size_t valueSize )
+{
+  /// Read the bytes of the value
+  if ( pos + valueSize > size ) return kFALSE;
+  memcpy(value, data+pos, valueSize);
+  pos += valueSize;
+  return kTRUE;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuCompactSparse::GetString ( const UChar_t* data, size_t size, size_t& pos, TString& value )
+{
+  /// Read a string
+  ULong64_t length = 0;
+  if ( ! GetVarint(data, size, pos, length) || pos + length > size ) return kFALSE;
+  value = TString(reinterpret_cast<const char*>(data+pos), static_cast<Int_t>(length));
+  pos += length;
+  return kTRUE;
+}
+
+//________________________________________________________________________
+THnSparse* AliDimuCompactSparse::Decode () const
+{
+  /// Decode the sparse (owned by the caller, 0x0 if invalid)
+  return Decode(fData.data(), fData.size());
+}
+
+//________________________________________________________________________
+THnSparse* AliDimuCompactSparse::Decode ( const UChar_t* data, size_t size )
+{
+  /// Decode the sparse (owned by the caller, 0x0 if the data are corrupted)
+  size_t pos = 0;
+  UInt_t magic = 0;
+  UChar_t version = 0, flags = 0;
+  TString name, title;
+  Double_t entries = 0.;
+  ULong64_t nDims = 0;
+  if ( ! GetBytes(data, size, pos, &magic, sizeof(magic)) || magic != kMagic ||
+       ! GetBytes(data, size, pos, &version, 1) || version != kVersion ||
+       ! GetBytes(data, size, pos, &flags, 1) ||
+       ! GetString(data, size, pos, name) || ! GetString(data, size, pos, title) ||
+       ! GetBytes(data, size, pos, &entries, sizeof(entries)) ||
+       ! GetVarint(data, size, pos, nDims) || nDims == 0 || nDims > 64 ) {
+    printf("E-AliDimuCompactSparse::Decode: invalid header\n");
+    return 0x0;
+  }
+
+  // Axes
+  struct AxisDef {
+    TString fName, fTitle;
+    std::vector<Double_t> fEdges;
+    std::vector<std::pair<Int_t,TString> > fLabels;
+  };
+  std::vector<AxisDef> axes(nDims);
+  std::vector<Int_t> nBins(nDims);
+  std::vector<Double_t> xMin(nDims), xMax(nDims);
+  Bool_t isOk = kTRUE;
+  for ( ULong64_t idim=0; idim<nDims && isOk; ++idim ) {
+    AxisDef& axis = axes[idim];
+    ULong64_t nAxisBins = 0, nLabels = 0;
+    UChar_t isVariable = 0;
+    isOk = ( GetString(data, size, pos, axis.fName) && GetString(data, size, pos, axis.fTitle) &&
+             GetVarint(data, size, pos, nAxisBins) && nAxisBins > 0 && nAxisBins < kMaxInt &&
+             GetBytes(data, size, pos, &isVariable, 1) && ( ! isVariable || nAxisBins < size ) );
+    if ( ! isOk ) break;
+    nBins[idim] = nAxisBins;
+    axis.fEdges.resize(isVariable ? nAxisBins+1 : 2);
+    for ( Double_t& edge : axis.fEdges ) isOk = isOk && GetBytes(data, size, pos, &edge, sizeof(edge));
+    xMin[idim] = axis.fEdges.front();
+    xMax[idim] = axis.fEdges.back();
+    if ( ! isVariable ) axis.fEdges.clear();
+    isOk = isOk && GetVarint(data, size, pos, nLabels);
+    for ( ULong64_t ilabel=0; ilabel<nLabels && isOk; ++ilabel ) {
+      ULong64_t bin = 0;
+      TString label;
+      isOk = ( GetVarint(data, size, pos, bin) && GetString(data, size, pos, label) );
+      axis.fLabels.push_back(std::make_pair(static_cast<Int_t>(bin),label));
+    }
+  }
+  ULong64_t nFilled = 0;
+  isOk = isOk && GetVarint(data, size, pos, nFilled) && nFilled <= size;
+
+  // Bin keys: as in Encode, the key must fit in 64 bits
+  std::vector<ULong64_t> radix(nDims);
+  ULong64_t nKeys = 1;
+  for ( ULong64_t idim=0; idim<nDims && isOk; ++idim ) {
+    radix[idim] = nKeys;
+    ULong64_t nAxisKeys = nBins[idim] + 2;
+    isOk = ( nKeys <= kMaxULong64 / nAxisKeys );
+    nKeys *= nAxisKeys;
+  }
+  if ( ! isOk ) {
+    printf("E-AliDimuCompactSparse::Decode: invalid axes\n");
+    return 0x0;
+  }
+
+  THnSparse* sparse = 0x0;
+  if ( flags & kIsDouble ) sparse = new THnSparseD(name.Data(), title.Data(), nDims, nBins.data(), xMin.data(), xMax.data());
+  else sparse = new THnSparseF(name.Data(), title.Data(), nDims, nBins.data(), xMin.data(), xMax.data());
+  for ( ULong64_t idim=0; idim<nDims; ++idim ) {
+    const AxisDef& axisDef = axes[idim];
+    if ( ! axisDef.fEdges.empty() ) sparse->SetBinEdges(idim, axisDef.fEdges.data());
+    TAxis* axis = sparse->GetAxis(idim);
+    axis->SetName(axisDef.fName.Data());
+    axis->SetTitle(axisDef.fTitle.Data());
+    for ( const std::pair<Int_t,TString>& label : axisDef.fLabels ) axis->SetBinLabel(label.first, label.second.Data());
+  }
+  Bool_t hasErrors = ( flags & kHasErrors );
+  if ( hasErrors ) sparse->Sumw2();
+
+  // Bins
+  std::vector<Long64_t> bins(nFilled);
+  std::vector<Int_t> coord(nDims);
+  ULong64_t key = 0;
+  for ( ULong64_t ifilled=0; ifilled<nFilled && isOk; ++ifilled ) {
+    ULong64_t delta = 0;
+    isOk = ( GetVarint(data, size, pos, delta) && delta < nKeys - key );
+    if ( ! isOk ) break;
+    key += delta;
+    ULong64_t remainder = key;
+    for ( Int_t idim=nDims-1; idim>=0; --idim ) {
+      coord[idim] = remainder / radix[idim];
+      remainder %= radix[idim];
+    }
+    bins[ifilled] = sparse->GetBin(coord.data());
+  }
+  for ( ULong64_t ifilled=0; ifilled<nFilled && isOk; ++ifilled ) {
+    Double_t content = 0.;
+    if ( flags & kIntegerContents ) {
+      ULong64_t count = 0;
+      isOk = GetVarint(data, size, pos, count);
+      content = count;
+    }
+    else if ( flags & kIsDouble ) isOk = GetBytes(data, size, pos, &content, sizeof(content));
+    else {
+      Float_t floatContent = 0.;
+      isOk = GetBytes(data, size, pos, &floatContent, sizeof(floatContent));
+      content = floatContent;
+    }
+    sparse->SetBinContent(bins[ifilled], content);
+    if ( hasErrors && ( flags & kErrorsEqualContents ) ) sparse->SetBinError2(bins[ifilled], content);
+  }
+  if ( hasErrors && ! ( flags & kErrorsEqualContents ) ) {
+    for ( ULong64_t ifilled=0; ifilled<nFilled && isOk; ++ifilled ) {
+      Double_t error2 = 0.;
+      isOk = GetBytes(data, size, pos, &error2, sizeof(error2));
+      sparse->SetBinError2(bins[ifilled], error2);
+    }
+  }
+  if ( ! isOk ) {
+    printf("E-AliDimuCompactSparse::Decode: invalid bins in %s\n", name.Data());
+    delete sparse;
+    return 0x0;
+  }
+  sparse->SetEntries(entries);
+  return sparse;
+}
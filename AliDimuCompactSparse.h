@@ -0,0 +1,70 @@
+#ifndef ALIDIMUCOMPACTSPARSE_H
+#define ALIDIMUCOMPACTSPARSE_H
+
+/* $Id$ */
+
+//
+// AliDimuCompactSparse
+// Compact lossless encoding of a THnSparse
+//
+//  Author: Diego Stocco
+//
+
+#include <vector>
+#include "TNamed.h"
+
+class TAxis;
+class THnSparse;
+
+/// Encoding layout (native little endian byte order, varint = LEB128):
+///  - header: magic "DCSP", version, flags (kIsDouble, kHasErrors, kIntegerContents, kErrorsEqualContents)
+///  - name, title, entries, number of dimensions
+///  - per axis: name, title, number of bins, edges (min/max or all the edges), bin labels
+///  - number of filled bins (varint)
+///  - bin keys sorted, as varint deltas (key = linear bin index with under/overflow)
+///  - contents: varints if all integer, else float or double as in the sparse
+///  - squared errors (doubles), only if they differ from the contents
+class AliDimuCompactSparse : public TNamed {
+ public:
+  AliDimuCompactSparse();
+  AliDimuCompactSparse ( const THnSparse* sparse );
+  virtual ~AliDimuCompactSparse();
+
+  enum {
+    kVersion = 1,     ///< Format version
+    kMagic = 0x50534344 ///< Magic number ("DCSP")
+  };
+
+  /// Flags
+  enum EFlag {
+    kIsDouble = 1<<0,            ///< THnSparseD (THnSparseF otherwise)
+    kHasErrors = 1<<1,           ///< Sumw2 is set
+    kIntegerContents = 1<<2,     ///< Contents stored as varints
+    kErrorsEqualContents = 1<<3  ///< Squared errors equal to the contents (not stored)
+  };
+
+  /// The sparse could be encoded
+  Bool_t IsValid () const { return ! fData.empty(); }
+  /// Size of the encoding (bytes)
+  Long64_t GetSize () const { return fData.size(); }
+
+  THnSparse* Decode () const;
+
+  static Bool_t Encode ( const THnSparse* sparse, std::vector<UChar_t>& data );
+  static THnSparse* Decode ( const UChar_t* data, size_t size );
+
+ private:
+  static void PutVarint ( std::vector<UChar_t>& data, ULong64_t value );
+  static void PutBytes ( std::vector<UChar_t>& data, const void* value, size_t size );
+  static void PutString ( std::vector<UChar_t>& data, const char* value );
+  static void PutAxis ( std::vector<UChar_t>& data, const TAxis* axis );
+  static Bool_t GetVarint ( const UChar_t* data, size_t size, size_t& pos, ULong64_t& value );
+  static Bool_t GetBytes ( const UChar_t* data, size_t size, size_t& pos, void* value, size_t valueSize );
+  static Bool_t GetString ( const UChar_t* data, size_t size, size_t& pos, TString& value );
+
+  std::vector<UChar_t> fData; ///< Encoded sparse
+
+  ClassDef(AliDimuCompactSparse, 1); // Compact encoding of a THnSparse
+};
+
+#endif
@@ -0,0 +1,94 @@
+/**************************************************************************
+ * Copyright(c) 1998-2007, ALICE Experiment at CERN, All rights reserved. *
+ *                                                                        *
+ * Author: The ALICE Off-line Project.                                    *
+ * Contributors are mentioned in the code where appropriate.              *
+ *                                                                        *
+ * Permission to use, copy, modify and distribute this software and its   *
+ * documentation strictly for non-commercial purposes is hereby granted   *
+ * without fee, provided that the above copyright notice appears in all   *
+ * copies and that both the copyright notice and this permission notice   *
+ * appear in the supporting documentation. The authors make no claims     *
+ * about the suitability of this software for any purpose. It is          *
+ * provided "as is" without express or implied warranty.                  *
+ **************************************************************************/
+
+/* $Id$ */
+
+//-----------------------------------------------------------------------------
+/// \class AliDimuEventMixer
+/// Pools of muons from previous events, used to build mixed-event pairs.
+/// The pools are binned in centrality and number of SPD tracklets.
+/// Each pool is a ring buffer with a fixed number of events,
+/// each holding at most a fixed number of compact muons.
+/// All the memory is allocated at construction, so that the memory
+/// and the number of mixed pairs per event are bounded.
+///
+/// \author Diego Stocco
+//-----------------------------------------------------------------------------
+
+#include "AliDimuEventMixer.h"
+
+#include <algorithm>
+
+//________________________________________________________________________
+AliDimuEventMixer::AliDimuEventMixer ( Int_t poolDepth, Int_t maxMuonsPerEvent, const std::vector<Double_t>& centralityEdges, const std::vector<Double_t>& trackletEdges ) :
+fPoolDepth(poolDepth),
+fMaxMuonsPerEvent(maxMuonsPerEvent),
+fCentralityEdges(centralityEdges),
+fTrackletEdges(trackletEdges),
+fMuons(),
+fNmuons(),
+fNevents(),
+fNext()
+{
+  /// Ctor.
+  if ( fMaxMuonsPerEvent > 255 ) fMaxMuonsPerEvent = 255;
+  Int_t nPools = ( fCentralityEdges.size() - 1 ) * ( fTrackletEdges.size() - 1 );
+  fMuons.resize(nPools*fPoolDepth*fMaxMuonsPerEvent);
+  fNmuons.resize(nPools*fPoolDepth,0);
+  fNevents.resize(nPools,0);
+  fNext.resize(nPools,0);
+}
+
+//________________________________________________________________________
+Int_t AliDimuEventMixer::FindBin ( const std::vector<Double_t>& edges, Double_t val ) const
+{
+  /// Find bin in edges (-1 if outside)
+  if ( val < edges.front() || val >= edges.back() ) return -1;
+  return std::upper_bound(edges.begin(),edges.end(),val) - edges.begin() - 1;
+}
+
+//________________________________________________________________________
+Int_t AliDimuEventMixer::FindPool ( Double_t centrality, Double_t nTracklets ) const
+{
+  /// Find pool for the event (-1 if outside the pool binning)
+  Int_t icent = FindBin(fCentralityEdges,centrality);
+  if ( icent < 0 ) return -1;
+  Int_t itrk = FindBin(fTrackletEdges,nTracklets);
+  if ( itrk < 0 ) return -1;
+  return icent * ( fTrackletEdges.size() - 1 ) + itrk;
+}
+
+//________________________________________________________________________
+const AliDimuMuon* AliDimuEventMixer::GetEvent ( Int_t ipool, Int_t ievent, Int_t& nMuons ) const
+{
+  /// Get muons of the stored event
+  Int_t islot = ipool * fPoolDepth + ievent;
+  nMuons = fNmuons[islot];
+  return &fMuons[islot * fMaxMuonsPerEvent];
+}
+
+//________________________________________________________________________
+void AliDimuEventMixer::AddEvent ( Int_t ipool, const AliDimuMuon* muons, Int_t nMuons )
+{
+  /// Add event to the pool, replacing the oldest one if the pool is full.
+  /// Muons exceeding the maximum number per event are dropped.
+  if ( fPoolDepth <= 0 ) return;
+  nMuons = std::min(nMuons,fMaxMuonsPerEvent);
+  Int_t islot = ipool * fPoolDepth + fNext[ipool];
+  std::copy(muons, muons+nMuons, fMuons.begin()+islot*fMaxMuonsPerEvent);
+  fNmuons[islot] = nMuons;
+  fNext[ipool] = ( fNext[ipool] + 1 ) % fPoolDepth;
+  if ( fNevents[ipool] < fPoolDepth ) ++fNevents[ipool];
+}
@@ -0,0 +1,50 @@
+#ifndef ALIDIMUEVENTMIXER_H
+#define ALIDIMUEVENTMIXER_H
+
+/* $Id$ */
+
+//
+// AliDimuEventMixer
+// Event pools for mixed-event dimuon background
+//
+//  Author: Diego Stocco
+//
+
+#include <vector>
+#include "Rtypes.h"
+#include "AliDimuMuon.h"
+
+class AliDimuEventMixer {
+ public:
+  AliDimuEventMixer ( Int_t poolDepth, Int_t maxMuonsPerEvent, const std::vector<Double_t>& centralityEdges, const std::vector<Double_t>& trackletEdges );
+
+  Int_t FindPool ( Double_t centrality, Double_t nTracklets ) const;
+
+  /// Number of events currently stored in pool
+  Int_t GetNevents ( Int_t ipool ) const { return fNevents[ipool]; }
+  const AliDimuMuon* GetEvent ( Int_t ipool, Int_t ievent, Int_t& nMuons ) const;
+  void AddEvent ( Int_t ipool, const AliDimuMuon* muons, Int_t nMuons );
+
+  /// Number of pools
+  Int_t GetNpools () const { return fNevents.size(); }
+  /// Maximum number of events per pool
+  Int_t GetPoolDepth () const { return fPoolDepth; }
+  /// Maximum number of muons stored per event
+  Int_t GetMaxMuonsPerEvent () const { return fMaxMuonsPerEvent; }
+  /// Memory used by the pools (fixed at construction)
+  Long64_t GetMemorySize () const { return fMuons.size()*sizeof(AliDimuMuon) + fNmuons.size()*sizeof(UChar_t) + 2*fNevents.size()*sizeof(Int_t); }
+
+ private:
+  Int_t FindBin ( const std::vector<Double_t>& edges, Double_t val ) const;
+
+  Int_t fPoolDepth; ///< Maximum number of events per pool
+  Int_t fMaxMuonsPerEvent; ///< Maximum number of muons stored per event
+  std::vector<Double_t> fCentralityEdges; ///< Centrality bin edges of the pools
+  std::vector<Double_t> fTrackletEdges; ///< Tracklet bin edges of the pools
+  std::vector<AliDimuMuon> fMuons; ///< Muons of all pools (nPools x depth x maxMuons)
+  std::vector<UChar_t> fNmuons; ///< Number of muons per stored event (nPools x depth)
+  std::vector<Int_t> fNevents; ///< Number of stored events per pool
+  std::vector<Int_t> fNext; ///< Next slot to be overwritten per pool
+};
+
+#endif
@@ -0,0 +1,903 @@
+/**************************************************************************
+ * Copyright(c) 1998-2007, ALICE Experiment at CERN, All rights reserved. *
+ *                                                                        *
+ * Author: The ALICE Off-line Project.                                    *
+ * Contributors are mentioned in the code where appropriate.              *
+ *                                                                        *
+ * Permission to use, copy, modify and distribute this software and its   *
+ * documentation strictly for non-commercial purposes is hereby granted   *
+ * without fee, provided that the above copyright notice appears in all   *
+ * copies and that both the copyright notice and this permission notice   *
+ * appear in the supporting documentation. The authors make no claims     *
+ * about the suitability of this software for any purpose. It is          *
+ * provided "as is" without express or implied warranty.                  *
+ **************************************************************************/
+
+/* $Id$ */
+
+//-----------------------------------------------------------------------------
+/// \class AliDimuMerger
+/// Merge the AliMergeableCollection outputs of AliAnalysisTaskDimu
+/// (or of AliDimuSkimAnalysis) with a parallel tree reduction.
+///
+/// Each thread streams its share of the input files: a file is read,
+/// its sparses are converted to arrays of filled bins sorted by bin key
+/// and merged into the thread result, then the collection is deleted.
+/// The memory is therefore bounded by one result per thread plus one input.
+/// The thread results are then merged pairwise in parallel (log2(nThreads) levels).
+/// Two sorted bin arrays are merged in a single linear pass.
+/// The objects that are not sparses (e.g. the event counters) use the standard merge.
+///
+/// The bin contents and errors are summed in double precision:
+/// the result is identical to the standard merge (AliMergeableCollection::Merge)
+/// for integer weights, and equal within the float precision of THnSparseF otherwise.
+/// RunStandard and Compare allow to check this on real outputs.
+/// The merge fails (Run returns 0x0, RunStreaming kFALSE) if an input cannot be read
+/// or if the same sparse has different axes in two inputs.
+///
+/// When even the merged collection does not fit in memory, RunStreaming merges
+/// one object at a time across all the inputs. It works on the split layout,
+/// where each object of the collection is a key in the directory of its identifier
+/// (e.g. DimuOut/CMUL7-B-NOPF-MUFAST/trackletDistCuts_none/Jpsi/OS/DimuSparse).
+/// The inputs in collection layout are first split to temporary files, one at a time.
+/// The peak memory is then the largest of one input collection
+/// and of one merged object. The split files are merged by batches of at most
+/// SetMaxOpenFiles files, through temporary files when there are more inputs.
+/// The output is written in split layout: ReadCollection reads both layouts.
+///
+/// The sparses can be written in compact form (AliDimuCompactSparse, see SetCompactOutput
+/// and Compact): they are decoded transparently when the files are read.
+///
+/// \author Diego Stocco
+//-----------------------------------------------------------------------------
+
+#include "AliDimuMerger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <utility>
+
+#include "TROOT.h"
+#include "TFile.h"
+#include "TKey.h"
+#include "TList.h"
+#include "TMath.h"
+#include "TObjArray.h"
+#include "TObjString.h"
+#include "TAxis.h"
+#include "TClass.h"
+#include "TMethodCall.h"
+#include "TSystem.h"
+#include "TH1.h"
+#include "THnSparse.h"
+
+#include "AliMergeableCollection.h"
+#include "AliDimuCompactSparse.h"
+
+//________________________________________________________________________
+AliDimuMerger::AliDimuMerger() :
+fFileNames(),
+fCollectionPath(""),
+fNthreads(0),
+fCompactOutput(kFALSE),
+fMaxOpenFiles(64)
+{
+  /// Ctor.
+}
+
+//________________________________________________________________________
+AliDimuMerger::~AliDimuMerger()
+{
+  /// Dtor.
+}
+
+//________________________________________________________________________
+TString AliDimuMerger::FindCollectionPath ( const char* fileName )
+{
+  /// Path of the first AliMergeableCollection (or collection in split layout) in the file,
+  /// searched in the top directory and in its sub-directories
+  /// (e.g. PWG_Dimu/DimuOut in AnalysisResults.root)
+  TString path = "";
+  TFile* file = TFile::Open(fileName);
+  if ( ! file || file->IsZombie() ) {
+    printf("E-AliDimuMerger::FindCollectionPath: cannot open %s\n", fileName);
+    delete file;
+    return path;
+  }
+  TIter nextKey(file->GetListOfKeys());
+  TKey* key = 0x0;
+  while ( (key = static_cast<TKey*>(nextKey())) && path.IsNull() ) {
+    TString className = key->GetClassName();
+    if ( className == "AliMergeableCollection" ) path = key->GetName();
+    else if ( className == "TDirectoryFile" ) {
+      if ( TString(key->GetTitle()) == SplitTitle() ) {
+        path = key->GetName();
+        break;
+      }
+      TDirectory* dir = file->GetDirectory(key->GetName());
+      TIter nextSubKey(dir->GetListOfKeys());
+      TKey* subKey = 0x0;
+      while ( (subKey = static_cast<TKey*>(nextSubKey())) ) {
+        Bool_t isSplit = ( TString(subKey->GetClassName()) == "TDirectoryFile" && TString(subKey->GetTitle()) == SplitTitle() );
+        if ( TString(subKey->GetClassName()) != "AliMergeableCollection" && ! isSplit ) continue;
+        path = Form("%s/%s",key->GetName(),subKey->GetName());
+        break;
+      }
+    }
+  }
+  delete file;
+  if ( path.IsNull() ) printf("E-AliDimuMerger::FindCollectionPath: no collection in %s\n", fileName);
+  return path;
+}
+
+//________________________________________________________________________
+AliMergeableCollection* AliDimuMerger::ReadCollection ( const char* fileName, const char* path )
+{
+  /// Read the collection (in collection or split layout) from file (0x0 if not found).
+  /// The collection is owned by the caller and the file is closed
+  TFile* file = TFile::Open(fileName);
+  if ( ! file || file->IsZombie() ) {
+    printf("E-AliDimuMerger::ReadCollection: cannot open %s\n", fileName);
+    delete file;
+    return 0x0;
+  }
+  TDirectory* dir = file->GetDirectory(path);
+  if ( dir ) {
+    AliMergeableCollection* collection = ReadSplit(dir, gSystem->BaseName(path));
+    delete file;
+    return collection;
+  }
+  TObject* obj = file->Get(path);
+  AliMergeableCollection* collection = 0x0;
+  if ( obj && obj->InheritsFrom(AliMergeableCollection::Class()) ) {
+    collection = static_cast<AliMergeableCollection*>(obj);
+    Expand(collection);
+  }
+  else {
+    printf("E-AliDimuMerger::ReadCollection: no collection %s in %s\n", path, fileName);
+    delete obj;
+  }
+  delete file;
+  return collection;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuMerger::GetRadix ( const THnSparse* sparse, std::vector<Long64_t>& radix )
+{
+  /// Radix of each axis in the bin key (bins including underflow and overflow).
+  /// Returns kFALSE if the key does not fit in 63 bits
+  Int_t nDims = sparse->GetNdimensions();
+  radix.resize(nDims);
+  Long64_t nKeys = 1;
+  for ( Int_t idim=0; idim<nDims; ++idim ) {
+    radix[idim] = nKeys;
+    Int_t nBins = sparse->GetAxis(idim)->GetNbins() + 2;
+    if ( nKeys > kMaxLong64 / nBins ) return kFALSE;
+    nKeys *= nBins;
+  }
+  return kTRUE;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuMerger::IsSameBinning ( const THnSparse* sparse1, const THnSparse* sparse2 )
+{
+  /// Same number of dimensions, number of bins and bin edges on all the axes
+  Int_t nDims = sparse1->GetNdimensions();
+  if ( sparse2->GetNdimensions() != nDims ) return kFALSE;
+  for ( Int_t idim=0; idim<nDims; ++idim ) {
+    const TAxis* axis1 = sparse1->GetAxis(idim);
+    const TAxis* axis2 = sparse2->GetAxis(idim);
+    Int_t nBins = axis1->GetNbins();
+    if ( axis2->GetNbins() != nBins ) return kFALSE;
+    for ( Int_t ibin=1; ibin<=nBins+1; ++ibin ) {
+      Double_t edge1 = axis1->GetBinLowEdge(ibin), edge2 = axis2->GetBinLowEdge(ibin);
+      if ( TMath::Abs(edge1-edge2) > 1.e-10 * TMath::Max(1.,TMath::Abs(edge1)) ) return kFALSE;
+    }
+  }
+  return kTRUE;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuMerger::ToBins ( THnSparse* sparse, SparseBins& bins )
+{
+  /// Fill the bins sorted by key from the sparse.
+  /// The sparse is reset and kept as template (owned by bins).
+  /// Returns kFALSE (and leaves the sparse untouched) if the bin key does not fit in 63 bits
+  std::vector<Long64_t> radix;
+  if ( ! GetRadix(sparse, radix) ) return kFALSE;
+
+  Int_t nDims = sparse->GetNdimensions();
+  Long64_t nBins = sparse->GetNbins();
+  std::vector<Int_t> coord(nDims);
+  std::vector<std::pair<Long64_t,Long64_t> > keyBins(nBins);
+  for ( Long64_t ibin=0; ibin<nBins; ++ibin ) {
+    sparse->GetBinContent(ibin, coord.data());
+    Long64_t key = 0;
+    for ( Int_t idim=0; idim<nDims; ++idim ) key += coord[idim] * radix[idim];
+    keyBins[ibin] = std::make_pair(key,ibin);
+  }
+  std::sort(keyBins.begin(), keyBins.end());
+
+  bins.fKeys.resize(nBins);
+  bins.fContents.resize(nBins);
+  bins.fErrors2.resize(nBins);
+  for ( Long64_t ikey=0; ikey<nBins; ++ikey ) {
+    bins.fKeys[ikey] = keyBins[ikey].first;
+    bins.fContents[ikey] = sparse->GetBinContent(keyBins[ikey].second);
+    bins.fErrors2[ikey] = sparse->GetBinError2(keyBins[ikey].second);
+  }
+  bins.fEntries = sparse->GetEntries();
+  bins.fHasErrors = sparse->GetCalculateErrors();
+  sparse->Reset();
+  bins.fTemplate = sparse;
+  return kTRUE;
+}
+
+//________________________________________________________________________
+THnSparse* AliDimuMerger::FromBins ( SparseBins& bins, const char* name )
+{
+  /// Fill the template with the bins and return it.
+  /// The bins are released
+  THnSparse* sparse = bins.fTemplate;
+  bins.fTemplate = 0x0;
+  sparse->SetName(name);
+  if ( bins.fHasErrors ) sparse->Sumw2();
+  std::vector<Long64_t> radix;
+  GetRadix(sparse, radix);
+  Int_t nDims = sparse->GetNdimensions();
+  std::vector<Int_t> coord(nDims);
+  for ( size_t ikey=0; ikey<bins.fKeys.size(); ++ikey ) {
+    Long64_t key = bins.fKeys[ikey];
+    for ( Int_t idim=nDims-1; idim>=0; --idim ) {
+      coord[idim] = key / radix[idim];
+      key %= radix[idim];
+    }
+    Long64_t ibin = sparse->GetBin(coord.data());
+    sparse->SetBinContent(ibin, bins.fContents[ikey]);
+    if ( bins.fHasErrors ) sparse->SetBinError2(ibin, bins.fErrors2[ikey]);
+  }
+  sparse->SetEntries(bins.fEntries);
+  std::vector<Long64_t>().swap(bins.fKeys);
+  std::vector<Double_t>().swap(bins.fContents);
+  std::vector<Double_t>().swap(bins.fErrors2);
+  return sparse;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuMerger::MergeBins ( SparseBins& target, SparseBins& source )
+{
+  /// Add the source bins to the target in one pass on the sorted keys.
+  /// The source is released.
+  /// Returns kFALSE (target untouched) if the axes of the two sparses differ
+  Bool_t isOk = IsSameBinning(target.fTemplate, source.fTemplate);
+  if ( ! isOk ) {
+    printf("E-AliDimuMerger::MergeBins: inconsistent binning for %s\n", target.fTemplate->GetName());
+  }
+  else {
+    size_t nTarget = target.fKeys.size(), nSource = source.fKeys.size();
+    std::vector<Long64_t> keys;
+    std::vector<Double_t> contents, errors2;
+    keys.reserve(nTarget+nSource);
+    contents.reserve(nTarget+nSource);
+    errors2.reserve(nTarget+nSource);
+    size_t itarget = 0, isource = 0;
+    while ( itarget < nTarget || isource < nSource ) {
+      if ( isource == nSource || ( itarget < nTarget && target.fKeys[itarget] < source.fKeys[isource] ) ) {
+        keys.push_back(target.fKeys[itarget]);
+        contents.push_back(target.fContents[itarget]);
+        errors2.push_back(target.fErrors2[itarget]);
+        ++itarget;
+      }
+      else if ( itarget == nTarget || source.fKeys[isource] < target.fKeys[itarget] ) {
+        keys.push_back(source.fKeys[isource]);
+        contents.push_back(source.fContents[isource]);
+        errors2.push_back(source.fErrors2[isource]);
+        ++isource;
+      }
+      else {
+        keys.push_back(target.fKeys[itarget]);
+        contents.push_back(target.fContents[itarget] + source.fContents[isource]);
+        errors2.push_back(target.fErrors2[itarget] + source.fErrors2[isource]);
+        ++itarget;
+        ++isource;
+      }
+    }
+    target.fKeys.swap(keys);
+    target.fContents.swap(contents);
+    target.fErrors2.swap(errors2);
+    target.fEntries += source.fEntries;
+    target.fHasErrors = target.fHasErrors || source.fHasErrors;
+  }
+  delete source.fTemplate;
+  source.fTemplate = 0x0;
+  std::vector<Long64_t>().swap(source.fKeys);
+  std::vector<Double_t>().swap(source.fContents);
+  std::vector<Double_t>().swap(source.fErrors2);
+  return isOk;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuMerger::AddCollection ( AliMergeableCollection* collection, Partial& partial )
+{
+  /// Move the sparses of the collection to the partial result
+  /// and merge the other objects with the standard merge.
+  /// The collection is adopted.
+  /// Returns kFALSE if a sparse has different axes in the partial result
+  Bool_t isOk = kTRUE;
+  TObjArray* identifiers = collection->SortAllIdentifiers();
+  TIter nextIdentifier(identifiers);
+  TObjString* identifier = 0x0;
+  while ( (identifier = static_cast<TObjString*>(nextIdentifier())) ) {
+    TString id = identifier->String();
+    if ( ! id.EndsWith("/") ) id += "/";
+    TList* objectNames = collection->CreateListOfObjectNames(identifier->GetName());
+    TIter nextName(objectNames);
+    TObjString* objectName = 0x0;
+    while ( (objectName = static_cast<TObjString*>(nextName())) ) {
+      TObject* obj = collection->GetObject(identifier->GetName(), objectName->GetName());
+      if ( ! obj || ! obj->InheritsFrom(THnSparse::Class()) ) continue;
+      SparseBins bins;
+      if ( ! ToBins(static_cast<THnSparse*>(obj), bins) ) continue;
+      std::string fullIdentifier = Form("%s%s",id.Data(),objectName->GetName());
+      collection->Remove(fullIdentifier.c_str());
+      std::map<std::string,SparseBins>::iterator it = partial.fSparses.find(fullIdentifier);
+      if ( it == partial.fSparses.end() ) partial.fSparses[fullIdentifier] = std::move(bins);
+      else if ( ! MergeBins(it->second, bins) ) isOk = kFALSE;
+    }
+    delete objectNames;
+  }
+  delete identifiers;
+
+  if ( ! partial.fOthers ) partial.fOthers = collection;
+  else {
+    TList list;
+    list.Add(collection);
+    partial.fOthers->Merge(&list);
+    delete collection;
+  }
+  ++partial.fNfiles;
+  return isOk;
+}
+
+//________________________________________________________________________
+void AliDimuMerger::MergePartial ( Partial& target, Partial& source )
+{
+  /// Add the source to the target. The source is released.
+  /// The inconsistent sparses are counted in the errors of the target
+  for ( std::map<std::string,SparseBins>::iterator it = source.fSparses.begin(); it != source.fSparses.end(); ++it ) {
+    std::map<std::string,SparseBins>::iterator targetIt = target.fSparses.find(it->first);
+    if ( targetIt == target.fSparses.end() ) target.fSparses[it->first] = std::move(it->second);
+    else if ( ! MergeBins(targetIt->second, it->second) ) ++target.fNerrors;
+  }
+  source.fSparses.clear();
+  if ( source.fOthers ) {
+    if ( ! target.fOthers ) target.fOthers = source.fOthers;
+    else {
+      TList list;
+      list.Add(source.fOthers);
+      target.fOthers->Merge(&list);
+      delete source.fOthers;
+    }
+    source.fOthers = 0x0;
+  }
+  target.fNfiles += source.fNfiles;
+  target.fNerrors += source.fNerrors;
+  source.fNfiles = 0;
+  source.fNerrors = 0;
+}
+
+//________________________________________________________________________
+void AliDimuMerger::ClearPartial ( Partial& partial )
+{
+  /// Delete the content of the partial result
+  for ( std::map<std::string,SparseBins>::iterator it = partial.fSparses.begin(); it != partial.fSparses.end(); ++it ) delete it->second.fTemplate;
+  partial.fSparses.clear();
+  delete partial.fOthers;
+  partial.fOthers = 0x0;
+}
+
+//________________________________________________________________________
+void AliDimuMerger::RunJobs ( Int_t nJobs, Int_t nThreads, const std::function<void(Int_t)>& job )
+{
+  /// Run the independent jobs 0..nJobs-1 on nThreads threads
+  nThreads = TMath::Max(TMath::Min(nThreads,nJobs),1);
+  std::atomic<Int_t> nextJob(0);
+  auto worker = [&job,&nextJob,nJobs] () {
+    for ( Int_t ijob = nextJob++; ijob < nJobs; ijob = nextJob++ ) job(ijob);
+  };
+  std::vector<std::thread> threads;
+  for ( Int_t ithread=1; ithread<nThreads; ++ithread ) threads.push_back(std::thread(worker));
+  worker();
+  for ( std::thread& thread : threads ) thread.join();
+}
+
+//________________________________________________________________________
+AliMergeableCollection* AliDimuMerger::Run ()
+{
+  /// Merge the input files with a parallel tree reduction.
+  /// Returns the merged collection, or 0x0 if an input cannot be read
+  /// or the inputs are inconsistent
+  if ( fFileNames.empty() ) return 0x0;
+  if ( fCollectionPath.IsNull() ) fCollectionPath = FindCollectionPath(fFileNames[0].c_str());
+  if ( fCollectionPath.IsNull() ) return 0x0;
+
+  Int_t nFiles = fFileNames.size();
+  Int_t nThreads = ( fNthreads > 0 ) ? fNthreads : std::thread::hardware_concurrency();
+  nThreads = TMath::Max(TMath::Min(nThreads,nFiles),1);
+  if ( nThreads > 1 ) ROOT::EnableThreadSafety();
+  TH1::AddDirectory(kFALSE);
+
+  // Leaves: each thread streams the files into its own result
+  std::vector<Partial> partials(nThreads);
+  for ( Partial& partial : partials ) {
+    partial.fOthers = 0x0;
+    partial.fNfiles = 0;
+    partial.fNerrors = 0;
+  }
+  std::atomic<Int_t> nextFile(0);
+  RunJobs(nThreads, nThreads, [this,&partials,&nextFile,nFiles] ( Int_t ithread ) {
+    for ( Int_t ifile = nextFile++; ifile < nFiles; ifile = nextFile++ ) {
+      AliMergeableCollection* collection = ReadCollection(fFileNames[ifile].c_str(), fCollectionPath.Data());
+      if ( ! collection || ! AddCollection(collection, partials[ithread]) ) {
+        printf("E-AliDimuMerger::Run: %s cannot be merged\n", fFileNames[ifile].c_str());
+        ++partials[ithread].fNerrors;
+      }
+    }
+  });
+
+  // Pairwise reduction of the thread results
+  for ( Int_t stride=1; stride<nThreads; stride*=2 ) {
+    Int_t nPairs = ( nThreads + 2*stride - 1 ) / ( 2*stride );
+    RunJobs(nPairs, nThreads, [&partials,stride,nThreads] ( Int_t ipair ) {
+      Int_t itarget = 2 * stride * ipair;
+      if ( itarget + stride < nThreads ) MergePartial(partials[itarget], partials[itarget+stride]);
+    });
+  }
+
+  Partial& result = partials[0];
+  if ( result.fNerrors > 0 || ! result.fOthers ) {
+    printf("E-AliDimuMerger::Run: merge failed (%i errors)\n", result.fNerrors);
+    ClearPartial(result);
+    return 0x0;
+  }
+  printf("I-AliDimuMerger::Run: merged %i/%i files with %i threads\n", result.fNfiles, nFiles, nThreads);
+
+  // Fill the output sparses in parallel, then adopt them in a fixed order
+  std::vector<std::map<std::string,SparseBins>::iterator> items;
+  for ( std::map<std::string,SparseBins>::iterator it = result.fSparses.begin(); it != result.fSparses.end(); ++it ) items.push_back(it);
+  std::vector<THnSparse*> sparses(items.size(),0x0);
+  RunJobs(items.size(), nThreads, [&items,&sparses] ( Int_t iitem ) {
+    const std::string& fullIdentifier = items[iitem]->first;
+    sparses[iitem] = FromBins(items[iitem]->second, fullIdentifier.substr(fullIdentifier.rfind('/')+1).c_str());
+  });
+  AliMergeableCollection* collection = result.fOthers;
+  for ( size_t iitem=0; iitem<items.size(); ++iitem ) {
+    const std::string& fullIdentifier = items[iitem]->first;
+    collection->Adopt(fullIdentifier.substr(0,fullIdentifier.rfind('/')+1).c_str(), sparses[iitem]);
+  }
+  result.fSparses.clear();
+  return collection;
+}
+
+//________________________________________________________________________
+AliMergeableCollection* AliDimuMerger::RunStandard ()
+{
+  /// Merge the input files one by one with AliMergeableCollection::Merge
+  /// (reference for the parallel merge)
+  if ( fFileNames.empty() ) return 0x0;
+  if ( fCollectionPath.IsNull() ) fCollectionPath = FindCollectionPath(fFileNames[0].c_str());
+  if ( fCollectionPath.IsNull() ) return 0x0;
+  TH1::AddDirectory(kFALSE);
+
+  AliMergeableCollection* merged = 0x0;
+  for ( const std::string& fileName : fFileNames ) {
+    AliMergeableCollection* collection = ReadCollection(fileName.c_str(), fCollectionPath.Data());
+    if ( ! collection ) continue;
+    if ( ! merged ) {
+      merged = collection;
+      continue;
+    }
+    TList list;
+    list.Add(collection);
+    merged->Merge(&list);
+    delete collection;
+  }
+  return merged;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuMerger::Compare ( const AliMergeableCollection* reference, const AliMergeableCollection* merged )
+{
+  /// Compare the identifiers of the two collections and the bin contents, errors and entries
+  /// of their sparses and histograms. The values must agree within the float precision.
+  /// Returns kTRUE if the collections agree
+  const Double_t kPrecision = 1.e-6;
+  Int_t nDiffs = 0, nChecked = 0;
+  auto isDifferent = [kPrecision] ( Double_t val1, Double_t val2 ) {
+    return ( TMath::Abs(val1-val2) > kPrecision * TMath::Max(TMath::Abs(val1),TMath::Abs(val2)) );
+  };
+
+  if ( reference->NumberOfObjects() != merged->NumberOfObjects() ) {
+    printf("E-AliDimuMerger::Compare: %i objects in reference, %i in merged\n", reference->NumberOfObjects(), merged->NumberOfObjects());
+    ++nDiffs;
+  }
+
+  TObjArray* identifiers = reference->SortAllIdentifiers();
+  TIter nextIdentifier(identifiers);
+  TObjString* identifier = 0x0;
+  while ( (identifier = static_cast<TObjString*>(nextIdentifier())) ) {
+    TList* objectNames = reference->CreateListOfObjectNames(identifier->GetName());
+    TIter nextName(objectNames);
+    TObjString* objectName = 0x0;
+    while ( (objectName = static_cast<TObjString*>(nextName())) ) {
+      TObject* refObj = reference->GetObject(identifier->GetName(), objectName->GetName());
+      TObject* obj = merged->GetObject(identifier->GetName(), objectName->GetName());
+      TString fullIdentifier = Form("%s %s",identifier->GetName(),objectName->GetName());
+      if ( ! obj ) {
+        printf("E-AliDimuMerger::Compare: %s missing\n", fullIdentifier.Data());
+        ++nDiffs;
+        continue;
+      }
+      ++nChecked;
+      Bool_t isSame = kTRUE;
+      if ( refObj->InheritsFrom(THnSparse::Class()) ) {
+        THnSparse* refSparse = static_cast<THnSparse*>(refObj);
+        THnSparse* sparse = static_cast<THnSparse*>(obj);
+        isSame = ( refSparse->GetNbins() == sparse->GetNbins() && ! isDifferent(refSparse->GetEntries(),sparse->GetEntries()) );
+        std::vector<Int_t> coord(refSparse->GetNdimensions());
+        for ( Long64_t ibin=0; ibin<refSparse->GetNbins() && isSame; ++ibin ) {
+          Double_t content = refSparse->GetBinContent(ibin, coord.data());
+          Long64_t jbin = sparse->GetBin(coord.data(), kFALSE);
+          isSame = ( jbin >= 0 && ! isDifferent(content,sparse->GetBinContent(jbin)) && ! isDifferent(refSparse->GetBinError2(ibin),sparse->GetBinError2(jbin)) );
+        }
+      }
+      else if ( refObj->InheritsFrom(TH1::Class()) ) {
+        TH1* refHisto = static_cast<TH1*>(refObj);
+        TH1* histo = static_cast<TH1*>(obj);
+        isSame = ( refHisto->GetNcells() == histo->GetNcells() && ! isDifferent(refHisto->GetEntries(),histo->GetEntries()) );
+        for ( Int_t ibin=0; ibin<refHisto->GetNcells() && isSame; ++ibin ) {
+          isSame = ( ! isDifferent(refHisto->GetBinContent(ibin),histo->GetBinContent(ibin)) && ! isDifferent(refHisto->GetBinError(ibin),histo->GetBinError(ibin)) );
+        }
+      }
+      if ( ! isSame ) {
+        printf("E-AliDimuMerger::Compare: %s differs\n", fullIdentifier.Data());
+        ++nDiffs;
+      }
+    }
+    delete objectNames;
+  }
+  delete identifiers;
+
+  // Objects that are only in merged (e.g. renamed identifiers)
+  identifiers = merged->SortAllIdentifiers();
+  TIter nextMergedIdentifier(identifiers);
+  while ( (identifier = static_cast<TObjString*>(nextMergedIdentifier())) ) {
+    TList* objectNames = merged->CreateListOfObjectNames(identifier->GetName());
+    TIter nextName(objectNames);
+    TObjString* objectName = 0x0;
+    while ( (objectName = static_cast<TObjString*>(nextName())) ) {
+      if ( reference->GetObject(identifier->GetName(), objectName->GetName()) ) continue;
+      printf("E-AliDimuMerger::Compare: %s %s not in reference\n", identifier->GetName(), objectName->GetName());
+      ++nDiffs;
+    }
+    delete objectNames;
+  }
+  delete identifiers;
+
+  printf("I-AliDimuMerger::Compare: %i objects checked, %i differences\n", nChecked, nDiffs);
+  return ( nDiffs == 0 );
+}
+
+//________________________________________________________________________
+TDirectory* AliDimuMerger::MakeDirectory ( TDirectory* top, const TString& path, const char* title )
+{
+  /// Get the sub-directory of top (created if needed).
+  /// The title is given to the last level when it is created
+  TDirectory* dir = top;
+  TObjArray* levels = path.Tokenize("/");
+  for ( Int_t ilevel=0; ilevel<levels->GetEntries(); ++ilevel ) {
+    const char* name = levels->At(ilevel)->GetName();
+    TDirectory* subDir = dir->GetDirectory(name);
+    dir = subDir ? subDir : dir->mkdir(name, ( ilevel == levels->GetEntries()-1 ) ? title : "");
+  }
+  delete levels;
+  return dir;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuMerger::WriteSplit ( const AliMergeableCollection* collection, TDirectory* dir )
+{
+  /// Write the objects of the collection in split layout in dir
+  /// (created with title SplitTitle()):
+  /// each object is a key in the sub-directory of its identifier
+  TObjArray* identifiers = collection->SortAllIdentifiers();
+  TIter nextIdentifier(identifiers);
+  TObjString* identifier = 0x0;
+  while ( (identifier = static_cast<TObjString*>(nextIdentifier())) ) {
+    TDirectory* idDir = MakeDirectory(dir, identifier->String());
+    TList* objectNames = collection->CreateListOfObjectNames(identifier->GetName());
+    TIter nextName(objectNames);
+    TObjString* objectName = 0x0;
+    while ( (objectName = static_cast<TObjString*>(nextName())) ) {
+      idDir->WriteTObject(collection->GetObject(identifier->GetName(), objectName->GetName()), objectName->GetName());
+    }
+    delete objectNames;
+  }
+  delete identifiers;
+  return kTRUE;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuMerger::SplitFile ( const char* fileName, const char* path, const char* outFileName )
+{
+  /// Write the collection of the file in split layout in a new file (same path)
+  AliMergeableCollection* collection = ReadCollection(fileName, path);
+  if ( ! collection ) return kFALSE;
+  TFile* outFile = TFile::Open(outFileName, "RECREATE");
+  Bool_t isOk = ( outFile && ! outFile->IsZombie() );
+  if ( isOk ) {
+    isOk = WriteSplit(collection, MakeDirectory(outFile, path, SplitTitle()));
+    outFile->Close();
+  }
+  else printf("E-AliDimuMerger::SplitFile: cannot create %s\n", outFileName);
+  delete outFile;
+  delete collection;
+  return isOk;
+}
+
+//________________________________________________________________________
+void AliDimuMerger::ListObjects ( TDirectory* dir, const TString& prefix, std::set<std::string>& paths )
+{
+  /// Add the paths (relative to the split top directory) of the objects in dir
+  TIter nextKey(dir->GetListOfKeys());
+  TKey* key = 0x0;
+  while ( (key = static_cast<TKey*>(nextKey())) ) {
+    TString path = prefix + key->GetName();
+    if ( TString(key->GetClassName()) == "TDirectoryFile" ) ListObjects(dir->GetDirectory(key->GetName()), path + "/", paths);
+    else paths.insert(path.Data());
+  }
+}
+
+//________________________________________________________________________
+AliMergeableCollection* AliDimuMerger::ReadSplit ( TDirectory* dir, const char* name )
+{
+  /// Rebuild the collection from the split layout
+  AliMergeableCollection* collection = new AliMergeableCollection(name);
+  std::set<std::string> paths;
+  ListObjects(dir, "", paths);
+  for ( const std::string& path : paths ) {
+    TObject* obj = Expand(dir->Get(path.c_str()));
+    if ( ! obj ) continue;
+    size_t slash = path.rfind('/');
+    std::string identifier = ( slash == std::string::npos ) ? "/" : "/" + path.substr(0,slash+1);
+    collection->Adopt(identifier.c_str(), obj);
+  }
+  return collection;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuMerger::MergeObject ( TObject* target, TObject* source )
+{
+  /// Merge the source in the target with the Merge(TCollection*) method of the class.
+  /// Returns kFALSE if the class has no such method
+  TMethodCall merge;
+  merge.InitWithPrototype(target->IsA(), "Merge", "TCollection*");
+  if ( ! merge.IsValid() ) {
+    printf("E-AliDimuMerger::MergeObject: %s cannot be merged\n", target->GetName());
+    return kFALSE;
+  }
+  TList list;
+  list.Add(source);
+  merge.SetParam(reinterpret_cast<Long_t>(&list));
+  merge.Execute(target);
+  return kTRUE;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuMerger::RunStreaming ( const char* outFileName )
+{
+  /// Merge the input files one object at a time and write the output in split layout.
+  /// The inputs in collection layout are first split in temporary files,
+  /// one at a time, so that only one input collection is in memory.
+  /// The split files are then merged by batches of at most fMaxOpenFiles files
+  /// (see MergeSplit): the batch results are written to temporary files,
+  /// which are merged again until a single batch is left.
+  /// Returns kFALSE (and removes the output) if an input cannot be read
+  /// or if an object is inconsistent among the inputs
+  if ( fFileNames.empty() ) return kFALSE;
+  if ( fCollectionPath.IsNull() ) fCollectionPath = FindCollectionPath(fFileNames[0].c_str());
+  if ( fCollectionPath.IsNull() ) return kFALSE;
+  TH1::AddDirectory(kFALSE);
+
+  Int_t nFiles = fFileNames.size();
+  Int_t nErrors = 0;
+  std::vector<std::string> inputs;
+  std::set<std::string> temporaries;
+  for ( Int_t ifile=0; ifile<nFiles; ++ifile ) {
+    TFile* file = TFile::Open(fFileNames[ifile].c_str());
+    Bool_t isReadable = ( file && ! file->IsZombie() );
+    Bool_t isSplit = ( isReadable && file->GetDirectory(fCollectionPath.Data()) );
+    delete file;
+    if ( ! isReadable ) {
+      printf("E-AliDimuMerger::RunStreaming: cannot read %s\n", fFileNames[ifile].c_str());
+      ++nErrors;
+      continue;
+    }
+    if ( isSplit ) {
+      inputs.push_back(fFileNames[ifile]);
+      continue;
+    }
+    std::string splitName = Form("%s.split%i.root",outFileName,ifile);
+    temporaries.insert(splitName);
+    if ( ! SplitFile(fFileNames[ifile].c_str(), fCollectionPath.Data(), splitName.c_str()) ) {
+      printf("E-AliDimuMerger::RunStreaming: cannot split %s\n", fFileNames[ifile].c_str());
+      ++nErrors;
+      continue;
+    }
+    inputs.push_back(splitName);
+  }
+
+  // Merge by batches until the inputs can be opened together
+  size_t maxOpenFiles = std::max(fMaxOpenFiles,2);
+  for ( Int_t ilevel=0; nErrors == 0 && inputs.size() > maxOpenFiles; ++ilevel ) {
+    std::vector<std::string> outputs;
+    for ( size_t first=0; first<inputs.size() && nErrors == 0; first+=maxOpenFiles ) {
+      std::vector<std::string> batch(inputs.begin()+first, inputs.begin()+std::min(first+maxOpenFiles,inputs.size()));
+      if ( batch.size() == 1 ) {
+        outputs.push_back(batch[0]);
+        continue;
+      }
+      std::string batchName = Form("%s.merge%i_%lu.root",outFileName,ilevel,first/maxOpenFiles);
+      temporaries.insert(batchName);
+      if ( MergeSplit(batch, batchName.c_str(), kFALSE) ) outputs.push_back(batchName);
+      else ++nErrors;
+    }
+    // The temporary inputs of this level are no longer needed
+    for ( const std::string& input : inputs ) {
+      if ( temporaries.count(input) == 0 || std::find(outputs.begin(),outputs.end(),input) != outputs.end() ) continue;
+      gSystem->Unlink(input.c_str());
+      temporaries.erase(input);
+    }
+    inputs.swap(outputs);
+  }
+
+  Bool_t isOk = ( nErrors == 0 && ! inputs.empty() && MergeSplit(inputs, outFileName, fCompactOutput) );
+  for ( const std::string& temporary : temporaries ) gSystem->Unlink(temporary.c_str());
+  if ( isOk ) printf("I-AliDimuMerger::RunStreaming: %i files merged\n", nFiles);
+  else printf("E-AliDimuMerger::RunStreaming: merge failed\n");
+  return isOk;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuMerger::MergeSplit ( const std::vector<std::string>& inputs, const char* outFileName, Bool_t compactOutput ) const
+{
+  /// Merge the files in split layout one object at a time and write the output in split layout.
+  /// For each object path, the object is read from all the inputs,
+  /// merged, written and deleted before moving to the next one:
+  /// the peak memory is one merged object, and all the inputs are open at the same time.
+  /// Returns kFALSE (and removes the output) if an input cannot be read
+  /// or if an object is inconsistent among the inputs
+  Int_t nErrors = 0;
+  std::vector<TFile*> files;
+  std::vector<TDirectory*> dirs;
+  std::set<std::string> paths;
+  for ( const std::string& input : inputs ) {
+    TFile* file = TFile::Open(input.c_str());
+    TDirectory* dir = ( file && ! file->IsZombie() ) ? file->GetDirectory(fCollectionPath.Data()) : 0x0;
+    if ( ! dir ) {
+      printf("E-AliDimuMerger::MergeSplit: cannot read %s\n", input.c_str());
+      delete file;
+      ++nErrors;
+      continue;
+    }
+    files.push_back(file);
+    dirs.push_back(dir);
+    ListObjects(dir, "", paths);
+  }
+
+  TFile* outFile = ( nErrors == 0 ) ? TFile::Open(outFileName, "RECREATE") : 0x0;
+  Bool_t isOk = ( outFile && ! outFile->IsZombie() && ! dirs.empty() );
+  if ( isOk ) {
+    TDirectory* outDir = MakeDirectory(outFile, fCollectionPath, SplitTitle());
+    for ( const std::string& path : paths ) {
+      SparseBins bins;
+      bins.fTemplate = 0x0;
+      TObject* merged = 0x0;
+      TClass* objClass = 0x0;
+      for ( TDirectory* dir : dirs ) {
+        TObject* obj = Expand(dir->Get(path.c_str()));
+        if ( ! obj ) continue;
+        if ( ! objClass ) objClass = obj->IsA();
+        else if ( obj->IsA() != objClass ) {
+          printf("E-AliDimuMerger::MergeSplit: %s is a %s and a %s\n", path.c_str(), objClass->GetName(), obj->ClassName());
+          ++nErrors;
+          delete obj;
+          continue;
+        }
+        SparseBins objBins;
+        if ( ! merged && obj->InheritsFrom(THnSparse::Class()) && ToBins(static_cast<THnSparse*>(obj), objBins) ) {
+          if ( ! bins.fTemplate ) bins = std::move(objBins);
+          else if ( ! MergeBins(bins, objBins) ) ++nErrors;
+        }
+        else if ( ! merged ) merged = obj;
+        else {
+          if ( ! MergeObject(merged, obj) ) ++nErrors;
+          delete obj;
+        }
+      }
+      size_t slash = path.rfind('/');
+      std::string name = ( slash == std::string::npos ) ? path : path.substr(slash+1);
+      if ( bins.fTemplate ) merged = FromBins(bins, name.c_str());
+      if ( ! merged ) continue;
+      TDirectory* idDir = ( slash == std::string::npos ) ? outDir : MakeDirectory(outDir, path.substr(0,slash).c_str());
+      AliDimuCompactSparse* compact = 0x0;
+      if ( compactOutput && merged->InheritsFrom(THnSparse::Class()) ) {
+        compact = new AliDimuCompactSparse(static_cast<THnSparse*>(merged));
+        if ( ! compact->IsValid() ) {
+          delete compact;
+          compact = 0x0;
+        }
+      }
+      idDir->WriteTObject(compact ? compact : merged, name.c_str());
+      delete compact;
+      delete merged;
+    }
+    outFile->Close();
+  }
+  else if ( nErrors == 0 ) printf("E-AliDimuMerger::MergeSplit: cannot write %s\n", outFileName);
+  delete outFile;
+  for ( TFile* file : files ) delete file;
+
+  if ( nErrors > 0 ) {
+    printf("E-AliDimuMerger::MergeSplit: %i errors in the merge of %s\n", nErrors, outFileName);
+    if ( isOk ) gSystem->Unlink(outFileName);
+    isOk = kFALSE;
+  }
+  else if ( isOk ) printf("I-AliDimuMerger::MergeSplit: %lu objects merged from %lu files in %s\n", paths.size(), dirs.size(), outFileName);
+  return isOk;
+}
+
+//________________________________________________________________________
+TObject* AliDimuMerger::Expand ( TObject* obj )
+{
+  /// Decode the object if it is a compact sparse (the compact object is deleted)
+  if ( ! obj || ! obj->InheritsFrom(AliDimuCompactSparse::Class()) ) return obj;
+  THnSparse* sparse = static_cast<AliDimuCompactSparse*>(obj)->Decode();
+  delete obj;
+  return sparse;
+}
+
+//________________________________________________________________________
+void AliDimuMerger::ConvertObjects ( AliMergeableCollection* collection, Bool_t compact )
+{
+  /// Replace the sparses of the collection by compact sparses (compact = kTRUE)
+  /// or the compact sparses by sparses (compact = kFALSE)
+  TObjArray* identifiers = collection->SortAllIdentifiers();
+  TIter nextIdentifier(identifiers);
+  TObjString* identifier = 0x0;
+  while ( (identifier = static_cast<TObjString*>(nextIdentifier())) ) {
+    TString id = identifier->String();
+    if ( ! id.EndsWith("/") ) id += "/";
+    TList* objectNames = collection->CreateListOfObjectNames(identifier->GetName());
+    TIter nextName(objectNames);
+    TObjString* objectName = 0x0;
+    while ( (objectName = static_cast<TObjString*>(nextName())) ) {
+      TObject* obj = collection->GetObject(identifier->GetName(), objectName->GetName());
+      TObject* converted = 0x0;
+      if ( compact && obj && obj->InheritsFrom(THnSparse::Class()) ) {
+        AliDimuCompactSparse* compactSparse = new AliDimuCompactSparse(static_cast<THnSparse*>(obj));
+        if ( compactSparse->IsValid() ) converted = compactSparse;
+        else delete compactSparse;
+      }
+      else if ( ! compact && obj && obj->InheritsFrom(AliDimuCompactSparse::Class()) ) {
+        converted = static_cast<AliDimuCompactSparse*>(obj)->Decode();
+      }
+      if ( ! converted ) continue;
+      delete collection->Remove(Form("%s%s",id.Data(),objectName->GetName()));
+      collection->Adopt(id.Data(), converted);
+    }
+    delete objectNames;
+  }
+  delete identifiers;
+}
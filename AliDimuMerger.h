@@ -0,0 +1,106 @@
+#ifndef ALIDIMUMERGER_H
+#define ALIDIMUMERGER_H
+
+/* $Id$ */
+
+//
+// AliDimuMerger
+// Parallel merger of the AliAnalysisTaskDimu outputs
+//
+//  Author: Diego Stocco
+//
+
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "TString.h"
+
+class TDirectory;
+class THnSparse;
+class AliMergeableCollection;
+
+class AliDimuMerger {
+ public:
+  AliDimuMerger();
+  ~AliDimuMerger();
+
+  /// Add an input file
+  void AddFile ( const char* fileName ) { fFileNames.push_back(fileName); }
+  /// Path of the collection in the input files (first collection found if empty)
+  void SetCollectionPath ( const char* path ) { fCollectionPath = path; }
+  /// Number of threads (0 = number of cores)
+  void SetNthreads ( Int_t nThreads ) { fNthreads = nThreads; }
+  /// Write the sparses as AliDimuCompactSparse in RunStreaming
+  void SetCompactOutput ( Bool_t compactOutput ) { fCompactOutput = compactOutput; }
+  /// Maximum number of files open at the same time in RunStreaming
+  void SetMaxOpenFiles ( Int_t maxOpenFiles ) { fMaxOpenFiles = maxOpenFiles; }
+
+  AliMergeableCollection* Run ();
+  AliMergeableCollection* RunStandard ();
+  Bool_t RunStreaming ( const char* outFileName );
+
+  /// Path of the collection in the input files (known after Run)
+  const char* GetCollectionPath () const { return fCollectionPath.Data(); }
+
+  /// Title of the top directory of a collection in split layout
+  static const char* SplitTitle () { return "AliMergeableCollection split layout"; }
+
+  static TString FindCollectionPath ( const char* fileName );
+  static AliMergeableCollection* ReadCollection ( const char* fileName, const char* path );
+  static Bool_t WriteSplit ( const AliMergeableCollection* collection, TDirectory* dir );
+  static Bool_t SplitFile ( const char* fileName, const char* path, const char* outFileName );
+  static Bool_t Compare ( const AliMergeableCollection* reference, const AliMergeableCollection* merged );
+  /// Replace the sparses of the collection by AliDimuCompactSparse
+  static void Compact ( AliMergeableCollection* collection ) { ConvertObjects(collection, kTRUE); }
+  /// Replace the AliDimuCompactSparse of the collection by sparses
+  static void Expand ( AliMergeableCollection* collection ) { ConvertObjects(collection, kFALSE); }
+  static TObject* Expand ( TObject* obj );
+
+ private:
+  AliDimuMerger(const AliDimuMerger&);
+  AliDimuMerger& operator=(const AliDimuMerger&);
+
+  /// Filled bins of a sparse sorted by bin key
+  struct SparseBins {
+    THnSparse* fTemplate;           ///< Empty sparse with the axes of the inputs (owned)
+    std::vector<Long64_t> fKeys;    ///< Sorted bin keys
+    std::vector<Double_t> fContents; ///< Bin contents
+    std::vector<Double_t> fErrors2; ///< Squared bin errors
+    Double_t fEntries;              ///< Number of entries
+    Bool_t fHasErrors;              ///< At least one input has Sumw2
+  };
+
+  /// Partial merge result
+  struct Partial {
+    std::map<std::string,SparseBins> fSparses; ///< Sparses per full identifier (identifier + object name)
+    AliMergeableCollection* fOthers;            ///< Other objects (standard merge)
+    Int_t fNfiles;                              ///< Number of merged files
+    Int_t fNerrors;                             ///< Unreadable inputs and inconsistent objects
+  };
+
+  static Bool_t GetRadix ( const THnSparse* sparse, std::vector<Long64_t>& radix );
+  static Bool_t IsSameBinning ( const THnSparse* sparse1, const THnSparse* sparse2 );
+  static Bool_t ToBins ( THnSparse* sparse, SparseBins& bins );
+  static THnSparse* FromBins ( SparseBins& bins, const char* name );
+  static Bool_t MergeBins ( SparseBins& target, SparseBins& source );
+  static void MergePartial ( Partial& target, Partial& source );
+  static void ClearPartial ( Partial& partial );
+  static void RunJobs ( Int_t nJobs, Int_t nThreads, const std::function<void(Int_t)>& job );
+  static Bool_t AddCollection ( AliMergeableCollection* collection, Partial& partial );
+  static Bool_t MergeObject ( TObject* target, TObject* source );
+  static TDirectory* MakeDirectory ( TDirectory* top, const TString& path, const char* title = "" );
+  static void ListObjects ( TDirectory* dir, const TString& prefix, std::set<std::string>& paths );
+  static AliMergeableCollection* ReadSplit ( TDirectory* dir, const char* name );
+  static void ConvertObjects ( AliMergeableCollection* collection, Bool_t compact );
+  Bool_t MergeSplit ( const std::vector<std::string>& inputs, const char* outFileName, Bool_t compactOutput ) const;
+
+  std::vector<std::string> fFileNames; ///< Input files
+  TString fCollectionPath; ///< Path of the collection in the files
+  Int_t fNthreads; ///< Number of threads
+  Bool_t fCompactOutput; ///< Write compact sparses
+  Int_t fMaxOpenFiles; ///< Maximum number of open files in RunStreaming
+};
+
+#endif
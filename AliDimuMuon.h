@@ -0,0 +1,93 @@
+#ifndef ALIDIMUMUON_H
+#define ALIDIMUMUON_H
+
+/* $Id$ */
+
+//
+// AliDimuMuon
+// Compact muon representation and fast pair kinematics
+//
+//  Author: Diego Stocco
+//
+
+#include <algorithm>
+#include <cmath>
+#include "Rtypes.h"
+
+/// Compact muon: the kinematics needed to build pairs, with no TObject overhead.
+/// The kinematics are kept in double precision, so that the pairs are the same
+/// as with the TLorentzVector of the tracks (AliAnalysisMuonUtility::GetTrackPair)
+struct AliDimuMuon {
+  Double_t fPx;       ///< Px
+  Double_t fPy;       ///< Py
+  Double_t fPz;       ///< Pz
+  Double_t fE;        ///< Energy (computed with the muon mass)
+  Char_t fCharge;     ///< Charge
+  Char_t fTrigLevel;  ///< Highest trigger pt-cut level passed by the track (0 if none)
+
+  /// Set muon
+  void Set ( Double_t px, Double_t py, Double_t pz, Double_t energy, Int_t charge, Int_t trigLevel )
+  {
+    fPx = px;
+    fPy = py;
+    fPz = pz;
+    fE = energy;
+    fCharge = charge;
+    fTrigLevel = trigLevel;
+  }
+};
+
+/// Fast pair kinematics
+/// Avoids building TLorentzVectors for each pair
+class AliDimuPair {
+ public:
+  /// Get pair pt, rapidity, phi (in [0,2pi]) and invariant mass
+  static void Kinematics ( const AliDimuMuon& mu1, const AliDimuMuon& mu2, Double_t& pt, Double_t& y, Double_t& phi, Double_t& invMass )
+  {
+    Double_t px = (Double_t)mu1.fPx + (Double_t)mu2.fPx;
+    Double_t py = (Double_t)mu1.fPy + (Double_t)mu2.fPy;
+    Double_t pz = (Double_t)mu1.fPz + (Double_t)mu2.fPz;
+    Double_t energy = (Double_t)mu1.fE + (Double_t)mu2.fE;
+    Double_t pt2 = px*px + py*py;
+    pt = std::sqrt(pt2);
+    y = 0.5*std::log((energy+pz)/(energy-pz));
+    phi = ( px == 0. && py == 0. ) ? 0. : std::atan2(py,px);
+    if ( phi < 0. ) phi += 2.*std::acos(-1.); // phi in [0,2pi]
+    // Same convention as TLorentzVector::M()
+    Double_t mass2 = energy*energy - pt2 - pz*pz;
+    invMass = ( mass2 < 0. ) ? -std::sqrt(-mass2) : std::sqrt(mass2);
+  }
+
+  /// Count the SPD tracklets in the hemisphere of the pair for each tracklet distance cut.
+  /// The distance cuts must be sorted in decreasing order.
+  /// The last element (nDistCuts) is the number of tracklets without distance cut
+  static void CountTracklets ( Double_t pairPhi, const Double_t* trackletPhi, const Double_t* trackletDist, Int_t nTracklets, const Double_t* distCuts, Int_t nDistCuts, Int_t* nTrackletsPerCut )
+  {
+    const Double_t halfPi = 3.14159265358979323846/2.;
+    std::fill(nTrackletsPerCut, nTrackletsPerCut+nDistCuts+1, 0);
+    for ( Int_t itrk=0; itrk<nTracklets; ++itrk ) {
+      if ( std::abs(pairPhi - trackletPhi[itrk]) > halfPi ) continue; // MODIFY ME!
+      for ( Int_t icut=0; icut<nDistCuts; ++icut ) {
+        // Cuts are ordered, so if it does not pass this cut
+        // it will not pass the following either
+        if ( trackletDist[itrk] > distCuts[icut] ) break;
+        ++nTrackletsPerCut[icut];
+      }
+      ++nTrackletsPerCut[nDistCuts];
+    }
+  }
+
+  /// Same-sign pair (same convention as the task: charge product >= 0)
+  static Bool_t IsSameSign ( const AliDimuMuon& mu1, const AliDimuMuon& mu2 ) { return ( mu1.fCharge * mu2.fCharge >= 0 ); }
+
+  /// Check if the pair passes the trigger pt-cut level of the trigger class.
+  /// Mirrors AliMuonPairCuts::TrackPtCutMatchTrigClass:
+  /// for dimuon triggers both muons must pass the level, for single muon triggers only one.
+  static Bool_t PassTrigPtCut ( Int_t trigLevel1, Int_t trigLevel2, Int_t classPtCutLevel, Bool_t isDimuonClass )
+  {
+    Int_t pairLevel = isDimuonClass ? std::min(trigLevel1,trigLevel2) : std::max(trigLevel1,trigLevel2);
+    return ( pairLevel >= classPtCutLevel );
+  }
+};
+
+#endif
@@ -0,0 +1,227 @@
+/**************************************************************************
+ * Copyright(c) 1998-2007, ALICE Experiment at CERN, All rights reserved. *
+ *                                                                        *
+ * Author: The ALICE Off-line Project.                                    *
+ * Contributors are mentioned in the code where appropriate.              *
+ *                                                                        *
+ * Permission to use, copy, modify and distribute this software and its   *
+ * documentation strictly for non-commercial purposes is hereby granted   *
+ * without fee, provided that the above copyright notice appears in all   *
+ * copies and that both the copyright notice and this permission notice   *
+ * appear in the supporting documentation. The authors make no claims     *
+ * about the suitability of this software for any purpose. It is          *
+ * provided "as is" without express or implied warranty.                  *
+ **************************************************************************/
+
+/* $Id$ */
+
+//-----------------------------------------------------------------------------
+/// \class AliDimuOccupancy
+/// Number of filled bins of each sparse of the output, sampled every
+/// fSampleEvents events (growth curve), and report of the memory used
+/// by each identifier.
+/// The curves of different workers are summed sample by sample,
+/// i.e. at the same number of events per worker. After the merge, the filled bins
+/// are therefore a per-worker sum: a bin filled by several workers is counted
+/// once per worker, so the sum is an upper bound of the filled bins of the
+/// merged sparses (given by PrintReport on the merged output).
+///
+/// \author Diego Stocco
+//-----------------------------------------------------------------------------
+
+#include "AliDimuOccupancy.h"
+
+#include <algorithm>
+#include "TCollection.h"
+#include "TList.h"
+#include "TObjArray.h"
+#include "TObjString.h"
+#include "TAxis.h"
+#include "THnSparse.h"
+#include "AliMergeableCollection.h"
+
+/// \cond CLASSIMP
+ClassImp(AliDimuOccupancy) // Class implementation in ROOT context
+/// \endcond
+
+//________________________________________________________________________
+AliDimuOccupancy::AliDimuOccupancy() :
+TNamed(),
+fSampleEvents(0),
+fNworkers(1),
+fEvents(),
+fIdentifiers(),
+fFilledBins()
+{
+  /// Default ctor.
+}
+
+//________________________________________________________________________
+AliDimuOccupancy::AliDimuOccupancy ( const char* name, Int_t sampleEvents ) :
+TNamed(name,"Filled bins of the sparses"),
+fSampleEvents(sampleEvents),
+fNworkers(1),
+fEvents(),
+fIdentifiers(),
+fFilledBins()
+{
+  /// Ctor.
+}
+
+//________________________________________________________________________
+AliDimuOccupancy::~AliDimuOccupancy()
+{
+  /// Dtor.
+}
+
+//________________________________________________________________________
+Int_t AliDimuOccupancy::FindIdentifier ( const char* identifier ) const
+{
+  /// Index of the identifier (-1 if not found)
+  for ( size_t id=0; id<fIdentifiers.size(); ++id ) {
+    if ( fIdentifiers[id] == identifier ) return id;
+  }
+  return -1;
+}
+
+//________________________________________________________________________
+Int_t AliDimuOccupancy::AddIdentifier ( const char* identifier )
+{
+  /// Add the identifier (if needed) and return its index.
+  /// The new identifier has no filled bins in the previous samples
+  Int_t id = FindIdentifier(identifier);
+  if ( id >= 0 ) return id;
+  fIdentifiers.push_back(identifier);
+  fFilledBins.push_back(std::vector<Long64_t>(fEvents.size(),0));
+  return fIdentifiers.size()-1;
+}
+
+//________________________________________________________________________
+void AliDimuOccupancy::AddSample ( Long64_t nEvents, const std::vector<THnSparse*>& sparses )
+{
+  /// Add a sample: sparses[id] is the sparse of the identifier id
+  fEvents.push_back(nEvents);
+  for ( size_t id=0; id<fFilledBins.size(); ++id ) {
+    fFilledBins[id].resize(fEvents.size(),0);
+    if ( id < sparses.size() && sparses[id] ) fFilledBins[id].back() = sparses[id]->GetNbins();
+  }
+}
+
+//________________________________________________________________________
+Long64_t AliDimuOccupancy::Merge ( TCollection* list )
+{
+  /// Sum the curves sample by sample (per-worker sum, see the class description)
+  if ( ! list ) return 0;
+  TIter next(list);
+  TObject* obj = 0x0;
+  while ( (obj = next()) ) {
+    const AliDimuOccupancy* other = dynamic_cast<const AliDimuOccupancy*>(obj);
+    if ( ! other ) {
+      printf("E-AliDimuOccupancy::Merge: cannot merge %s (%s)\n", obj->GetName(), obj->ClassName());
+      return -1;
+    }
+    if ( other->fSampleEvents != fSampleEvents ) {
+      printf("E-AliDimuOccupancy::Merge: different sampling (%i and %i events)\n", fSampleEvents, other->fSampleEvents);
+      return -1;
+    }
+    if ( other->fEvents.size() > fEvents.size() ) {
+      fEvents.resize(other->fEvents.size(),0);
+      for ( auto& filledBins : fFilledBins ) filledBins.resize(fEvents.size(),0);
+    }
+    for ( size_t isample=0; isample<other->fEvents.size(); ++isample ) fEvents[isample] += other->fEvents[isample];
+    fNworkers += other->fNworkers;
+    for ( Int_t jd=0; jd<other->GetNidentifiers(); ++jd ) {
+      Int_t id = AddIdentifier(other->fIdentifiers[jd].Data());
+      for ( size_t isample=0; isample<other->fFilledBins[jd].size(); ++isample ) fFilledBins[id][isample] += other->fFilledBins[jd][isample];
+    }
+  }
+  return fEvents.size();
+}
+
+//________________________________________________________________________
+void AliDimuOccupancy::Print ( Option_t* option ) const
+{
+  /// Print the growth curves: the total, and per identifier with option "all".
+  /// With several workers the events and the filled bins are summed over the workers
+  TString sopt(option);
+  sopt.ToLower();
+  Int_t nSamples = GetNsamples();
+  printf("Filled bins every %i events per worker (%i samples)\n", fSampleEvents, nSamples);
+  if ( fNworkers > 1 ) printf("Sum over %i workers: a bin filled by several workers is counted once per worker (upper bound of the merged filled bins)\n", fNworkers);
+  printf("%12s %12s", "events", fNworkers > 1 ? "sum of bins" : "total");
+  if ( sopt.Contains("all") ) {
+    for ( Int_t id=0; id<GetNidentifiers(); ++id ) printf(" %s", fIdentifiers[id].Data());
+  }
+  printf("\n");
+  for ( Int_t isample=0; isample<nSamples; ++isample ) {
+    Long64_t total = 0;
+    for ( Int_t id=0; id<GetNidentifiers(); ++id ) total += GetFilledBins(id,isample);
+    printf("%12lld %12lld", fEvents[isample], total);
+    if ( sopt.Contains("all") ) {
+      for ( Int_t id=0; id<GetNidentifiers(); ++id ) printf(" %lld", GetFilledBins(id,isample));
+    }
+    printf("\n");
+  }
+}
+
+//________________________________________________________________________
+Long64_t AliDimuOccupancy::EstimateBytes ( const THnSparse* sparse )
+{
+  /// Estimate of the memory allocated by the sparse (bytes):
+  /// the chunks (compact coordinates, contents and squared errors of chunk size bins each)
+  /// and the hash table of the bins (3 words per slot, half filled)
+  Int_t nBits = 0;
+  for ( Int_t idim=0; idim<sparse->GetNdimensions(); ++idim ) {
+    for ( Int_t nBins = sparse->GetAxis(idim)->GetNbins()+1; nBins > 0; nBins >>= 1 ) ++nBits;
+  }
+  Long64_t coordinateSize = ( nBits + 7 ) / 8;
+  Long64_t contentSize = 8;
+  if ( sparse->InheritsFrom(THnSparseF::Class()) || sparse->InheritsFrom(THnSparseI::Class()) ) contentSize = 4;
+  else if ( sparse->InheritsFrom(THnSparseS::Class()) ) contentSize = 2;
+  else if ( sparse->InheritsFrom(THnSparseC::Class()) ) contentSize = 1;
+  Long64_t errorSize = sparse->GetCalculateErrors() ? 8 : 0;
+  Long64_t allocatedBins = (Long64_t)sparse->GetNChunks() * sparse->GetChunkSize();
+  return allocatedBins * ( coordinateSize + contentSize + errorSize ) + 2 * sparse->GetNbins() * 3 * sizeof(Long64_t);
+}
+
+//________________________________________________________________________
+void AliDimuOccupancy::PrintReport ( AliMergeableCollection* collection, const char* objectName )
+{
+  /// Memory and occupancy of the sparses of the collection, per identifier,
+  /// sorted by decreasing memory: filled bins, fraction of the cells that are filled,
+  /// allocated memory (estimate), number of fills (entries) and bytes per fill
+  struct Entry {
+    TString fIdentifier; ///< Identifier
+    Long64_t fBins;      ///< Filled bins
+    Double_t fCells;     ///< Number of cells (with under/overflows)
+    Long64_t fBytes;     ///< Allocated bytes
+    Double_t fFills;     ///< Fills
+  };
+  std::vector<Entry> entries;
+  TObjArray* identifiers = collection->SortAllIdentifiers();
+  TIter nextIdentifier(identifiers);
+  TObjString* identifier = 0x0;
+  while ( (identifier = static_cast<TObjString*>(nextIdentifier())) ) {
+    THnSparse* sparse = dynamic_cast<THnSparse*>(collection->GetObject(identifier->GetName(), objectName));
+    if ( ! sparse ) continue;
+    Double_t nCells = 1.;
+    for ( Int_t idim=0; idim<sparse->GetNdimensions(); ++idim ) nCells *= sparse->GetAxis(idim)->GetNbins() + 2;
+    Entry entry = { identifier->GetName(), sparse->GetNbins(), nCells, EstimateBytes(sparse), sparse->GetEntries() };
+    entries.push_back(entry);
+  }
+  delete identifiers;
+  std::sort(entries.begin(), entries.end(), [] ( const Entry& e1, const Entry& e2 ) { return e1.fBytes > e2.fBytes; });
+
+  Long64_t totalBins = 0, totalBytes = 0;
+  Double_t totalFills = 0.;
+  printf("%-60s %12s %10s %12s %14s %10s\n", "identifier", "filled bins", "occupancy", "memory (kB)", "fills", "bytes/fill");
+  for ( const Entry& entry : entries ) {
+    printf("%-60s %12lld %10.2e %12.1f %14.0f %10.1f\n", entry.fIdentifier.Data(), entry.fBins, entry.fBins/entry.fCells, entry.fBytes/1024.,
+           entry.fFills, entry.fFills > 0. ? entry.fBytes/entry.fFills : 0.);
+    totalBins += entry.fBins;
+    totalBytes += entry.fBytes;
+    totalFills += entry.fFills;
+  }
+  printf("%-60s %12lld %10s %12.1f %14.0f %10.1f\n", Form("total (%lu identifiers)",entries.size()), totalBins, "", totalBytes/1024.,
+         totalFills, totalFills > 0. ? totalBytes/totalFills : 0.);
+}
@@ -0,0 +1,64 @@
+#ifndef ALIDIMUOCCUPANCY_H
+#define ALIDIMUOCCUPANCY_H
+
+/* $Id$ */
+
+//
+// AliDimuOccupancy
+// Growth of the filled bins of the dimuon sparses and memory report
+//
+//  Author: Diego Stocco
+//
+
+#include <vector>
+#include "TNamed.h"
+#include "TString.h"
+
+class TCollection;
+class THnSparse;
+class AliMergeableCollection;
+
+class AliDimuOccupancy : public TNamed {
+ public:
+  AliDimuOccupancy();
+  AliDimuOccupancy ( const char* name, Int_t sampleEvents );
+  virtual ~AliDimuOccupancy();
+
+  Int_t AddIdentifier ( const char* identifier );
+  void AddSample ( Long64_t nEvents, const std::vector<THnSparse*>& sparses );
+
+  /// Number of events between two samples
+  Int_t GetSampleEvents () const { return fSampleEvents; }
+  /// Number of identifiers
+  Int_t GetNidentifiers () const { return fIdentifiers.size(); }
+  /// Identifier
+  const TString& GetIdentifier ( Int_t id ) const { return fIdentifiers[id]; }
+  /// Number of workers whose curves are summed
+  Int_t GetNworkers () const { return fNworkers; }
+  /// Number of samples
+  Int_t GetNsamples () const { return fEvents.size(); }
+  /// Number of events of the sample
+  Long64_t GetEvents ( Int_t isample ) const { return fEvents[isample]; }
+  /// Filled bins of the identifier in the sample, summed over the workers
+  Long64_t GetFilledBins ( Int_t id, Int_t isample ) const { return ( isample < (Int_t)fFilledBins[id].size() ) ? fFilledBins[id][isample] : 0; }
+
+  Long64_t Merge ( TCollection* list );
+
+  virtual void Print ( Option_t* option = "" ) const;
+
+  static Long64_t EstimateBytes ( const THnSparse* sparse );
+  static void PrintReport ( AliMergeableCollection* collection, const char* objectName = "DimuSparse" );
+
+ private:
+  Int_t FindIdentifier ( const char* identifier ) const;
+
+  Int_t fSampleEvents;                              ///< Number of events between two samples
+  Int_t fNworkers;                                  ///< Number of workers whose curves are summed
+  std::vector<Long64_t> fEvents;                    ///< Number of events per sample
+  std::vector<TString> fIdentifiers;                ///< Identifiers
+  std::vector<std::vector<Long64_t> > fFilledBins;  ///< Filled bins per identifier and sample
+
+  ClassDef(AliDimuOccupancy, 2); // Growth of the filled bins of the sparses
+};
+
+#endif
@@ -0,0 +1,90 @@
+/**************************************************************************
+ * Copyright(c) 1998-2007, ALICE Experiment at CERN, All rights reserved. *
+ *                                                                        *
+ * Author: The ALICE Off-line Project.                                    *
+ * Contributors are mentioned in the code where appropriate.              *
+ *                                                                        *
+ * Permission to use, copy, modify and distribute this software and its   *
+ * documentation strictly for non-commercial purposes is hereby granted   *
+ * without fee, provided that the above copyright notice appears in all   *
+ * copies and that both the copyright notice and this permission notice   *
+ * appear in the supporting documentation. The authors make no claims     *
+ * about the suitability of this software for any purpose. It is          *
+ * provided "as is" without express or implied warranty.                  *
+ **************************************************************************/
+
+/* $Id$ */
+
+//-----------------------------------------------------------------------------
+/// \class AliDimuProjectionStore
+/// Store of the projections of the dimuon sparses.
+/// The identifier levels (trigger class, tracklet cut, source, charge)
+/// are mapped to integer ids once, when the identifiers are parsed.
+/// The histograms are then accessed by (ids, projection, type) in a flat array,
+/// so that the reconstructed and generated projections are paired
+/// by changing the trigger class id only.
+///
+/// \author Diego Stocco
+//-----------------------------------------------------------------------------
+
+#include "AliDimuProjectionStore.h"
+
+#include <algorithm>
+#include "TH1.h"
+#include "THnSparse.h"
+
+//________________________________________________________________________
+AliDimuProjectionStore::AliDimuProjectionStore ( Int_t nProjections ) :
+fNprojections(nProjections),
+fKeys(kNkeys),
+fHistos(),
+fSparses(),
+fEffMaps(),
+fIsOwner(kFALSE)
+{
+  /// Ctor.
+}
+
+//________________________________________________________________________
+AliDimuProjectionStore::~AliDimuProjectionStore()
+{
+  /// Dtor.
+  if ( fIsOwner ) {
+    for ( TH1* histo : fHistos ) delete histo;
+  }
+  for ( THnSparse* effMap : fEffMaps ) delete effMap;
+}
+
+//________________________________________________________________________
+Int_t AliDimuProjectionStore::AddKey ( Int_t ikey, const TString& name )
+{
+  /// Get the id of the key value (added if not there).
+  /// Keys cannot be added after Book
+  Int_t id = FindKey(ikey, name);
+  if ( id >= 0 ) return id;
+  if ( ! fHistos.empty() ) {
+    printf("E-AliDimuProjectionStore::AddKey: cannot add %s after booking\n", name.Data());
+    return -1;
+  }
+  fKeys[ikey].push_back(name);
+  return fKeys[ikey].size() - 1;
+}
+
+//________________________________________________________________________
+Int_t AliDimuProjectionStore::FindKey ( Int_t ikey, const TString& name ) const
+{
+  /// Get the id of the key value (-1 if not found)
+  std::vector<TString>::const_iterator it = std::find(fKeys[ikey].begin(), fKeys[ikey].end(), name);
+  return ( it == fKeys[ikey].end() ) ? -1 : it - fKeys[ikey].begin();
+}
+
+//________________________________________________________________________
+void AliDimuProjectionStore::Book ()
+{
+  /// Allocate the slots for all the keys
+  size_t nIdentifiers = 1;
+  for ( Int_t ikey=0; ikey<kNkeys; ++ikey ) nIdentifiers *= fKeys[ikey].size();
+  fHistos.assign(kNtypes * nIdentifiers * fNprojections, 0x0);
+  fSparses.assign(nIdentifiers, 0x0);
+  fEffMaps.assign(nIdentifiers, 0x0);
+}
@@ -0,0 +1,93 @@
+#ifndef ALIDIMUPROJECTIONSTORE_H
+#define ALIDIMUPROJECTIONSTORE_H
+
+/* $Id$ */
+
+//
+// AliDimuProjectionStore
+// Projections of the dimuon sparses indexed by integer keys
+//
+//  Author: Diego Stocco
+//
+
+#include <vector>
+#include "TString.h"
+
+class TH1;
+class THnSparse;
+
+class AliDimuProjectionStore {
+ public:
+  AliDimuProjectionStore ( Int_t nProjections );
+  ~AliDimuProjectionStore();
+
+  /// Keys (levels of the identifier)
+  enum EKey {
+    kTrigClass,       ///< Trigger class
+    kTrackletDistCut, ///< Tracklet distance cut
+    kSrc,             ///< Pair source
+    kChargeType,      ///< Charge type
+    kNkeys            ///< Number of keys
+  };
+
+  /// Histogram types
+  enum EType {
+    kYield,      ///< Projection
+    kEfficiency, ///< Projection divided by the generated one
+    kNtypes      ///< Number of types
+  };
+
+  Int_t AddKey ( Int_t ikey, const TString& name );
+  Int_t FindKey ( Int_t ikey, const TString& name ) const;
+  /// Number of values of the key
+  Int_t GetNkeys ( Int_t ikey ) const { return fKeys[ikey].size(); }
+  /// Name of the value of the key
+  const TString& GetKeyName ( Int_t ikey, Int_t id ) const { return fKeys[ikey][id]; }
+  /// Number of projections
+  Int_t GetNprojections () const { return fNprojections; }
+
+  void Book ();
+
+  /// Histogram slot
+  TH1*& At ( Int_t trigClass, Int_t cut, Int_t src, Int_t charge, Int_t proj, Int_t type = kYield )
+  { return fHistos[GetIndex(trigClass,cut,src,charge,proj,type)]; }
+  /// Histogram (0x0 if missing)
+  TH1* Get ( Int_t trigClass, Int_t cut, Int_t src, Int_t charge, Int_t proj, Int_t type = kYield ) const
+  { return ( trigClass < 0 ) ? 0x0 : fHistos[GetIndex(trigClass,cut,src,charge,proj,type)]; }
+
+  /// Input sparse slot (not owned)
+  THnSparse*& SparseAt ( Int_t trigClass, Int_t cut, Int_t src, Int_t charge )
+  { return fSparses[GetIndex(trigClass,cut,src,charge,0,0)/fNprojections]; }
+  /// Input sparse (0x0 if missing)
+  THnSparse* GetSparse ( Int_t trigClass, Int_t cut, Int_t src, Int_t charge ) const
+  { return ( trigClass < 0 ) ? 0x0 : fSparses[GetIndex(trigClass,cut,src,charge,0,0)/fNprojections]; }
+  /// Efficiency map slot
+  THnSparse*& EffMapAt ( Int_t trigClass, Int_t cut, Int_t src, Int_t charge )
+  { return fEffMaps[GetIndex(trigClass,cut,src,charge,0,0)/fNprojections]; }
+  /// Efficiency map (0x0 if missing)
+  THnSparse* GetEffMap ( Int_t trigClass, Int_t cut, Int_t src, Int_t charge ) const
+  { return ( trigClass < 0 ) ? 0x0 : fEffMaps[GetIndex(trigClass,cut,src,charge,0,0)/fNprojections]; }
+
+  /// Trigger class of the generated particles (-1 if missing)
+  Int_t GetGeneratedTrigClass () const { return FindKey(kTrigClass,"generated"); }
+
+  /// The store deletes the histograms (the efficiency maps are always deleted)
+  void SetOwner ( Bool_t isOwner = kTRUE ) { fIsOwner = isOwner; }
+
+ private:
+  AliDimuProjectionStore(const AliDimuProjectionStore&);
+  AliDimuProjectionStore& operator=(const AliDimuProjectionStore&);
+
+  /// Index of the slot
+  size_t GetIndex ( Int_t trigClass, Int_t cut, Int_t src, Int_t charge, Int_t proj, Int_t type ) const
+  { return ( ( ( ( static_cast<size_t>(type) * fKeys[kTrigClass].size() + trigClass ) * fKeys[kTrackletDistCut].size() + cut ) * fKeys[kSrc].size() + src ) * fKeys[kChargeType].size() + charge ) * fNprojections + proj; }
+
+  Int_t fNprojections; ///< Number of projections
+  std::vector<std::vector<TString> > fKeys; ///< Names of the values of the keys
+  std::vector<TH1*> fHistos; ///< Histograms
+  std::vector<THnSparse*> fSparses; ///< Input sparses per identifier
+  std::vector<THnSparse*> fEffMaps; ///< Efficiency maps per identifier
+  Bool_t fIsOwner; ///< Delete the histograms
+};
+
+#endif
@@ -0,0 +1,498 @@
+/**************************************************************************
+ * Copyright(c) 1998-2007, ALICE Experiment at CERN, All rights reserved. *
+ *                                                                        *
+ * Author: The ALICE Off-line Project.                                    *
+ * Contributors are mentioned in the code where appropriate.              *
+ *                                                                        *
+ * Permission to use, copy, modify and distribute this software and its   *
+ * documentation strictly for non-commercial purposes is hereby granted   *
+ * without fee, provided that the above copyright notice appears in all   *
+ * copies and that both the copyright notice and this permission notice   *
+ * appear in the supporting documentation. The authors make no claims     *
+ * about the suitability of this software for any purpose. It is          *
+ * provided "as is" without express or implied warranty.                  *
+ **************************************************************************/
+
+/* $Id$ */
+
+//-----------------------------------------------------------------------------
+/// \class AliDimuSkimWriter
+/// Writes the selected muons, the SPD tracklets and the event information
+/// used by AliAnalysisTaskDimu to a compact columnar binary file.
+/// See AliDimuSkim for the layout.
+/// The events are buffered in memory and written in blocks,
+/// so that the skim can be re-analysed with sequential reads
+/// of memory mapped columns.
+///
+/// \class AliDimuSkimReader
+/// Maps the skim file in memory (read-only) and gives direct access
+/// to the columns of each block, without copies.
+///
+/// \author Diego Stocco
+//-----------------------------------------------------------------------------
+
+#include "AliDimuSkim.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//________________________________________________________________________
+AliDimuSkimWriter::AliDimuSkimWriter ( const char* fileName, Int_t blockSize ) :
+fFile(0x0),
+fBlockSize(blockSize),
+fPosition(0),
+fNeventsWritten(0),
+fTrigClasses(),
+fTrigClassLevelRun(),
+fRunTrigClasses(),
+fPairTypes(),
+fPairTypeIndex(),
+fBlocks()
+{
+  /// Ctor.
+  fFile = std::fopen(fileName,"wb");
+  if ( ! fFile ) return;
+
+  AliDimuSkim::FileHeader header;
+  std::memset(&header,0,sizeof(header));
+  std::memcpy(header.fMagic,AliDimuSkim::FileMagic(),sizeof(header.fMagic));
+  header.fVersion = AliDimuSkim::kVersion;
+  header.fHeaderSize = sizeof(header);
+  Write(&header,sizeof(header));
+  Pad(AliDimuSkim::Align(fPosition)-fPosition);
+
+  ClearBlock();
+}
+
+//________________________________________________________________________
+AliDimuSkimWriter::~AliDimuSkimWriter()
+{
+  /// Dtor.
+  Close();
+}
+
+//________________________________________________________________________
+Int_t AliDimuSkimWriter::GetTrigClassIndex ( const char* trigClass ) const
+{
+  /// Get index of trigger class in table (-1 if not found)
+  for ( size_t itrig=0; itrig<fTrigClasses.size(); ++itrig ) {
+    if ( fTrigClasses[itrig] == trigClass ) return itrig;
+  }
+  return -1;
+}
+
+//________________________________________________________________________
+Int_t AliDimuSkimWriter::AddTrigClass ( const char* trigClass )
+{
+  /// Add trigger class to table (if not there) and return its index.
+  /// The trigger mask has 64 bits: -1 is returned if the table is full
+  Int_t index = GetTrigClassIndex(trigClass);
+  if ( index >= 0 ) return index;
+  if ( fTrigClasses.size() >= 64 ) return -1;
+  fTrigClasses.push_back(trigClass);
+  fTrigClassLevelRun.push_back(-1);
+  return fTrigClasses.size() - 1;
+}
+
+//________________________________________________________________________
+void AliDimuSkimWriter::SetTrigClassPtCutLevel ( Int_t run, Int_t index, Int_t ptCutLevel, Bool_t isDimuon )
+{
+  /// Set the trigger pt-cut level of the trigger class (index in table) in the run.
+  /// The level is stored once per run and class
+  if ( fTrigClassLevelRun[index] == run ) return;
+  fTrigClassLevelRun[index] = run;
+  AliDimuSkim::RunTrigClass entry = { run, index, ptCutLevel, isDimuon };
+  fRunTrigClasses.push_back(entry);
+}
+
+//________________________________________________________________________
+UShort_t AliDimuSkimWriter::GetPairTypeIndex ( const char* pairType )
+{
+  /// Get index of pair type in table (added if not there)
+  std::map<std::string,UShort_t>::const_iterator it = fPairTypeIndex.find(pairType);
+  if ( it != fPairTypeIndex.end() ) return it->second;
+  UShort_t index = fPairTypes.size();
+  fPairTypes.push_back(pairType);
+  fPairTypeIndex[pairType] = index;
+  return index;
+}
+
+//________________________________________________________________________
+void AliDimuSkimWriter::BeginEvent ( Int_t run, Double_t centrality, ULong64_t trigMask )
+{
+  /// Start new event
+  fRun.push_back(run);
+  fCentrality.push_back(centrality);
+  fTrigMask.push_back(trigMask);
+  fFlags.push_back(0);
+}
+
+//________________________________________________________________________
+void AliDimuSkimWriter::AddMuon ( const AliDimuMuon& muon, Int_t step, Int_t mcType, Int_t mcLabel )
+{
+  /// Add muon to current event
+  fPx.push_back(muon.fPx);
+  fPy.push_back(muon.fPy);
+  fPz.push_back(muon.fPz);
+  fE.push_back(muon.fE);
+  fCharge.push_back(muon.fCharge);
+  fTrigLevel.push_back(muon.fTrigLevel);
+  fStep.push_back(step);
+  fMCType.push_back(mcType);
+  fMCLabel.push_back(mcLabel);
+}
+
+//________________________________________________________________________
+void AliDimuSkimWriter::AddPair ( UShort_t pairType, Int_t commonAncestor )
+{
+  /// Add pair to current event
+  fPairType.push_back(pairType);
+  fPairAncestor.push_back(commonAncestor);
+}
+
+//________________________________________________________________________
+void AliDimuSkimWriter::AddTracklet ( Double_t phi, Double_t dist )
+{
+  /// Add tracklet to current event
+  fTrackletPhi.push_back(phi);
+  fTrackletDist.push_back(dist);
+}
+
+//________________________________________________________________________
+void AliDimuSkimWriter::EndEvent ()
+{
+  /// Close current event
+  if ( fTrackletPhi.size() > fTrackletBegin.back() ) fFlags.back() |= AliDimuSkim::kHasTracklets;
+  fMuonBegin.push_back(fPx.size());
+  fPairBegin.push_back(fPairType.size());
+  fTrackletBegin.push_back(fTrackletPhi.size());
+  if ( (Int_t)fRun.size() >= fBlockSize ) FlushBlock();
+}
+
+//________________________________________________________________________
+void AliDimuSkimWriter::Write ( const void* data, ULong64_t size )
+{
+  /// Write to file
+  if ( size == 0 ) return;
+  std::fwrite(data,1,size,fFile);
+  fPosition += size;
+}
+
+//________________________________________________________________________
+void AliDimuSkimWriter::Pad ( ULong64_t size )
+{
+  /// Write padding
+  static const Char_t zeros[AliDimuSkim::kAlignment] = {0};
+  Write(zeros,size);
+}
+
+//________________________________________________________________________
+void AliDimuSkimWriter::ClearBlock ()
+{
+  /// Clear block columns
+  fRun.clear();
+  fCentrality.clear();
+  fTrigMask.clear();
+  fFlags.clear();
+  fMuonBegin.assign(1,0);
+  fPairBegin.assign(1,0);
+  fTrackletBegin.assign(1,0);
+  fPx.clear();
+  fPy.clear();
+  fPz.clear();
+  fE.clear();
+  fCharge.clear();
+  fTrigLevel.clear();
+  fStep.clear();
+  fMCType.clear();
+  fMCLabel.clear();
+  fPairType.clear();
+  fPairAncestor.clear();
+  fTrackletPhi.clear();
+  fTrackletDist.clear();
+}
+
+//________________________________________________________________________
+void AliDimuSkimWriter::FlushBlock ()
+{
+  /// Write the buffered events as a block
+  if ( ! fFile || fRun.empty() ) return;
+
+  const void* data[AliDimuSkim::kNcolumns] = {
+    fRun.data(), fCentrality.data(), fTrigMask.data(), fFlags.data(), fMuonBegin.data(), fPairBegin.data(), fTrackletBegin.data(),
+    fPx.data(), fPy.data(), fPz.data(), fE.data(), fCharge.data(), fTrigLevel.data(), fStep.data(), fMCType.data(), fMCLabel.data(),
+    fPairType.data(), fPairAncestor.data(),
+    fTrackletPhi.data(), fTrackletDist.data()
+  };
+  ULong64_t size[AliDimuSkim::kNcolumns] = {
+    fRun.size()*sizeof(Int_t), fCentrality.size()*sizeof(Float_t), fTrigMask.size()*sizeof(ULong64_t), fFlags.size()*sizeof(UChar_t),
+    fMuonBegin.size()*sizeof(UInt_t), fPairBegin.size()*sizeof(UInt_t), fTrackletBegin.size()*sizeof(UInt_t),
+    fPx.size()*sizeof(Double_t), fPy.size()*sizeof(Double_t), fPz.size()*sizeof(Double_t), fE.size()*sizeof(Double_t),
+    fCharge.size()*sizeof(Char_t), fTrigLevel.size()*sizeof(Char_t), fStep.size()*sizeof(Char_t), fMCType.size()*sizeof(Short_t), fMCLabel.size()*sizeof(Int_t),
+    fPairType.size()*sizeof(UShort_t), fPairAncestor.size()*sizeof(Int_t),
+    fTrackletPhi.size()*sizeof(Double_t), fTrackletDist.size()*sizeof(Double_t)
+  };
+
+  AliDimuSkim::BlockHeader header;
+  std::memset(&header,0,sizeof(header));
+  header.fMagic = AliDimuSkim::kBlockMagic;
+  header.fNevents = fRun.size();
+  header.fNmuons = fPx.size();
+  header.fNpairs = fPairType.size();
+  header.fNtracklets = fTrackletPhi.size();
+  ULong64_t offset = AliDimuSkim::Align(sizeof(header));
+  for ( Int_t icol=0; icol<AliDimuSkim::kNcolumns; ++icol ) {
+    header.fColumnOffset[icol] = offset;
+    offset = AliDimuSkim::Align(offset+size[icol]);
+  }
+  header.fBlockSize = offset;
+
+  AliDimuSkim::BlockInfo info = { fPosition, fNeventsWritten, header.fNevents, fRun.front(), fRun.front() };
+  for ( Int_t run : fRun ) {
+    if ( run < info.fRunMin ) info.fRunMin = run;
+    if ( run > info.fRunMax ) info.fRunMax = run;
+  }
+  fBlocks.push_back(info);
+
+  ULong64_t blockStart = fPosition;
+  Write(&header,sizeof(header));
+  for ( Int_t icol=0; icol<AliDimuSkim::kNcolumns; ++icol ) {
+    Pad(blockStart+header.fColumnOffset[icol]-fPosition);
+    Write(data[icol],size[icol]);
+  }
+  Pad(blockStart+header.fBlockSize-fPosition);
+
+  fNeventsWritten += header.fNevents;
+  ClearBlock();
+}
+
+//________________________________________________________________________
+void AliDimuSkimWriter::Close ()
+{
+  /// Write the last block, the footer and close the file
+  if ( ! fFile ) return;
+  FlushBlock();
+
+  // Footer: trigger classes, trigger pt-cut levels per run, pair types and block directory
+  AliDimuSkim::Trailer trailer;
+  trailer.fFooterOffset = fPosition;
+  UInt_t nEntries = fTrigClasses.size();
+  Write(&nEntries,sizeof(nEntries));
+  for ( const std::string& trigClass : fTrigClasses ) {
+    UInt_t length = trigClass.size();
+    Write(&length,sizeof(length));
+    Write(trigClass.data(),length);
+  }
+  nEntries = fRunTrigClasses.size();
+  Write(&nEntries,sizeof(nEntries));
+  for ( const AliDimuSkim::RunTrigClass& entry : fRunTrigClasses ) {
+    Int_t isDimuon = entry.fIsDimuon;
+    Write(&entry.fRun,sizeof(entry.fRun));
+    Write(&entry.fTrigClass,sizeof(entry.fTrigClass));
+    Write(&entry.fPtCutLevel,sizeof(entry.fPtCutLevel));
+    Write(&isDimuon,sizeof(isDimuon));
+  }
+  nEntries = fPairTypes.size();
+  Write(&nEntries,sizeof(nEntries));
+  for ( const std::string& pairType : fPairTypes ) {
+    UInt_t length = pairType.size();
+    Write(&length,sizeof(length));
+    Write(pairType.data(),length);
+  }
+  nEntries = fBlocks.size();
+  Write(&nEntries,sizeof(nEntries));
+  for ( const AliDimuSkim::BlockInfo& info : fBlocks ) {
+    Write(&info.fOffset,sizeof(info.fOffset));
+    Write(&info.fFirstEvent,sizeof(info.fFirstEvent));
+    Write(&info.fNevents,sizeof(info.fNevents));
+    Write(&info.fRunMin,sizeof(info.fRunMin));
+    Write(&info.fRunMax,sizeof(info.fRunMax));
+  }
+  trailer.fFooterSize = fPosition - trailer.fFooterOffset;
+  std::memcpy(trailer.fMagic,AliDimuSkim::FooterMagic(),sizeof(trailer.fMagic));
+  Write(&trailer,sizeof(trailer));
+
+  std::fclose(fFile);
+  fFile = 0x0;
+}
+
+
+//________________________________________________________________________
+AliDimuSkimReader::AliDimuSkimReader ( const char* fileName ) :
+fFileName(fileName),
+fData(0x0),
+fSize(0),
+fTrigClasses(),
+fRunTrigClasses(),
+fPairTypes(),
+fBlocks()
+{
+  /// Ctor.
+  Int_t fd = open(fileName, O_RDONLY);
+  if ( fd < 0 ) {
+    printf("E-AliDimuSkimReader: cannot open %s\n",fileName);
+    return;
+  }
+  struct stat fileStat;
+  if ( fstat(fd,&fileStat) == 0 && fileStat.st_size > 0 ) {
+    fSize = fileStat.st_size;
+    void* data = mmap(0x0, fSize, PROT_READ, MAP_SHARED, fd, 0);
+    if ( data != MAP_FAILED ) {
+      fData = static_cast<const Char_t*>(data);
+      madvise(data, fSize, MADV_SEQUENTIAL);
+    }
+  }
+  close(fd);
+
+  if ( fData && ! ReadFooter() ) {
+    printf("E-AliDimuSkimReader: %s is not a valid skim file\n",fileName);
+    Unmap();
+  }
+}
+
+//________________________________________________________________________
+AliDimuSkimReader::~AliDimuSkimReader()
+{
+  /// Dtor.
+  Unmap();
+}
+
+//________________________________________________________________________
+void AliDimuSkimReader::Unmap ()
+{
+  /// Unmap file
+  if ( fData ) munmap(const_cast<Char_t*>(fData), fSize);
+  fData = 0x0;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuSkimReader::ReadFooter ()
+{
+  /// Read header, trailer and footer
+  if ( fSize < sizeof(AliDimuSkim::FileHeader) + sizeof(AliDimuSkim::Trailer) ) return kFALSE;
+  const AliDimuSkim::FileHeader* header = reinterpret_cast<const AliDimuSkim::FileHeader*>(fData);
+  if ( std::memcmp(header->fMagic,AliDimuSkim::FileMagic(),sizeof(header->fMagic)) != 0 || header->fVersion != AliDimuSkim::kVersion ) return kFALSE;
+  AliDimuSkim::Trailer trailer;
+  std::memcpy(&trailer, fData+fSize-sizeof(trailer), sizeof(trailer));
+  if ( std::memcmp(trailer.fMagic,AliDimuSkim::FooterMagic(),sizeof(trailer.fMagic)) != 0 ) return kFALSE;
+  if ( trailer.fFooterOffset + trailer.fFooterSize + sizeof(trailer) != fSize ) return kFALSE;
+
+  const Char_t* ptr = fData + trailer.fFooterOffset;
+  const Char_t* end = ptr + trailer.fFooterSize;
+  // The footer is not aligned: read with memcpy
+  auto read = [&ptr,end] ( void* dest, ULong64_t size ) {
+    if ( ptr + size > end ) return kFALSE;
+    std::memcpy(dest, ptr, size);
+    ptr += size;
+    return kTRUE;
+  };
+  auto readString = [&ptr,end,&read] ( std::string& str ) {
+    UInt_t length = 0;
+    if ( ! read(&length,sizeof(length)) || ptr + length > end ) return kFALSE;
+    str.assign(ptr,length);
+    ptr += length;
+    return kTRUE;
+  };
+
+  UInt_t nEntries = 0;
+  if ( ! read(&nEntries,sizeof(nEntries)) ) return kFALSE;
+  fTrigClasses.resize(nEntries);
+  for ( std::string& trigClass : fTrigClasses ) {
+    if ( ! readString(trigClass) ) return kFALSE;
+  }
+  if ( ! read(&nEntries,sizeof(nEntries)) ) return kFALSE;
+  fRunTrigClasses.resize(nEntries);
+  for ( AliDimuSkim::RunTrigClass& entry : fRunTrigClasses ) {
+    Int_t isDimuon = 0;
+    if ( ! read(&entry.fRun,sizeof(entry.fRun)) || ! read(&entry.fTrigClass,sizeof(entry.fTrigClass)) || ! read(&entry.fPtCutLevel,sizeof(entry.fPtCutLevel)) || ! read(&isDimuon,sizeof(isDimuon)) ) return kFALSE;
+    if ( entry.fTrigClass < 0 || entry.fTrigClass >= (Int_t)fTrigClasses.size() ) return kFALSE;
+    entry.fIsDimuon = ( isDimuon != 0 );
+  }
+  if ( ! read(&nEntries,sizeof(nEntries)) ) return kFALSE;
+  fPairTypes.resize(nEntries);
+  for ( std::string& pairType : fPairTypes ) {
+    if ( ! readString(pairType) ) return kFALSE;
+  }
+  if ( ! read(&nEntries,sizeof(nEntries)) ) return kFALSE;
+  fBlocks.resize(nEntries);
+  for ( AliDimuSkim::BlockInfo& info : fBlocks ) {
+    if ( ! read(&info.fOffset,sizeof(info.fOffset)) || ! read(&info.fFirstEvent,sizeof(info.fFirstEvent)) || ! read(&info.fNevents,sizeof(info.fNevents)) || ! read(&info.fRunMin,sizeof(info.fRunMin)) || ! read(&info.fRunMax,sizeof(info.fRunMax)) ) return kFALSE;
+    if ( info.fOffset + sizeof(AliDimuSkim::BlockHeader) > trailer.fFooterOffset ) return kFALSE;
+  }
+  return kTRUE;
+}
+
+//________________________________________________________________________
+ULong64_t AliDimuSkimReader::GetNevents () const
+{
+  /// Total number of events
+  return fBlocks.empty() ? 0 : fBlocks.back().fFirstEvent + fBlocks.back().fNevents;
+}
+
+//________________________________________________________________________
+void AliDimuSkimReader::SetRandomAccess ( Bool_t isRandom ) const
+{
+  /// Advise the kernel on the access pattern
+  /// (random when only some event ranges are read, e.g. with AliDimuSkimIndex)
+  if ( fData ) madvise(const_cast<Char_t*>(fData), fSize, isRandom ? MADV_RANDOM : MADV_SEQUENTIAL);
+}
+
+//________________________________________________________________________
+Bool_t AliDimuSkimReader::GetBlock ( Int_t iblock, AliDimuSkimBlock& block ) const
+{
+  /// Get the column pointers of the block.
+  /// Returns kFALSE if the header or one of the columns does not fit in the block
+  ULong64_t blockOffset = fBlocks[iblock].fOffset;
+  if ( blockOffset > fSize || fSize - blockOffset < sizeof(AliDimuSkim::BlockHeader) ) return kFALSE;
+  const Char_t* start = fData + blockOffset;
+  const AliDimuSkim::BlockHeader* header = reinterpret_cast<const AliDimuSkim::BlockHeader*>(start);
+  if ( header->fMagic != AliDimuSkim::kBlockMagic || header->fBlockSize < sizeof(AliDimuSkim::BlockHeader) || header->fBlockSize > fSize - blockOffset ) return kFALSE;
+
+  // Number of entries and size of the elements of each column, as written by AliDimuSkimWriter::FlushBlock
+  const ULong64_t nEvents = header->fNevents, nMuons = header->fNmuons, nPairs = header->fNpairs, nTracklets = header->fNtracklets;
+  const ULong64_t nEntries[AliDimuSkim::kNcolumns] = {
+    nEvents, nEvents, nEvents, nEvents, nEvents+1, nEvents+1, nEvents+1,
+    nMuons, nMuons, nMuons, nMuons, nMuons, nMuons, nMuons, nMuons, nMuons,
+    nPairs, nPairs, nTracklets, nTracklets
+  };
+  const ULong64_t elementSize[AliDimuSkim::kNcolumns] = {
+    sizeof(Int_t), sizeof(Float_t), sizeof(ULong64_t), sizeof(UChar_t), sizeof(UInt_t), sizeof(UInt_t), sizeof(UInt_t),
+    sizeof(Double_t), sizeof(Double_t), sizeof(Double_t), sizeof(Double_t), sizeof(Char_t), sizeof(Char_t), sizeof(Char_t), sizeof(Short_t), sizeof(Int_t),
+    sizeof(UShort_t), sizeof(Int_t), sizeof(Double_t), sizeof(Double_t)
+  };
+  const ULong64_t* offset = header->fColumnOffset;
+  for ( Int_t icol=0; icol<AliDimuSkim::kNcolumns; ++icol ) {
+    // The counts are 32 bits, so the column size cannot overflow
+    ULong64_t size = nEntries[icol] * elementSize[icol];
+    if ( offset[icol] < sizeof(AliDimuSkim::BlockHeader) || offset[icol] > header->fBlockSize || size > header->fBlockSize - offset[icol] ) return kFALSE;
+  }
+
+  block.fNevents = header->fNevents;
+  block.fNmuons = header->fNmuons;
+  block.fNpairs = header->fNpairs;
+  block.fNtracklets = header->fNtracklets;
+  block.fRun = reinterpret_cast<const Int_t*>(start+offset[AliDimuSkim::kColRun]);
+  block.fCentrality = reinterpret_cast<const Float_t*>(start+offset[AliDimuSkim::kColCentrality]);
+  block.fTrigMask = reinterpret_cast<const ULong64_t*>(start+offset[AliDimuSkim::kColTrigMask]);
+  block.fFlags = reinterpret_cast<const UChar_t*>(start+offset[AliDimuSkim::kColFlags]);
+  block.fMuonBegin = reinterpret_cast<const UInt_t*>(start+offset[AliDimuSkim::kColMuonBegin]);
+  block.fPairBegin = reinterpret_cast<const UInt_t*>(start+offset[AliDimuSkim::kColPairBegin]);
+  block.fTrackletBegin = reinterpret_cast<const UInt_t*>(start+offset[AliDimuSkim::kColTrackletBegin]);
+  block.fPx = reinterpret_cast<const Double_t*>(start+offset[AliDimuSkim::kColPx]);
+  block.fPy = reinterpret_cast<const Double_t*>(start+offset[AliDimuSkim::kColPy]);
+  block.fPz = reinterpret_cast<const Double_t*>(start+offset[AliDimuSkim::kColPz]);
+  block.fE = reinterpret_cast<const Double_t*>(start+offset[AliDimuSkim::kColE]);
+  block.fCharge = reinterpret_cast<const Char_t*>(start+offset[AliDimuSkim::kColCharge]);
+  block.fTrigLevel = reinterpret_cast<const Char_t*>(start+offset[AliDimuSkim::kColTrigLevel]);
+  block.fStep = reinterpret_cast<const Char_t*>(start+offset[AliDimuSkim::kColStep]);
+  block.fMCType = reinterpret_cast<const Short_t*>(start+offset[AliDimuSkim::kColMCType]);
+  block.fMCLabel = reinterpret_cast<const Int_t*>(start+offset[AliDimuSkim::kColMCLabel]);
+  block.fPairType = reinterpret_cast<const UShort_t*>(start+offset[AliDimuSkim::kColPairType]);
+  block.fPairAncestor = reinterpret_cast<const Int_t*>(start+offset[AliDimuSkim::kColPairAncestor]);
+  block.fTrackletPhi = reinterpret_cast<const Double_t*>(start+offset[AliDimuSkim::kColTrackletPhi]);
+  block.fTrackletDist = reinterpret_cast<const Double_t*>(start+offset[AliDimuSkim::kColTrackletDist]);
+  return kTRUE;
+}
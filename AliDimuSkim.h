@@ -0,0 +1,280 @@
+#ifndef ALIDIMUSKIM_H
+#define ALIDIMUSKIM_H
+
+/* $Id$ */
+
+//
+// AliDimuSkim
+// Compact columnar skim of the dimuon analysis input: format, writer and reader
+//
+//  Author: Diego Stocco
+//
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+#include "Rtypes.h"
+#include "AliDimuMuon.h"
+
+/// Skim file layout.
+///
+/// The file is made of a file header, a sequence of blocks,
+/// a footer with the string tables, the trigger pt-cut levels per run
+/// and the block directory, and a trailer.
+/// Each block stores a fixed maximum number of events in columns:
+/// every column is a plain array aligned to kAlignment bytes,
+/// so that it can be used directly from a memory mapped file.
+/// All the numbers are stored in the native (little endian) byte order.
+/// The muon kinematics and the tracklets are stored in double precision,
+/// as used by AliAnalysisTaskDimu, so that the re-analysis gives the same pairs.
+class AliDimuSkim {
+ public:
+  enum {
+    kVersion = 3,           ///< Format version
+    kAlignment = 64,        ///< Alignment of blocks and columns (bytes)
+    kBlockMagic = 0x4b4c4244 ///< Block magic number ("DBLK")
+  };
+
+  /// Columns
+  enum EColumn {
+    // Event columns (nEvents entries, begin columns nEvents+1)
+    kColRun,            ///< Run number (Int_t)
+    kColCentrality,     ///< Centrality (Float_t)
+    kColTrigMask,       ///< Fired trigger classes (ULong64_t, bit = index in trigger class table)
+    kColFlags,          ///< Event flags (UChar_t)
+    kColMuonBegin,      ///< First muon of the event (UInt_t)
+    kColPairBegin,      ///< First pair of the event (UInt_t)
+    kColTrackletBegin,  ///< First tracklet of the event (UInt_t)
+    // Muon columns
+    kColPx,             ///< Px (Double_t)
+    kColPy,             ///< Py (Double_t)
+    kColPz,             ///< Pz (Double_t)
+    kColE,              ///< Energy (Double_t)
+    kColCharge,         ///< Charge (Char_t)
+    kColTrigLevel,      ///< Trigger pt-cut level (Char_t)
+    kColStep,           ///< Reconstructed or generated (Char_t)
+    kColMCType,         ///< MC particle type (Short_t)
+    kColMCLabel,        ///< MC label (Int_t)
+    // Pair columns: pairs i<j of the muons of the same step, in the order of the muons
+    kColPairType,       ///< Pair type (UShort_t, index in pair type table)
+    kColPairAncestor,   ///< Common ancestor of the pair (Int_t)
+    // Tracklet columns
+    kColTrackletPhi,    ///< Tracklet phi (Double_t)
+    kColTrackletDist,   ///< Tracklet distance, as in AliMultiplicity::CalcDist (Double_t)
+    kNcolumns           ///< Number of columns
+  };
+
+  /// Event flags
+  enum EEventFlag {
+    kHasTracklets = 1<<0 ///< Tracklets are stored for this event
+  };
+
+  /// File header
+  struct FileHeader {
+    Char_t fMagic[8];       ///< "DIMUSKIM"
+    UInt_t fVersion;        ///< Format version
+    UInt_t fHeaderSize;     ///< Size of this header
+    ULong64_t fReserved[6]; ///< Reserved
+  };
+
+  /// Block header
+  struct BlockHeader {
+    UInt_t fMagic;      ///< kBlockMagic
+    UInt_t fNevents;    ///< Number of events
+    UInt_t fNmuons;     ///< Number of muons
+    UInt_t fNpairs;     ///< Number of pairs
+    UInt_t fNtracklets; ///< Number of tracklets
+    UInt_t fReserved;   ///< Reserved
+    ULong64_t fBlockSize; ///< Size of the block (including header and padding)
+    ULong64_t fColumnOffset[kNcolumns]; ///< Offset of the columns with respect to the block start
+  };
+
+  /// Trailer (last bytes of the file)
+  struct Trailer {
+    ULong64_t fFooterOffset; ///< Position of the footer
+    ULong64_t fFooterSize;   ///< Size of the footer
+    Char_t fMagic[8];        ///< "DIMUFOOT"
+  };
+
+  /// Trigger pt-cut level of a trigger class in a run
+  /// (the levels are set per run by the event cuts, as in the task)
+  struct RunTrigClass {
+    Int_t fRun;           ///< Run number
+    Int_t fTrigClass;     ///< Index in the trigger class table
+    Int_t fPtCutLevel;    ///< Trigger pt-cut level of the class in the run
+    Bool_t fIsDimuon;     ///< Dimuon trigger class
+  };
+
+  /// Block directory entry
+  struct BlockInfo {
+    ULong64_t fOffset;     ///< Position of the block in file
+    ULong64_t fFirstEvent; ///< Index of the first event of the block in file
+    UInt_t fNevents;       ///< Number of events
+    Int_t fRunMin;         ///< Minimum run number
+    Int_t fRunMax;         ///< Maximum run number
+  };
+
+  static const char* FileMagic () { return "DIMUSKIM"; }
+  static const char* FooterMagic () { return "DIMUFOOT"; }
+  static ULong64_t Align ( ULong64_t size ) { return ( size + kAlignment - 1 ) / kAlignment * kAlignment; }
+};
+
+/// Writes the skim file: events are buffered and written one block at a time
+class AliDimuSkimWriter {
+ public:
+  AliDimuSkimWriter ( const char* fileName, Int_t blockSize = 8192 );
+  ~AliDimuSkimWriter();
+
+  /// Check if the file is open
+  Bool_t IsOpen () const { return ( fFile != 0x0 ); }
+
+  Int_t GetTrigClassIndex ( const char* trigClass ) const;
+  Int_t AddTrigClass ( const char* trigClass );
+  void SetTrigClassPtCutLevel ( Int_t run, Int_t index, Int_t ptCutLevel, Bool_t isDimuon );
+  UShort_t GetPairTypeIndex ( const char* pairType );
+
+  void BeginEvent ( Int_t run, Double_t centrality, ULong64_t trigMask );
+  void AddMuon ( const AliDimuMuon& muon, Int_t step, Int_t mcType, Int_t mcLabel );
+  void AddPair ( UShort_t pairType, Int_t commonAncestor );
+  void AddTracklet ( Double_t phi, Double_t dist );
+  void EndEvent ();
+  void Close ();
+
+  /// Number of muons of the current event
+  Int_t GetNmuonsInEvent () const { return fPx.size() - fMuonBegin.back(); }
+  /// Number of pairs of the current event
+  Int_t GetNpairsInEvent () const { return fPairType.size() - fPairBegin.back(); }
+  /// Number of events written
+  ULong64_t GetNevents () const { return fNeventsWritten + fRun.size(); }
+
+ private:
+  AliDimuSkimWriter(const AliDimuSkimWriter&);
+  AliDimuSkimWriter& operator=(const AliDimuSkimWriter&);
+
+  void FlushBlock ();
+  void Write ( const void* data, ULong64_t size );
+  void Pad ( ULong64_t size );
+  void ClearBlock ();
+
+  std::FILE* fFile;         ///< Output file
+  Int_t fBlockSize;         ///< Maximum number of events per block
+  ULong64_t fPosition;      ///< Current position in file
+  ULong64_t fNeventsWritten; ///< Number of events in the written blocks
+
+  std::vector<std::string> fTrigClasses; ///< Trigger class table
+  std::vector<Int_t> fTrigClassLevelRun; ///< Last run with the pt-cut level of the trigger class in fRunTrigClasses
+  std::vector<AliDimuSkim::RunTrigClass> fRunTrigClasses; ///< Trigger pt-cut levels per run
+  std::vector<std::string> fPairTypes; ///< Pair type table
+  std::map<std::string,UShort_t> fPairTypeIndex; ///< Pair type name to index
+  std::vector<AliDimuSkim::BlockInfo> fBlocks; ///< Block directory
+
+  // Columns of the current block
+  std::vector<Int_t> fRun;            ///< Run
+  std::vector<Float_t> fCentrality;   ///< Centrality
+  std::vector<ULong64_t> fTrigMask;   ///< Trigger mask
+  std::vector<UChar_t> fFlags;        ///< Event flags
+  std::vector<UInt_t> fMuonBegin;     ///< First muon per event
+  std::vector<UInt_t> fPairBegin;     ///< First pair per event
+  std::vector<UInt_t> fTrackletBegin; ///< First tracklet per event
+  std::vector<Double_t> fPx;          ///< Muon px
+  std::vector<Double_t> fPy;          ///< Muon py
+  std::vector<Double_t> fPz;          ///< Muon pz
+  std::vector<Double_t> fE;           ///< Muon energy
+  std::vector<Char_t> fCharge;        ///< Muon charge
+  std::vector<Char_t> fTrigLevel;     ///< Muon trigger level
+  std::vector<Char_t> fStep;          ///< Muon step
+  std::vector<Short_t> fMCType;       ///< Muon MC type
+  std::vector<Int_t> fMCLabel;        ///< Muon MC label
+  std::vector<UShort_t> fPairType;    ///< Pair type
+  std::vector<Int_t> fPairAncestor;   ///< Pair common ancestor
+  std::vector<Double_t> fTrackletPhi; ///< Tracklet phi
+  std::vector<Double_t> fTrackletDist; ///< Tracklet distance
+};
+
+/// View of a block of a memory mapped skim file
+struct AliDimuSkimBlock {
+  UInt_t fNevents;    ///< Number of events
+  UInt_t fNmuons;     ///< Number of muons
+  UInt_t fNpairs;     ///< Number of pairs
+  UInt_t fNtracklets; ///< Number of tracklets
+  const Int_t* fRun;            ///< Run
+  const Float_t* fCentrality;   ///< Centrality
+  const ULong64_t* fTrigMask;   ///< Trigger mask
+  const UChar_t* fFlags;        ///< Event flags
+  const UInt_t* fMuonBegin;     ///< First muon per event
+  const UInt_t* fPairBegin;     ///< First pair per event
+  const UInt_t* fTrackletBegin; ///< First tracklet per event
+  const Double_t* fPx;          ///< Muon px
+  const Double_t* fPy;          ///< Muon py
+  const Double_t* fPz;          ///< Muon pz
+  const Double_t* fE;           ///< Muon energy
+  const Char_t* fCharge;        ///< Muon charge
+  const Char_t* fTrigLevel;     ///< Muon trigger level
+  const Char_t* fStep;          ///< Muon step
+  const Short_t* fMCType;       ///< Muon MC type
+  const Int_t* fMCLabel;        ///< Muon MC label
+  const UShort_t* fPairType;    ///< Pair type
+  const Int_t* fPairAncestor;   ///< Pair common ancestor
+  const Double_t* fTrackletPhi; ///< Tracklet phi
+  const Double_t* fTrackletDist; ///< Tracklet distance
+
+  /// Get muon
+  AliDimuMuon GetMuon ( UInt_t imu ) const
+  {
+    AliDimuMuon muon;
+    muon.fPx = fPx[imu];
+    muon.fPy = fPy[imu];
+    muon.fPz = fPz[imu];
+    muon.fE = fE[imu];
+    muon.fCharge = fCharge[imu];
+    muon.fTrigLevel = fTrigLevel[imu];
+    return muon;
+  }
+};
+
+/// Reads the skim file through a read-only memory map
+class AliDimuSkimReader {
+ public:
+  AliDimuSkimReader ( const char* fileName );
+  ~AliDimuSkimReader();
+
+  /// Check if the file is correctly open
+  Bool_t IsOpen () const { return ( fData != 0x0 ); }
+  /// File name
+  const char* GetFileName () const { return fFileName.c_str(); }
+
+  /// Number of blocks
+  Int_t GetNblocks () const { return fBlocks.size(); }
+  /// Block directory entry
+  const AliDimuSkim::BlockInfo& GetBlockInfo ( Int_t iblock ) const { return fBlocks[iblock]; }
+  Bool_t GetBlock ( Int_t iblock, AliDimuSkimBlock& block ) const;
+  ULong64_t GetNevents () const;
+  void SetRandomAccess ( Bool_t isRandom ) const;
+
+  /// Trigger class table
+  const std::vector<std::string>& GetTrigClasses () const { return fTrigClasses; }
+  /// Trigger pt-cut levels of the trigger classes per run
+  const std::vector<AliDimuSkim::RunTrigClass>& GetRunTrigClasses () const { return fRunTrigClasses; }
+  /// Pair type table
+  const std::vector<std::string>& GetPairTypes () const { return fPairTypes; }
+  /// File size
+  ULong64_t GetSize () const { return fSize; }
+
+ private:
+  AliDimuSkimReader(const AliDimuSkimReader&);
+  AliDimuSkimReader& operator=(const AliDimuSkimReader&);
+
+  Bool_t ReadFooter ();
+  void Unmap ();
+
+  std::string fFileName; ///< File name
+  const Char_t* fData;   ///< Mapped file
+  ULong64_t fSize;       ///< File size
+  std::vector<std::string> fTrigClasses; ///< Trigger class table
+  std::vector<AliDimuSkim::RunTrigClass> fRunTrigClasses; ///< Trigger pt-cut levels per run
+  std::vector<std::string> fPairTypes; ///< Pair type table
+  std::vector<AliDimuSkim::BlockInfo> fBlocks; ///< Block directory
+};
+
+#endif
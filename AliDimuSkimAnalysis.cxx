@@ -0,0 +1,392 @@
+/**************************************************************************
+ * Copyright(c) 1998-2007, ALICE Experiment at CERN, All rights reserved. *
+ *                                                                        *
+ * Author: The ALICE Off-line Project.                                    *
+ * Contributors are mentioned in the code where appropriate.              *
+ *                                                                        *
+ * Permission to use, copy, modify and distribute this software and its   *
+ * documentation strictly for non-commercial purposes is hereby granted   *
+ * without fee, provided that the above copyright notice appears in all   *
+ * copies and that both the copyright notice and this permission notice   *
+ * appear in the supporting documentation. The authors make no claims     *
+ * about the suitability of this software for any purpose. It is          *
+ * provided "as is" without express or implied warranty.                  *
+ **************************************************************************/
+
+/* $Id$ */
+
+//-----------------------------------------------------------------------------
+/// \class AliDimuSkimAnalysis
+/// Re-analysis of the skims written by AliAnalysisTaskDimu (see AliDimuSkim).
+/// It builds the pairs exactly as AliAnalysisTaskDimu::UserExec and fills
+/// the same outputs (nevents and DimuSparse, with the same identifiers)
+/// in an AliMergeableCollection.
+/// When runs, centrality or trigger classes are selected, only the
+/// relevant event ranges are read, using the sidecar index (AliDimuSkimIndex).
+/// A missing or stale index is built in memory: it is written to disk only
+/// with SetSaveIndex (or by benchSkimIndex).
+/// The skim blocks are distributed among threads: each thread fills
+/// its own sparses, which are summed at the end in a fixed order.
+///
+/// \author Diego Stocco
+//-----------------------------------------------------------------------------
+
+#include "AliDimuSkimAnalysis.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+#include "TROOT.h"
+#include "TH1.h"
+#include "THnSparse.h"
+#include "TObjArray.h"
+#include "TObjString.h"
+
+#include "AliMergeableCollection.h"
+#include "AliDimuMuon.h"
+#include "AliDimuSkim.h"
+#include "AliDimuSkimIndex.h"
+
+//________________________________________________________________________
+AliDimuSkimAnalysis::AliDimuSkimAnalysis() :
+fBinning(),
+fTrackletDistCuts(),
+fSelectedPairTypes(""),
+fSelectedTrigClasses(""),
+fSelectedChargeTypes("OS,SS"),
+fSelectedRuns(),
+fUseIndex(kTRUE),
+fSaveIndex(kFALSE),
+fMuonPtMin(0.),
+fMuonEtaMin(-1.e10),
+fMuonEtaMax(1.e10),
+fCentralityMin(-1.e10),
+fCentralityMax(1.e10),
+fApplyTrigPtCut(kTRUE),
+fNthreads(0),
+fReaders(),
+fFileTables(),
+fTrigClasses(),
+fPairTypes(),
+fGeneratedIndex(-1)
+{
+  /// Ctor.
+}
+
+//________________________________________________________________________
+AliDimuSkimAnalysis::~AliDimuSkimAnalysis()
+{
+  /// Dtor.
+  for ( AliDimuSkimReader* reader : fReaders ) delete reader;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuSkimAnalysis::AddFile ( const char* fileName )
+{
+  /// Add skim file
+  AliDimuSkimReader* reader = new AliDimuSkimReader(fileName);
+  if ( ! reader->IsOpen() ) {
+    delete reader;
+    return kFALSE;
+  }
+  fReaders.push_back(reader);
+  return kTRUE;
+}
+
+//________________________________________________________________________
+void AliDimuSkimAnalysis::SetTrackletDistCuts ( const std::vector<Double_t>& cuts )
+{
+  /// Set cuts on tracklet distance
+  fTrackletDistCuts = cuts;
+  std::sort(fTrackletDistCuts.begin(),fTrackletDistCuts.end(),std::greater<Double_t>());
+}
+
+//________________________________________________________________________
+void AliDimuSkimAnalysis::SelectRuns ( TString selectedRuns )
+{
+  /// Select runs
+  fSelectedRuns.clear();
+  TObjArray* tokens = selectedRuns.Tokenize(",");
+  for ( Int_t itoken=0; itoken<tokens->GetEntries(); ++itoken ) fSelectedRuns.push_back(static_cast<TObjString*>(tokens->At(itoken))->String().Atoi());
+  delete tokens;
+  std::sort(fSelectedRuns.begin(),fSelectedRuns.end());
+}
+
+//________________________________________________________________________
+Bool_t AliDimuSkimAnalysis::IsSelected ( const TString& list, const char* name ) const
+{
+  /// Check if name is in the comma separated list (an empty list selects everything)
+  if ( list.IsNull() ) return kTRUE;
+  TObjArray* tokens = list.Tokenize(",");
+  Bool_t isSelected = ( tokens->FindObject(name) != 0x0 );
+  delete tokens;
+  return isSelected;
+}
+
+//________________________________________________________________________
+Int_t AliDimuSkimAnalysis::GetGlobalIndex ( std::vector<std::string>& names, const std::string& name )
+{
+  /// Get index of name in the global table (added if not there)
+  std::vector<std::string>::iterator it = std::find(names.begin(),names.end(),name);
+  if ( it != names.end() ) return it - names.begin();
+  names.push_back(name);
+  return names.size() - 1;
+}
+
+//________________________________________________________________________
+void AliDimuSkimAnalysis::BuildTables ()
+{
+  /// Map the tables of each file to global tables
+  fFileTables.clear();
+  fTrigClasses.clear();
+  fPairTypes.clear();
+  for ( AliDimuSkimReader* reader : fReaders ) {
+    FileTables tables;
+    const std::vector<std::string>& trigClasses = reader->GetTrigClasses();
+    for ( const std::string& trigClass : trigClasses ) {
+      Bool_t isGenerated = ( trigClass == "generated" );
+      Bool_t isSelected = isGenerated || IsSelected(fSelectedTrigClasses,trigClass.c_str());
+      tables.fTrigClass.push_back(isSelected ? GetGlobalIndex(fTrigClasses,trigClass) : -1);
+    }
+    // Pt-cut levels per run: a class without level in the run has no pt cut
+    const TrigLevel noLevel = { 0, kFALSE };
+    for ( const AliDimuSkim::RunTrigClass& entry : reader->GetRunTrigClasses() ) {
+      std::vector<TrigLevel>& levels = tables.fTrigLevels[entry.fRun];
+      levels.resize(trigClasses.size(), noLevel);
+      TrigLevel level = { entry.fPtCutLevel, entry.fIsDimuon };
+      levels[entry.fTrigClass] = level;
+    }
+    for ( const std::string& pairType : reader->GetPairTypes() ) {
+      tables.fPairType.push_back(IsSelected(fSelectedPairTypes,pairType.c_str()) ? GetGlobalIndex(fPairTypes,pairType) : -1);
+    }
+    fFileTables.push_back(tables);
+  }
+  std::vector<std::string>::iterator it = std::find(fTrigClasses.begin(),fTrigClasses.end(),"generated");
+  fGeneratedIndex = ( it == fTrigClasses.end() ) ? -1 : it - fTrigClasses.begin();
+}
+
+//________________________________________________________________________
+void AliDimuSkimAnalysis::BuildWorkItems ( std::vector<WorkItem>& workItems ) const
+{
+  /// Get the event ranges to be processed
+  workItems.clear();
+  Bool_t hasCentralityCut = ( fCentralityMin > -1.e10 || fCentralityMax < 1.e10 );
+  for ( size_t ifile=0; ifile<fReaders.size(); ++ifile ) {
+    const AliDimuSkimReader* reader = fReaders[ifile];
+    const FileTables& tables = fFileTables[ifile];
+    std::vector<Int_t> trigClasses;
+    for ( size_t ibit=0; ibit<tables.fTrigClass.size(); ++ibit ) {
+      if ( tables.fTrigClass[ibit] >= 0 ) trigClasses.push_back(ibit);
+    }
+    if ( trigClasses.size() == tables.fTrigClass.size() ) trigClasses.clear();
+
+    if ( fUseIndex && ( ! fSelectedRuns.empty() || hasCentralityCut || ! trigClasses.empty() ) ) {
+      AliDimuSkimIndex index;
+      if ( index.Open(*reader, fSaveIndex) ) {
+        std::vector<AliDimuSkimIndex::EventRange> ranges;
+        index.Select(fSelectedRuns, fCentralityMin, fCentralityMax, trigClasses, ranges);
+        for ( const AliDimuSkimIndex::EventRange& range : ranges ) {
+          WorkItem item = { (Int_t)ifile, (Int_t)range.fBlock, range.fFirstEvent, range.fNevents };
+          workItems.push_back(item);
+        }
+        reader->SetRandomAccess(kTRUE);
+        continue;
+      }
+    }
+
+    // Full scan (only the blocks with selected runs)
+    for ( Int_t iblock=0; iblock<reader->GetNblocks(); ++iblock ) {
+      const AliDimuSkim::BlockInfo& info = reader->GetBlockInfo(iblock);
+      if ( ! fSelectedRuns.empty() ) {
+        std::vector<Int_t>::const_iterator run = std::lower_bound(fSelectedRuns.begin(),fSelectedRuns.end(),info.fRunMin);
+        if ( run == fSelectedRuns.end() || *run > info.fRunMax ) continue;
+      }
+      WorkItem item = { (Int_t)ifile, iblock, 0, info.fNevents };
+      workItems.push_back(item);
+    }
+  }
+}
+
+//________________________________________________________________________
+void AliDimuSkimAnalysis::ProcessBlock ( const AliDimuSkimBlock& block, UInt_t firstEvent, UInt_t lastEvent, const FileTables& tables, Output& output ) const
+{
+  /// Build the pairs of the events [firstEvent,lastEvent) of the block and fill the output
+  Int_t nDistCuts = fTrackletDistCuts.size();
+  Int_t nCutNames = nDistCuts + 1;
+  Int_t nPairTypes = fPairTypes.size();
+  Bool_t selectedCharge[2] = { IsSelected(fSelectedChargeTypes,"OS"), IsSelected(fSelectedChargeTypes,"SS") };
+  std::vector<Int_t> nTrackletsPerCut(nCutNames,0);
+  std::vector<Int_t> recoClasses, stepClasses;
+  std::vector<Bool_t> isMuonSelected;
+  Double_t containerInput[AliDimuBinning::kNaxes];
+  // Pt-cut levels of the trigger classes in the run of the event (looked up when the run changes)
+  Int_t currentRun = -1;
+  const std::vector<TrigLevel>* trigLevels = 0x0;
+  const std::vector<TrigLevel> noLevels(tables.fTrigClass.size(), TrigLevel{ 0, kFALSE });
+
+  for ( UInt_t iev=firstEvent; iev<lastEvent; ++iev ) {
+    if ( ! fSelectedRuns.empty() && ! std::binary_search(fSelectedRuns.begin(),fSelectedRuns.end(),block.fRun[iev]) ) continue;
+    if ( block.fRun[iev] != currentRun ) {
+      currentRun = block.fRun[iev];
+      std::map<Int_t,std::vector<TrigLevel> >::const_iterator it = tables.fTrigLevels.find(currentRun);
+      trigLevels = ( it == tables.fTrigLevels.end() ) ? &noLevels : &it->second;
+    }
+    containerInput[AliDimuBinning::kCentrality] = block.fCentrality[iev];
+    if ( containerInput[AliDimuBinning::kCentrality] < fCentralityMin || containerInput[AliDimuBinning::kCentrality] > fCentralityMax ) continue;
+
+    // Trigger classes
+    recoClasses.clear();
+    Int_t genClass = -1;
+    ULong64_t trigMask = block.fTrigMask[iev];
+    for ( Int_t ibit=0; ibit<64 && ( trigMask >> ibit ); ++ibit ) {
+      if ( ( ( trigMask >> ibit ) & 0x1 ) == 0 ) continue;
+      Int_t iclass = tables.fTrigClass[ibit];
+      if ( iclass < 0 ) continue;
+      output.fNevents[iclass] += 1.;
+      if ( iclass == fGeneratedIndex ) genClass = ibit;
+      else recoClasses.push_back(ibit);
+    }
+
+    UInt_t muonBegin = block.fMuonBegin[iev];
+    UInt_t muonEnd = block.fMuonBegin[iev+1];
+    UInt_t ipair = block.fPairBegin[iev];
+    const Double_t* trackletPhi = block.fTrackletPhi + block.fTrackletBegin[iev];
+    const Double_t* trackletDist = block.fTrackletDist + block.fTrackletBegin[iev];
+    Int_t nTracklets = block.fTrackletBegin[iev+1] - block.fTrackletBegin[iev];
+
+    // Muons are stored by step (reconstructed, then generated)
+    UInt_t stepBegin = muonBegin;
+    while ( stepBegin < muonEnd ) {
+      Int_t istep = block.fStep[stepBegin];
+      UInt_t stepEnd = stepBegin;
+      while ( stepEnd < muonEnd && block.fStep[stepEnd] == istep ) ++stepEnd;
+      Int_t nMuons = stepEnd - stepBegin;
+
+      stepClasses.clear();
+      if ( istep == 0 ) stepClasses = recoClasses;
+      else if ( genClass >= 0 ) stepClasses.push_back(genClass);
+
+      isMuonSelected.resize(nMuons);
+      for ( Int_t imu=0; imu<nMuons; ++imu ) {
+        UInt_t idx = stepBegin + imu;
+        Double_t px = block.fPx[idx], py = block.fPy[idx], pz = block.fPz[idx];
+        Double_t pt = std::sqrt(px*px+py*py);
+        Double_t p = std::sqrt(pt*pt+pz*pz);
+        Double_t eta = ( p > std::abs(pz) ) ? 0.5*std::log((p+pz)/(p-pz)) : ( pz > 0. ? 1.e10 : -1.e10 );
+        isMuonSelected[imu] = ( pt >= fMuonPtMin && eta >= fMuonEtaMin && eta <= fMuonEtaMax );
+      }
+
+      for ( Int_t imu=0; imu<nMuons; ++imu ) {
+        for ( Int_t jmu=imu+1; jmu<nMuons; ++jmu, ++ipair ) {
+          if ( stepClasses.empty() || ! isMuonSelected[imu] || ! isMuonSelected[jmu] ) continue;
+          Int_t pairType = tables.fPairType[block.fPairType[ipair]];
+          if ( pairType < 0 ) continue;
+          AliDimuMuon mu1 = block.GetMuon(stepBegin+imu);
+          AliDimuMuon mu2 = block.GetMuon(stepBegin+jmu);
+          Int_t icharge = AliDimuPair::IsSameSign(mu1,mu2) ? 1 : 0;
+          if ( ! selectedCharge[icharge] ) continue;
+
+          AliDimuPair::Kinematics(mu1, mu2, containerInput[AliDimuBinning::kPt], containerInput[AliDimuBinning::kY], containerInput[AliDimuBinning::kPhi], containerInput[AliDimuBinning::kInvMass]);
+          AliDimuPair::CountTracklets(containerInput[AliDimuBinning::kPhi], trackletPhi, trackletDist, nTracklets, fTrackletDistCuts.data(), nDistCuts, nTrackletsPerCut.data());
+
+          for ( Int_t ibit : stepClasses ) {
+            if ( istep == 0 && fApplyTrigPtCut && ! AliDimuPair::PassTrigPtCut(mu1.fTrigLevel, mu2.fTrigLevel, (*trigLevels)[ibit].fPtCutLevel, (*trigLevels)[ibit].fIsDimuon) ) continue;
+            Int_t iclass = tables.fTrigClass[ibit];
+            for ( Int_t icut=0; icut<nCutNames; ++icut ) {
+              containerInput[AliDimuBinning::kTracklets] = nTrackletsPerCut[icut];
+              Int_t isparse = ( ( iclass * nCutNames + icut ) * nPairTypes + pairType ) * 2 + icharge;
+              THnSparse*& sparse = output.fSparses[isparse];
+              if ( ! sparse ) sparse = fBinning.CreateSparse("DimuSparse","Sparse for tracks");
+              sparse->Fill(containerInput,1.);
+            } // loop on tracklet cuts
+          } // loop on trigger classes
+        } // loop on second muon
+      } // loop on muons
+      stepBegin = stepEnd;
+    } // loop on steps
+  } // loop on events
+}
+
+//________________________________________________________________________
+AliMergeableCollection* AliDimuSkimAnalysis::Run ( const char* collectionName )
+{
+  /// Process all the skim files and return the output collection
+  BuildTables();
+
+  std::vector<WorkItem> workItems;
+  BuildWorkItems(workItems);
+
+  Int_t nCutNames = fTrackletDistCuts.size() + 1;
+  Int_t nSparses = fTrigClasses.size() * nCutNames * fPairTypes.size() * 2;
+  Int_t nThreads = ( fNthreads > 0 ) ? fNthreads : std::thread::hardware_concurrency();
+  if ( nThreads <= 0 ) nThreads = 1;
+  if ( nThreads > (Int_t)workItems.size() ) nThreads = std::max((Int_t)workItems.size(),1);
+
+  ROOT::EnableThreadSafety();
+
+  std::vector<Output> outputs(nThreads);
+  for ( Output& output : outputs ) {
+    output.fSparses.assign(nSparses,0x0);
+    output.fNevents.assign(fTrigClasses.size(),0.);
+  }
+
+  std::atomic<size_t> nextItem(0);
+  auto worker = [this,&workItems,&nextItem] ( Output* output ) {
+    AliDimuSkimBlock block;
+    for ( size_t iwork = nextItem++; iwork < workItems.size(); iwork = nextItem++ ) {
+      const WorkItem& item = workItems[iwork];
+      if ( ! fReaders[item.fFile]->GetBlock(item.fBlock,block) ) {
+        printf("E-AliDimuSkimAnalysis::Run: corrupted block %i in %s\n",item.fBlock,fReaders[item.fFile]->GetFileName());
+        continue;
+      }
+      ProcessBlock(block, item.fFirstEvent, item.fFirstEvent+item.fNevents, fFileTables[item.fFile], *output);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for ( Int_t ithread=1; ithread<nThreads; ++ithread ) threads.push_back(std::thread(worker,&outputs[ithread]));
+  worker(&outputs[0]);
+  for ( std::thread& thread : threads ) thread.join();
+
+  // Sum the outputs of the threads in a fixed order
+  AliMergeableCollection* collection = new AliMergeableCollection(collectionName);
+  std::vector<TString> cutNames;
+  for ( Double_t val : fTrackletDistCuts ) cutNames.push_back(Form("trackletDistCuts_%g",val));
+  cutNames.push_back("trackletDistCuts_none");
+  const char* chargeTypes[2] = {"OS","SS"};
+
+  for ( size_t iclass=0; iclass<fTrigClasses.size(); ++iclass ) {
+    Double_t nEvents = 0.;
+    for ( Output& output : outputs ) nEvents += output.fNevents[iclass];
+    if ( nEvents == 0. ) continue;
+    TH1* histo = new TH1D("nevents","nevents",1,0.5,1.5);
+    histo->SetDirectory(0);
+    histo->SetBinContent(1,nEvents);
+    histo->SetEntries(nEvents);
+    collection->Adopt(Form("/%s",fTrigClasses[iclass].c_str()),histo);
+  }
+
+  for ( Int_t isparse=0; isparse<nSparses; ++isparse ) {
+    THnSparse* sparse = 0x0;
+    for ( Output& output : outputs ) {
+      THnSparse* threadSparse = output.fSparses[isparse];
+      if ( ! threadSparse ) continue;
+      if ( ! sparse ) sparse = threadSparse;
+      else {
+        sparse->Add(threadSparse);
+        delete threadSparse;
+      }
+    }
+    if ( ! sparse ) continue;
+    Int_t icharge = isparse % 2;
+    Int_t ipairType = ( isparse / 2 ) % fPairTypes.size();
+    Int_t icut = ( isparse / 2 / fPairTypes.size() ) % nCutNames;
+    Int_t iclass = isparse / 2 / fPairTypes.size() / nCutNames;
+    TString identifier = Form("/%s/%s/%s/%s",fTrigClasses[iclass].c_str(),cutNames[icut].Data(),fPairTypes[ipairType].c_str(),chargeTypes[icharge]);
+    collection->Adopt(identifier.Data(),sparse);
+  }
+
+  return collection;
+}
@@ -0,0 +1,122 @@
+#ifndef ALIDIMUSKIMANALYSIS_H
+#define ALIDIMUSKIMANALYSIS_H
+
+/* $Id$ */
+
+//
+// AliDimuSkimAnalysis
+// Multi-threaded re-analysis of the dimuon skims
+//
+//  Author: Diego Stocco
+//
+
+#include <map>
+#include <string>
+#include <vector>
+#include "TString.h"
+#include "AliDimuBinning.h"
+
+class THnSparse;
+class AliMergeableCollection;
+class AliDimuSkimReader;
+struct AliDimuSkimBlock;
+
+class AliDimuSkimAnalysis {
+ public:
+  AliDimuSkimAnalysis();
+  ~AliDimuSkimAnalysis();
+
+  Bool_t AddFile ( const char* fileName );
+
+  /// Get binning of the output sparse
+  AliDimuBinning* GetBinning () { return &fBinning; }
+
+  void SetTrackletDistCuts ( const std::vector<Double_t>& cuts );
+
+  /// Comma separated list of pair types to be kept (all if empty)
+  void SelectPairTypes ( TString selectedPairTypes ) { fSelectedPairTypes = selectedPairTypes; }
+  /// Comma separated list of trigger classes to be kept (all if empty)
+  void SelectTrigClasses ( TString selectedTrigClasses ) { fSelectedTrigClasses = selectedTrigClasses; }
+  /// Comma separated list of charge types to be kept (OS,SS)
+  void SelectChargeTypes ( TString selectedChargeTypes ) { fSelectedChargeTypes = selectedChargeTypes; }
+
+  /// Minimum single muon pt
+  void SetMuonPtMin ( Double_t ptMin ) { fMuonPtMin = ptMin; }
+  /// Single muon pseudo-rapidity range
+  void SetMuonEtaRange ( Double_t etaMin, Double_t etaMax ) { fMuonEtaMin = etaMin; fMuonEtaMax = etaMax; }
+  /// Comma separated list of runs to be kept (all if empty)
+  void SelectRuns ( TString selectedRuns );
+  /// Use the sidecar index to read only the selected events (see AliDimuSkimIndex)
+  void SetUseIndex ( Bool_t useIndex ) { fUseIndex = useIndex; }
+  /// Write the sidecar index next to the skim when it is missing or stale (off by default)
+  void SetSaveIndex ( Bool_t saveIndex ) { fSaveIndex = saveIndex; }
+  /// Centrality range
+  void SetCentralityRange ( Double_t centralityMin, Double_t centralityMax ) { fCentralityMin = centralityMin; fCentralityMax = centralityMax; }
+  /// Apply the trigger pt-cut level of the trigger class to the pairs (as in the task)
+  void SetApplyTrigPtCut ( Bool_t applyTrigPtCut ) { fApplyTrigPtCut = applyTrigPtCut; }
+  /// Number of threads (0 = number of cores)
+  void SetNthreads ( Int_t nThreads ) { fNthreads = nThreads; }
+
+  AliMergeableCollection* Run ( const char* collectionName );
+
+ private:
+  AliDimuSkimAnalysis(const AliDimuSkimAnalysis&);
+  AliDimuSkimAnalysis& operator=(const AliDimuSkimAnalysis&);
+
+  /// Trigger pt-cut level of a trigger class in a run
+  struct TrigLevel {
+    Int_t fPtCutLevel;  ///< Pt-cut level of the trigger class
+    Bool_t fIsDimuon;   ///< Dimuon trigger class
+  };
+
+  /// Tables of a skim file mapped to the global tables
+  struct FileTables {
+    std::vector<Int_t> fTrigClass;   ///< Global trigger class index (-1 if not selected)
+    std::map<Int_t,std::vector<TrigLevel> > fTrigLevels; ///< Pt-cut levels of the trigger classes (index in file) per run
+    std::vector<Int_t> fPairType;    ///< Global pair type index (-1 if not selected)
+  };
+
+  /// Events to be processed
+  struct WorkItem {
+    Int_t fFile;       ///< File index
+    Int_t fBlock;      ///< Block index
+    UInt_t fFirstEvent; ///< First event in block
+    UInt_t fNevents;   ///< Number of events
+  };
+
+  /// Per-thread output
+  struct Output {
+    std::vector<THnSparse*> fSparses; ///< Sparse per identifier
+    std::vector<Double_t> fNevents;   ///< Number of events per trigger class
+  };
+
+  Int_t GetGlobalIndex ( std::vector<std::string>& names, const std::string& name );
+  Bool_t IsSelected ( const TString& list, const char* name ) const;
+  void BuildTables ();
+  void BuildWorkItems ( std::vector<WorkItem>& workItems ) const;
+  void ProcessBlock ( const AliDimuSkimBlock& block, UInt_t firstEvent, UInt_t lastEvent, const FileTables& tables, Output& output ) const;
+
+  AliDimuBinning fBinning; ///< Binning
+  std::vector<Double_t> fTrackletDistCuts; ///< Tracklet distance cuts (decreasing order)
+  TString fSelectedPairTypes; ///< Selected pair types
+  TString fSelectedTrigClasses; ///< Selected trigger classes
+  TString fSelectedChargeTypes; ///< Selected charge types
+  std::vector<Int_t> fSelectedRuns; ///< Selected runs (sorted)
+  Bool_t fUseIndex; ///< Use the sidecar index
+  Bool_t fSaveIndex; ///< Write the sidecar index if it is built
+  Double_t fMuonPtMin; ///< Minimum muon pt
+  Double_t fMuonEtaMin; ///< Minimum muon eta
+  Double_t fMuonEtaMax; ///< Maximum muon eta
+  Double_t fCentralityMin; ///< Minimum centrality
+  Double_t fCentralityMax; ///< Maximum centrality
+  Bool_t fApplyTrigPtCut; ///< Apply trigger class pt cut
+  Int_t fNthreads; ///< Number of threads
+
+  std::vector<AliDimuSkimReader*> fReaders; ///< Skim files
+  std::vector<FileTables> fFileTables; ///< Tables per file
+  std::vector<std::string> fTrigClasses; ///< Global trigger class table
+  std::vector<std::string> fPairTypes; ///< Global pair type table
+  Int_t fGeneratedIndex; ///< Global index of the generated class
+};
+
+#endif
@@ -0,0 +1,265 @@
+/**************************************************************************
+ * Copyright(c) 1998-2007, ALICE Experiment at CERN, All rights reserved. *
+ *                                                                        *
+ * Author: The ALICE Off-line Project.                                    *
+ * Contributors are mentioned in the code where appropriate.              *
+ *                                                                        *
+ * Permission to use, copy, modify and distribute this software and its   *
+ * documentation strictly for non-commercial purposes is hereby granted   *
+ * without fee, provided that the above copyright notice appears in all   *
+ * copies and that both the copyright notice and this permission notice   *
+ * appear in the supporting documentation. The authors make no claims     *
+ * about the suitability of this software for any purpose. It is          *
+ * provided "as is" without express or implied warranty.                  *
+ **************************************************************************/
+
+/* $Id$ */
+
+//-----------------------------------------------------------------------------
+/// \class AliDimuSkimIndex
+/// Index of a dimuon skim file (see AliDimuSkim).
+/// For each (run, centrality bin, trigger class) it stores the ranges of
+/// consecutive events in the skim blocks, so that a re-analysis restricted
+/// to some runs, centralities or trigger classes only reads the relevant events.
+/// The index is built with a single scan of the event columns and is saved
+/// in a small sidecar file (skim file name + ".idx").
+///
+/// \author Diego Stocco
+//-----------------------------------------------------------------------------
+
+#include "AliDimuSkimIndex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "AliDimuBinning.h"
+#include "AliDimuSkim.h"
+
+//________________________________________________________________________
+AliDimuSkimIndex::AliDimuSkimIndex() :
+fCentralityEdges(),
+fSkimSize(0),
+fSkimEvents(0),
+fRanges()
+{
+  /// Ctor.
+  AliDimuBinning binning;
+  fCentralityEdges = binning.GetEdges(AliDimuBinning::kCentrality);
+}
+
+//________________________________________________________________________
+AliDimuSkimIndex::~AliDimuSkimIndex()
+{
+  /// Dtor.
+}
+
+//________________________________________________________________________
+std::string AliDimuSkimIndex::GetIndexFileName ( const char* skimFileName )
+{
+  /// Name of the sidecar index file
+  return std::string(skimFileName) + ".idx";
+}
+
+//________________________________________________________________________
+Int_t AliDimuSkimIndex::FindCentralityBin ( Double_t centrality ) const
+{
+  /// Centrality bin (0 = underflow, n+1 = overflow, 0xffff = undefined)
+  if ( std::isnan(centrality) ) return 0xffff;
+  return std::upper_bound(fCentralityEdges.begin(), fCentralityEdges.end(), centrality) - fCentralityEdges.begin();
+}
+
+//________________________________________________________________________
+Bool_t AliDimuSkimIndex::Build ( const AliDimuSkimReader& reader )
+{
+  /// Build the index with a scan of the event columns of the skim
+  fRanges.clear();
+  fSkimSize = reader.GetSize();
+  fSkimEvents = reader.GetNevents();
+  AliDimuSkimBlock block;
+  for ( Int_t iblock=0; iblock<reader.GetNblocks(); ++iblock ) {
+    if ( ! reader.GetBlock(iblock,block) ) {
+      printf("E-AliDimuSkimIndex::Build: corrupted block %i in %s\n", iblock, reader.GetFileName());
+      fRanges.clear();
+      return kFALSE;
+    }
+    for ( UInt_t iev=0; iev<block.fNevents; ++iev ) {
+      Int_t centralityBin = FindCentralityBin(block.fCentrality[iev]);
+      ULong64_t trigMask = block.fTrigMask[iev];
+      for ( Int_t ibit=0; ibit<64 && ( trigMask >> ibit ); ++ibit ) {
+        if ( ( ( trigMask >> ibit ) & 0x1 ) == 0 ) continue;
+        std::vector<EventRange>& ranges = fRanges[GetKey(block.fRun[iev],centralityBin,ibit)];
+        if ( ! ranges.empty() && ranges.back().fBlock == (UInt_t)iblock && ranges.back().fFirstEvent + ranges.back().fNevents == iev ) ++ranges.back().fNevents;
+        else {
+          EventRange range = { (UInt_t)iblock, iev, 1 };
+          ranges.push_back(range);
+        }
+      } // loop on trigger classes
+    } // loop on events
+  } // loop on blocks
+  return kTRUE;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuSkimIndex::Save ( const char* indexFileName ) const
+{
+  /// Write the index to file
+  std::FILE* file = std::fopen(indexFileName, "wb");
+  if ( ! file ) {
+    printf("W-AliDimuSkimIndex::Save: cannot write %s\n", indexFileName);
+    return kFALSE;
+  }
+  Bool_t isOk = kTRUE;
+  auto write = [file,&isOk] ( const void* data, size_t size ) {
+    if ( isOk && std::fwrite(data, 1, size, file) != size ) isOk = kFALSE;
+  };
+  UInt_t version = kVersion;
+  write(Magic(), 8);
+  write(&version, sizeof(version));
+  write(&fSkimSize, sizeof(fSkimSize));
+  write(&fSkimEvents, sizeof(fSkimEvents));
+  UInt_t nEntries = fCentralityEdges.size();
+  write(&nEntries, sizeof(nEntries));
+  write(fCentralityEdges.data(), nEntries*sizeof(Double_t));
+  nEntries = fRanges.size();
+  write(&nEntries, sizeof(nEntries));
+  for ( auto& entry : fRanges ) {
+    write(&entry.first, sizeof(entry.first));
+    nEntries = entry.second.size();
+    write(&nEntries, sizeof(nEntries));
+    write(entry.second.data(), nEntries*sizeof(EventRange));
+  }
+  if ( std::fclose(file) != 0 ) isOk = kFALSE;
+  if ( ! isOk ) {
+    printf("W-AliDimuSkimIndex::Save: error while writing %s\n", indexFileName);
+    std::remove(indexFileName);
+  }
+  return isOk;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuSkimIndex::Load ( const char* indexFileName, const AliDimuSkimReader& reader )
+{
+  /// Read the index from file.
+  /// Returns kFALSE if the file is missing, corrupted or does not match the skim
+  fRanges.clear();
+  std::FILE* file = std::fopen(indexFileName, "rb");
+  if ( ! file ) return kFALSE;
+  auto read = [file] ( void* data, size_t size ) {
+    return ( std::fread(data, 1, size, file) == size );
+  };
+  Char_t magic[8];
+  UInt_t version = 0, nEntries = 0;
+  Bool_t isOk = read(magic, sizeof(magic)) && std::memcmp(magic, Magic(), sizeof(magic)) == 0 &&
+    read(&version, sizeof(version)) && version == kVersion &&
+    read(&fSkimSize, sizeof(fSkimSize)) && fSkimSize == reader.GetSize() &&
+    read(&fSkimEvents, sizeof(fSkimEvents)) && fSkimEvents == reader.GetNevents() &&
+    read(&nEntries, sizeof(nEntries));
+  if ( isOk ) {
+    fCentralityEdges.resize(nEntries);
+    isOk = read(fCentralityEdges.data(), nEntries*sizeof(Double_t)) && read(&nEntries, sizeof(nEntries));
+  }
+  for ( UInt_t ientry=0; isOk && ientry<nEntries; ++ientry ) {
+    ULong64_t key = 0;
+    UInt_t nRanges = 0;
+    isOk = read(&key, sizeof(key)) && read(&nRanges, sizeof(nRanges));
+    if ( ! isOk ) break;
+    std::vector<EventRange>& ranges = fRanges[key];
+    ranges.resize(nRanges);
+    isOk = read(ranges.data(), nRanges*sizeof(EventRange));
+    for ( const EventRange& range : ranges ) {
+      if ( range.fBlock >= (UInt_t)reader.GetNblocks() || range.fFirstEvent + range.fNevents > reader.GetBlockInfo(range.fBlock).fNevents ) isOk = kFALSE;
+    }
+  }
+  std::fclose(file);
+  if ( ! isOk ) fRanges.clear();
+  return isOk;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuSkimIndex::Open ( const AliDimuSkimReader& reader, Bool_t saveIfBuilt )
+{
+  /// Load the sidecar index of the skim.
+  /// If it is missing or stale, the index is built in memory.
+  /// It is written next to the skim only if saveIfBuilt is set
+  std::string indexFileName = GetIndexFileName(reader.GetFileName());
+  std::vector<Double_t> centralityEdges = fCentralityEdges;
+  if ( Load(indexFileName.c_str(), reader) && fCentralityEdges == centralityEdges ) return kTRUE;
+  fCentralityEdges = centralityEdges;
+  if ( ! Build(reader) ) return kFALSE;
+  if ( saveIfBuilt ) Save(indexFileName.c_str());
+  return kTRUE;
+}
+
+//________________________________________________________________________
+void AliDimuSkimIndex::Select ( const std::vector<Int_t>& runs, Double_t centralityMin, Double_t centralityMax, const std::vector<Int_t>& trigClasses, std::vector<EventRange>& ranges ) const
+{
+  /// Get the event ranges of the selected runs, centrality range and trigger classes
+  /// (empty vectors select everything).
+  /// The ranges are sorted and do not overlap.
+  /// The selection is done at the granularity of the centrality bins:
+  /// the exact centrality cut must still be applied on the events.
+  ranges.clear();
+  Int_t nCentralityBins = fCentralityEdges.size() + 1;
+  std::vector<Bool_t> isCentralitySelected(nCentralityBins);
+  for ( Int_t ibin=0; ibin<nCentralityBins; ++ibin ) {
+    Double_t binMin = ( ibin == 0 ) ? -HUGE_VAL : fCentralityEdges[ibin-1];
+    Double_t binMax = ( ibin == nCentralityBins-1 ) ? HUGE_VAL : fCentralityEdges[ibin];
+    isCentralitySelected[ibin] = ( binMin <= centralityMax && binMax >= centralityMin );
+  }
+
+  auto addRanges = [&] ( std::map<ULong64_t,std::vector<EventRange> >::const_iterator begin, std::map<ULong64_t,std::vector<EventRange> >::const_iterator end ) {
+    for ( auto it = begin; it != end; ++it ) {
+      Int_t centralityBin = GetCentralityBin(it->first);
+      // Events with undefined centrality pass the centrality cut of the analysis
+      if ( centralityBin != 0xffff && ( centralityBin >= nCentralityBins || ! isCentralitySelected[centralityBin] ) ) continue;
+      if ( ! trigClasses.empty() && std::find(trigClasses.begin(), trigClasses.end(), GetTrigClass(it->first)) == trigClasses.end() ) continue;
+      ranges.insert(ranges.end(), it->second.begin(), it->second.end());
+    }
+  };
+
+  if ( runs.empty() ) addRanges(fRanges.begin(), fRanges.end());
+  else {
+    for ( Int_t run : runs ) {
+      ULong64_t firstKey = GetKey(run,0,0);
+      addRanges(fRanges.lower_bound(firstKey), fRanges.upper_bound(firstKey | 0xffffffff));
+    }
+  }
+
+  // The same event can be in several trigger classes: merge overlapping ranges
+  std::sort(ranges.begin(), ranges.end(), [] ( const EventRange& r1, const EventRange& r2 ) {
+    return ( r1.fBlock != r2.fBlock ) ? ( r1.fBlock < r2.fBlock ) : ( r1.fFirstEvent < r2.fFirstEvent );
+  });
+  size_t nMerged = 0;
+  for ( size_t irange=0; irange<ranges.size(); ++irange ) {
+    EventRange& last = ranges[nMerged];
+    const EventRange& range = ranges[irange];
+    if ( irange > 0 && range.fBlock == last.fBlock && range.fFirstEvent <= last.fFirstEvent + last.fNevents ) {
+      last.fNevents = std::max(last.fFirstEvent + last.fNevents, range.fFirstEvent + range.fNevents) - last.fFirstEvent;
+    }
+    else if ( irange > 0 ) ranges[++nMerged] = range;
+  }
+  if ( ! ranges.empty() ) ranges.resize(nMerged+1);
+}
+
+//________________________________________________________________________
+std::vector<Int_t> AliDimuSkimIndex::GetRuns () const
+{
+  /// List of runs in the index
+  std::vector<Int_t> runs;
+  for ( auto& entry : fRanges ) {
+    Int_t run = GetRun(entry.first);
+    if ( runs.empty() || runs.back() != run ) runs.push_back(run);
+  }
+  return runs;
+}
+
+//________________________________________________________________________
+ULong64_t AliDimuSkimIndex::CountEvents ( const std::vector<EventRange>& ranges )
+{
+  /// Number of events in the ranges
+  ULong64_t nEvents = 0;
+  for ( const EventRange& range : ranges ) nEvents += range.fNevents;
+  return nEvents;
+}
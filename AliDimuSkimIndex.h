@@ -0,0 +1,77 @@
+#ifndef ALIDIMUSKIMINDEX_H
+#define ALIDIMUSKIMINDEX_H
+
+/* $Id$ */
+
+//
+// AliDimuSkimIndex
+// Sidecar index of a dimuon skim: (run, centrality bin, trigger class) -> event ranges
+//
+//  Author: Diego Stocco
+//
+
+#include <map>
+#include <string>
+#include <vector>
+#include "Rtypes.h"
+
+class AliDimuSkimReader;
+
+class AliDimuSkimIndex {
+ public:
+  AliDimuSkimIndex();
+  ~AliDimuSkimIndex();
+
+  /// Range of consecutive events in a block
+  struct EventRange {
+    UInt_t fBlock;      ///< Block index
+    UInt_t fFirstEvent; ///< First event in block
+    UInt_t fNevents;    ///< Number of events
+  };
+
+  /// Format version
+  enum { kVersion = 1 };
+
+  static const char* Magic () { return "DIMUIDX1"; }
+  static std::string GetIndexFileName ( const char* skimFileName );
+
+  /// Set the centrality bin edges (to be called before Build)
+  void SetCentralityEdges ( const std::vector<Double_t>& edges ) { fCentralityEdges = edges; }
+  /// Centrality bin edges
+  const std::vector<Double_t>& GetCentralityEdges () const { return fCentralityEdges; }
+
+  Bool_t Build ( const AliDimuSkimReader& reader );
+  Bool_t Load ( const char* indexFileName, const AliDimuSkimReader& reader );
+  Bool_t Save ( const char* indexFileName ) const;
+  Bool_t Open ( const AliDimuSkimReader& reader, Bool_t saveIfBuilt = kFALSE );
+
+  void Select ( const std::vector<Int_t>& runs, Double_t centralityMin, Double_t centralityMax, const std::vector<Int_t>& trigClasses, std::vector<EventRange>& ranges ) const;
+  std::vector<Int_t> GetRuns () const;
+  static ULong64_t CountEvents ( const std::vector<EventRange>& ranges );
+
+  /// Number of (run, centrality bin, trigger class) keys
+  Int_t GetNkeys () const { return fRanges.size(); }
+
+ private:
+  AliDimuSkimIndex(const AliDimuSkimIndex&);
+  AliDimuSkimIndex& operator=(const AliDimuSkimIndex&);
+
+  /// Key: run in the upper 32 bits, then centrality bin (16 bits) and trigger class (8 bits)
+  static ULong64_t GetKey ( Int_t run, Int_t centralityBin, Int_t trigClass )
+  { return ( static_cast<ULong64_t>(static_cast<UInt_t>(run)) << 32 ) | ( static_cast<ULong64_t>(centralityBin & 0xffff) << 8 ) | ( trigClass & 0xff ); }
+  /// Run of the key
+  static Int_t GetRun ( ULong64_t key ) { return static_cast<Int_t>(key >> 32); }
+  /// Centrality bin of the key
+  static Int_t GetCentralityBin ( ULong64_t key ) { return ( key >> 8 ) & 0xffff; }
+  /// Trigger class of the key
+  static Int_t GetTrigClass ( ULong64_t key ) { return key & 0xff; }
+
+  Int_t FindCentralityBin ( Double_t centrality ) const;
+
+  std::vector<Double_t> fCentralityEdges; ///< Centrality bin edges (under/overflow are bins 0 and n+1)
+  ULong64_t fSkimSize; ///< Size of the indexed skim (to detect stale indexes)
+  ULong64_t fSkimEvents; ///< Number of events of the indexed skim
+  std::map<ULong64_t,std::vector<EventRange> > fRanges; ///< Event ranges per key
+};
+
+#endif
@@ -0,0 +1,184 @@
+/**************************************************************************
+ * Copyright(c) 1998-2007, ALICE Experiment at CERN, All rights reserved. *
+ *                                                                        *
+ * Author: The ALICE Off-line Project.                                    *
+ * Contributors are mentioned in the code where appropriate.              *
+ *                                                                        *
+ * Permission to use, copy, modify and distribute this software and its   *
+ * documentation strictly for non-commercial purposes is hereby granted   *
+ * without fee, provided that the above copyright notice appears in all   *
+ * copies and that both the copyright notice and this permission notice   *
+ * appear in the supporting documentation. The authors make no claims     *
+ * about the suitability of this software for any purpose. It is          *
+ * provided "as is" without express or implied warranty.                  *
+ **************************************************************************/
+
+/* $Id$ */
+
+//-----------------------------------------------------------------------------
+/// \class AliDimuSlowEvents
+/// Bounded list of the events with the longest processing time,
+/// with what is needed to find them again (run, event id, input file and entry),
+/// their size (muon candidates, SPD tracklets) and the time spent in each stage
+/// (see AliDimuStageTimers).
+/// The lists of different workers are merged keeping the slowest events overall.
+///
+/// \author Diego Stocco
+//-----------------------------------------------------------------------------
+
+#include "AliDimuSlowEvents.h"
+
+#include <algorithm>
+#include "TCollection.h"
+#include "TMath.h"
+#include "AliDimuStageTimers.h"
+
+/// \cond CLASSIMP
+ClassImp(AliDimuSlowEvents) // Class implementation in ROOT context
+/// \endcond
+
+//________________________________________________________________________
+AliDimuSlowEvents::AliDimuSlowEvents() :
+TNamed(),
+fMaxEvents(0),
+fNstages(0),
+fRun(),
+fEventId(),
+fFileName(),
+fEntry(),
+fNcandidates(),
+fNtracklets(),
+fTime(),
+fStageTimes(),
+fMinTime(0.),
+fMinIndex(-1)
+{
+  /// Default ctor.
+}
+
+//________________________________________________________________________
+AliDimuSlowEvents::AliDimuSlowEvents ( const char* name, Int_t maxEvents, Int_t nStages ) :
+TNamed(name,"Slowest events"),
+fMaxEvents(maxEvents),
+fNstages(nStages),
+fRun(),
+fEventId(),
+fFileName(),
+fEntry(),
+fNcandidates(),
+fNtracklets(),
+fTime(),
+fStageTimes(),
+fMinTime(0.),
+fMinIndex(-1)
+{
+  /// Ctor.
+}
+
+//________________________________________________________________________
+AliDimuSlowEvents::~AliDimuSlowEvents()
+{
+  /// Dtor.
+}
+
+//________________________________________________________________________
+void AliDimuSlowEvents::AddEvent ( Int_t run, ULong64_t eventId, const char* fileName, Long64_t entry, Int_t nCandidates, Int_t nTracklets, Double_t time, const Double_t* stageTimes )
+{
+  /// Add the event if it is among the slowest ones (times in us).
+  /// When the list is full, the fastest event is replaced
+  if ( fMaxEvents <= 0 || ! IsSlow(time) ) return;
+  Int_t ievent = GetNevents();
+  if ( ievent < fMaxEvents ) {
+    fRun.push_back(0);
+    fEventId.push_back(0);
+    fFileName.push_back("");
+    fEntry.push_back(0);
+    fNcandidates.push_back(0);
+    fNtracklets.push_back(0);
+    fTime.push_back(0.);
+    fStageTimes.resize(fStageTimes.size()+fNstages);
+  }
+  else ievent = fMinIndex;
+
+  fRun[ievent] = run;
+  fEventId[ievent] = eventId;
+  fFileName[ievent] = fileName;
+  fEntry[ievent] = entry;
+  fNcandidates[ievent] = nCandidates;
+  fNtracklets[ievent] = nTracklets;
+  fTime[ievent] = time;
+  for ( Int_t istage=0; istage<fNstages; ++istage ) fStageTimes[ievent*fNstages+istage] = stageTimes[istage];
+  UpdateMinTime();
+}
+
+//________________________________________________________________________
+void AliDimuSlowEvents::CopyEvent ( const AliDimuSlowEvents& other, Int_t ievent )
+{
+  /// Add an event of another list
+  std::vector<Double_t> stageTimes(fNstages,0.);
+  for ( Int_t istage=0; istage<TMath::Min(fNstages,other.fNstages); ++istage ) stageTimes[istage] = other.GetStageTime(ievent,istage);
+  AddEvent(other.fRun[ievent], other.fEventId[ievent], other.fFileName[ievent].Data(), other.fEntry[ievent], other.fNcandidates[ievent], other.fNtracklets[ievent], other.fTime[ievent], stageTimes.data());
+}
+
+//________________________________________________________________________
+void AliDimuSlowEvents::UpdateMinTime ()
+{
+  /// Find the fastest event of the list
+  fMinIndex = -1;
+  fMinTime = 0.;
+  for ( Int_t ievent=0; ievent<GetNevents(); ++ievent ) {
+    if ( fMinIndex < 0 || fTime[ievent] < fMinTime ) {
+      fMinIndex = ievent;
+      fMinTime = fTime[ievent];
+    }
+  }
+}
+
+//________________________________________________________________________
+std::vector<Int_t> AliDimuSlowEvents::GetSortedIndexes () const
+{
+  /// Indexes of the events from the slowest to the fastest
+  std::vector<Int_t> indexes(GetNevents());
+  for ( Int_t ievent=0; ievent<GetNevents(); ++ievent ) indexes[ievent] = ievent;
+  std::sort(indexes.begin(), indexes.end(), [this] ( Int_t i1, Int_t i2 ) { return fTime[i1] > fTime[i2]; });
+  return indexes;
+}
+
+//________________________________________________________________________
+Long64_t AliDimuSlowEvents::Merge ( TCollection* list )
+{
+  /// Merge the lists, keeping the slowest events.
+  /// The maximum number of events is the largest of the lists
+  if ( ! list ) return 0;
+  TIter next(list);
+  TObject* obj = 0x0;
+  while ( (obj = next()) ) {
+    const AliDimuSlowEvents* other = dynamic_cast<const AliDimuSlowEvents*>(obj);
+    if ( ! other ) {
+      printf("E-AliDimuSlowEvents::Merge: cannot merge %s (%s)\n", obj->GetName(), obj->ClassName());
+      return -1;
+    }
+    if ( other->fMaxEvents > fMaxEvents ) fMaxEvents = other->fMaxEvents;
+    if ( fNstages == 0 && GetNevents() == 0 ) fNstages = other->fNstages;
+    for ( Int_t ievent=0; ievent<other->GetNevents(); ++ievent ) CopyEvent(*other, ievent);
+  }
+  return GetNevents();
+}
+
+//________________________________________________________________________
+void AliDimuSlowEvents::Print ( Option_t* /*option*/ ) const
+{
+  /// Print the events from the slowest to the fastest
+  printf("%i slowest events (times in us)\n", GetNevents());
+  printf("%8s %20s %8s %8s %10s", "run", "eventId", "muons", "trkl", "time");
+  for ( Int_t istage=0; istage<fNstages; ++istage ) {
+    printf(" %10s", ( fNstages == AliDimuStageTimers::kNstages ) ? AliDimuStageTimers::GetStageName(istage) : Form("stage%i",istage));
+  }
+  printf("\n");
+  std::vector<Int_t> indexes = GetSortedIndexes();
+  for ( Int_t ievent : indexes ) {
+    printf("%8i %20llu %8i %8i %10.1f", fRun[ievent], fEventId[ievent], fNcandidates[ievent], fNtracklets[ievent], fTime[ievent]);
+    for ( Int_t istage=0; istage<fNstages; ++istage ) printf(" %10.1f", GetStageTime(ievent,istage));
+    printf("\n         %s entry %lld\n", fFileName[ievent].Data(), fEntry[ievent]);
+  }
+}
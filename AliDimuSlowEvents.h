@@ -0,0 +1,79 @@
+#ifndef ALIDIMUSLOWEVENTS_H
+#define ALIDIMUSLOWEVENTS_H
+
+/* $Id$ */
+
+//
+// AliDimuSlowEvents
+// Mergeable list of the slowest events
+//
+//  Author: Diego Stocco
+//
+
+#include <vector>
+#include "TNamed.h"
+#include "TString.h"
+
+class TCollection;
+
+class AliDimuSlowEvents : public TNamed {
+ public:
+  AliDimuSlowEvents();
+  AliDimuSlowEvents ( const char* name, Int_t maxEvents, Int_t nStages );
+  virtual ~AliDimuSlowEvents();
+
+  /// The event would enter the list
+  Bool_t IsSlow ( Double_t time ) const { return ( GetNevents() < fMaxEvents || time > fMinTime ); }
+
+  void AddEvent ( Int_t run, ULong64_t eventId, const char* fileName, Long64_t entry, Int_t nCandidates, Int_t nTracklets, Double_t time, const Double_t* stageTimes );
+
+  /// Number of events in the list
+  Int_t GetNevents () const { return fTime.size(); }
+  /// Maximum number of events in the list
+  Int_t GetMaxEvents () const { return fMaxEvents; }
+  /// Number of stages
+  Int_t GetNstages () const { return fNstages; }
+  /// Run number
+  Int_t GetRun ( Int_t ievent ) const { return fRun[ievent]; }
+  /// Event identifier (AliVHeader::GetEventIdAsLong)
+  ULong64_t GetEventId ( Int_t ievent ) const { return fEventId[ievent]; }
+  /// Input file
+  const TString& GetFileName ( Int_t ievent ) const { return fFileName[ievent]; }
+  /// Entry in the input chain
+  Long64_t GetEntry ( Int_t ievent ) const { return fEntry[ievent]; }
+  /// Number of muon candidates
+  Int_t GetNcandidates ( Int_t ievent ) const { return fNcandidates[ievent]; }
+  /// Number of SPD tracklets
+  Int_t GetNtracklets ( Int_t ievent ) const { return fNtracklets[ievent]; }
+  /// Processing time (us)
+  Double_t GetTime ( Int_t ievent ) const { return fTime[ievent]; }
+  /// Processing time of the stage (us)
+  Double_t GetStageTime ( Int_t ievent, Int_t istage ) const { return fStageTimes[ievent*fNstages+istage]; }
+
+  std::vector<Int_t> GetSortedIndexes () const;
+
+  Long64_t Merge ( TCollection* list );
+
+  virtual void Print ( Option_t* option = "" ) const;
+
+ private:
+  void CopyEvent ( const AliDimuSlowEvents& other, Int_t ievent );
+  void UpdateMinTime ();
+
+  Int_t fMaxEvents;                 ///< Maximum number of events
+  Int_t fNstages;                   ///< Number of stages
+  std::vector<Int_t> fRun;          ///< Run number
+  std::vector<ULong64_t> fEventId;  ///< Event identifier
+  std::vector<TString> fFileName;   ///< Input file
+  std::vector<Long64_t> fEntry;     ///< Entry in the input chain
+  std::vector<Int_t> fNcandidates;  ///< Number of muon candidates
+  std::vector<Int_t> fNtracklets;   ///< Number of SPD tracklets
+  std::vector<Float_t> fTime;       ///< Processing time (us)
+  std::vector<Float_t> fStageTimes; ///< Processing time per stage (us, fNstages per event)
+  Double_t fMinTime;                ///< Shortest time in the list
+  Int_t fMinIndex;                  ///< Index of the shortest time in the list
+
+  ClassDef(AliDimuSlowEvents, 1); // Mergeable list of the slowest events
+};
+
+#endif
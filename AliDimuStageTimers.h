@@ -0,0 +1,106 @@
+#ifndef ALIDIMUSTAGETIMERS_H
+#define ALIDIMUSTAGETIMERS_H
+
+/* $Id$ */
+
+//
+// AliDimuStageTimers
+// Low-overhead timers and counters of the stages of the event processing
+//
+//  Author: Diego Stocco
+//
+
+#include <algorithm>
+#include <chrono>
+#include "Rtypes.h"
+
+/// Wall time (steady clock, ns) spent in each stage of UserExec and counters of the processed objects.
+/// The stages are timed by chaining: Stop returns the current time, which starts the next stage.
+/// The timers are accumulated per worker and flushed to the output collection at the end of the job.
+/// The times of the current event are also kept, to find the slow events
+class AliDimuStageTimers {
+ public:
+  AliDimuStageTimers() { Reset(); }
+
+  /// Stages
+  enum EStage {
+    kEventCuts,          ///< Event selection
+    kTrackSelection,     ///< Track cuts and muon building
+    kParticleType,       ///< Single muon source and history
+    kPairClassification, ///< Common ancestor, pair type and its selection
+    kPairKinematics,     ///< Pair kinematics and weight
+    kTrackletCounting,   ///< Tracklets in the pair hemisphere
+    kFill,               ///< Identifier, collection lookup and sparse fill
+    kEventMixing,        ///< Mixed-event pairs
+    kSkim,               ///< Skim output
+    kTotal,              ///< Whole UserExec
+    kNstages             ///< Number of stages
+  };
+
+  /// Counters
+  enum ECounter {
+    kEvents,          ///< Input events
+    kSelectedEvents,  ///< Events passing the event cuts
+    kCandidates,      ///< Muon candidates (tracks or MC particles)
+    kSelectedMuons,   ///< Selected muons
+    kPairs,           ///< Pairs passing the pair type selection
+    kFills,           ///< Sparse fills
+    kNewIdentifiers,  ///< Objects added to the collection
+    kWorkers,         ///< Flushed timers (one per worker)
+    kNcounters        ///< Number of counters
+  };
+
+  /// Current time (ns)
+  static Long64_t Now () { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+  /// Add the time elapsed since start to the stage and return the current time
+  Long64_t Stop ( Int_t stage, Long64_t start )
+  {
+    Long64_t now = Now();
+    fTime[stage] += now - start;
+    fEventTime[stage] += now - start;
+    return now;
+  }
+
+  /// Reset the times of the current event
+  void BeginEvent () { std::fill(fEventTime, fEventTime+kNstages, 0); }
+
+  /// Increment the counter
+  void Count ( Int_t counter, Long64_t n = 1 ) { fCount[counter] += n; }
+
+  /// Time spent in the stage (ns)
+  Long64_t GetTime ( Int_t stage ) const { return fTime[stage]; }
+  /// Time spent in the stage in the current event (ns)
+  Long64_t GetEventTime ( Int_t stage ) const { return fEventTime[stage]; }
+  /// Counter value
+  Long64_t GetCount ( Int_t counter ) const { return fCount[counter]; }
+
+  /// Reset timers and counters
+  void Reset ()
+  {
+    std::fill(fTime, fTime+kNstages, 0);
+    std::fill(fEventTime, fEventTime+kNstages, 0);
+    std::fill(fCount, fCount+kNcounters, 0);
+  }
+
+  /// Stage name
+  static const char* GetStageName ( Int_t stage )
+  {
+    static const char* names[kNstages] = { "eventCuts", "trackSelection", "particleType", "pairClassification", "pairKinematics", "trackletCounting", "fill", "eventMixing", "skim", "total" };
+    return names[stage];
+  }
+
+  /// Counter name
+  static const char* GetCounterName ( Int_t counter )
+  {
+    static const char* names[kNcounters] = { "events", "selectedEvents", "candidates", "selectedMuons", "pairs", "fills", "newIdentifiers", "workers" };
+    return names[counter];
+  }
+
+ private:
+  Long64_t fTime[kNstages];      ///< Time per stage (ns)
+  Long64_t fEventTime[kNstages]; ///< Time per stage in the current event (ns)
+  Long64_t fCount[kNcounters];   ///< Counters
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef ALIDIMUTRACKPREFILTER_H
+#define ALIDIMUTRACKPREFILTER_H
+
+/* $Id$ */
+
+//
+// AliDimuTrackPrefilter
+// Batch prefilter of the muon tracks of the event
+//
+//  Author: Diego Stocco
+//
+
+#include <vector>
+#include "Rtypes.h"
+#include "TMath.h"
+#include "AliMuonTrackCuts.h"
+
+/// Batch version of the simple cuts of AliMuonTrackCuts (muon track, eta, theta_abs, trigger matching).
+/// The quantities of all the tracks of the event are stored in arrays (structure of arrays)
+/// and the cuts are evaluated in a loop without branches, which the compiler vectorizes.
+/// The limits are loosened by a small margin, so that the prefilter never rejects
+/// a track accepted by AliMuonTrackCuts::IsSelected: the tracks that pass the prefilter
+/// are then checked with the full selection (pDCA, chi2, sharp pt cut in the matching)
+class AliDimuTrackPrefilter {
+ public:
+  AliDimuTrackPrefilter() : fRequireMuon(kFALSE), fCutEta(kFALSE), fCutThetaAbs(kFALSE), fMinMatchTrigger(0), fNtracks(0) {}
+
+  /// Limits of AliMuonTrackCuts::GetSelectionMask
+  static constexpr Float_t kEtaMin = -4.;         ///< Lower eta limit
+  static constexpr Float_t kEtaMax = -2.5;        ///< Upper eta limit
+  static constexpr Float_t kThetaAbsMin = 2.;     ///< Lower limit of the polar angle at the end of the absorber (degrees)
+  static constexpr Float_t kThetaAbsMax = 10.;    ///< Upper limit of the polar angle at the end of the absorber (degrees)
+  static constexpr Float_t kMargin = 1.e-3;       ///< Loosening of the limits (single precision storage)
+
+  /// Set the cuts from the filter mask of AliMuonTrackCuts.
+  /// No muon track requirement when no cut is applied, as in AliMuonTrackCuts::IsSelected
+  void Configure ( Bool_t requireMuon, Bool_t cutEta, Bool_t cutThetaAbs, Int_t minMatchTrigger )
+  {
+    fRequireMuon = requireMuon;
+    fCutEta = cutEta;
+    fCutThetaAbs = cutThetaAbs;
+    fMinMatchTrigger = minMatchTrigger;
+  }
+
+  /// Set the cuts from the filter mask of AliMuonTrackCuts (GetFilterMask)
+  void Configure ( UInt_t filterMask )
+  {
+    Int_t minMatchTrigger = 0;
+    if ( filterMask & AliMuonTrackCuts::kMuMatchHpt ) minMatchTrigger = 3;
+    else if ( filterMask & AliMuonTrackCuts::kMuMatchLpt ) minMatchTrigger = 2;
+    else if ( filterMask & AliMuonTrackCuts::kMuMatchApt ) minMatchTrigger = 1;
+    Configure(filterMask != 0, ( filterMask & AliMuonTrackCuts::kMuEta ) != 0, ( filterMask & AliMuonTrackCuts::kMuThetaAbs ) != 0, minMatchTrigger);
+  }
+
+  /// Polar angle at the end of the absorber (degrees) from the radial position there:
+  /// same as AliAnalysisMuonUtility::GetThetaAbsDeg (end of the absorber at 505 cm)
+  static Float_t GetThetaAbsDeg ( Double_t rAtAbsorberEnd ) { return TMath::ATan(rAtAbsorberEnd/505.)*TMath::RadToDeg(); }
+
+  /// Prepare the arrays for nTracks tracks
+  void Resize ( Int_t nTracks )
+  {
+    fNtracks = nTracks;
+    if ( (Int_t)fPass.size() < nTracks ) {
+      fIsMuon.resize(nTracks);
+      fEta.resize(nTracks);
+      fThetaAbs.resize(nTracks);
+      fMatchTrigger.resize(nTracks);
+      fPass.resize(nTracks);
+    }
+  }
+
+  /// Set the quantities of the track
+  void SetTrack ( Int_t itrack, Bool_t isMuon, Float_t eta, Float_t thetaAbsDeg, Int_t matchTrigger )
+  {
+    fIsMuon[itrack] = isMuon;
+    fEta[itrack] = eta;
+    fThetaAbs[itrack] = thetaAbsDeg;
+    fMatchTrigger[itrack] = matchTrigger;
+  }
+
+  /// Evaluate the cuts on all the tracks and return the number of tracks that pass
+  Int_t Select ()
+  {
+    const UChar_t noMuonCut = ! fRequireMuon, noEtaCut = ! fCutEta, noThetaAbsCut = ! fCutThetaAbs;
+    const Char_t minMatchTrigger = fMinMatchTrigger;
+    const UChar_t* isMuon = fIsMuon.data();
+    const Float_t* eta = fEta.data();
+    const Float_t* thetaAbs = fThetaAbs.data();
+    const Char_t* matchTrigger = fMatchTrigger.data();
+    UChar_t* pass = fPass.data();
+    Int_t nPass = 0;
+    for ( Int_t itrack=0; itrack<fNtracks; ++itrack ) {
+      UChar_t passEta = ( eta[itrack] > kEtaMin - kMargin ) & ( eta[itrack] < kEtaMax + kMargin );
+      UChar_t passThetaAbs = ( thetaAbs[itrack] > kThetaAbsMin - kMargin ) & ( thetaAbs[itrack] < kThetaAbsMax + kMargin );
+      pass[itrack] = ( noMuonCut | isMuon[itrack] ) & ( noEtaCut | passEta ) & ( noThetaAbsCut | passThetaAbs ) & ( matchTrigger[itrack] >= minMatchTrigger );
+      nPass += pass[itrack];
+    }
+    return nPass;
+  }
+
+  /// The track passes the prefilter
+  Bool_t Pass ( Int_t itrack ) const { return fPass[itrack]; }
+
+ private:
+  Bool_t fRequireMuon;                ///< Only muon tracks
+  Bool_t fCutEta;                     ///< Cut on eta
+  Bool_t fCutThetaAbs;                ///< Cut on theta_abs
+  Int_t fMinMatchTrigger;             ///< Minimum trigger matching level
+  Int_t fNtracks;                     ///< Number of tracks of the event
+  std::vector<UChar_t> fIsMuon;       ///< Muon track
+  std::vector<Float_t> fEta;          ///< Pseudo-rapidity
+  std::vector<Float_t> fThetaAbs;     ///< Polar angle at the end of the absorber (degrees)
+  std::vector<Char_t> fMatchTrigger;  ///< Trigger matching level
+  std::vector<UChar_t> fPass;         ///< Result of the prefilter
+};
+
+#endif
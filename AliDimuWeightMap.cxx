@@ -0,0 +1,171 @@
+/**************************************************************************
+ * Copyright(c) 1998-2007, ALICE Experiment at CERN, All rights reserved. *
+ *                                                                        *
+ * Author: The ALICE Off-line Project.                                    *
+ * Contributors are mentioned in the code where appropriate.              *
+ *                                                                        *
+ * Permission to use, copy, modify and distribute this software and its   *
+ * documentation strictly for non-commercial purposes is hereby granted   *
+ * without fee, provided that the above copyright notice appears in all   *
+ * copies and that both the copyright notice and this permission notice   *
+ * appear in the supporting documentation. The authors make no claims     *
+ * about the suitability of this software for any purpose. It is          *
+ * provided "as is" without express or implied warranty.                  *
+ **************************************************************************/
+
+/* $Id$ */
+
+//-----------------------------------------------------------------------------
+/// \class AliDimuWeightMap
+/// Weights on a N-dimensional grid with uniform axes, stored in a flat array,
+/// e.g. 1/(acceptance x efficiency) or a MC pt-shape correction.
+/// Each axis is associated to a variable of the task (AliAnalysisTaskDimu::kHvar...),
+/// so that the weight of a pair is looked up directly from the sparse coordinates:
+/// the cost is one multiplication per axis.
+///
+/// \author Diego Stocco
+//-----------------------------------------------------------------------------
+
+#include "AliDimuWeightMap.h"
+
+#include "TMath.h"
+#include "TAxis.h"
+#include "THnSparse.h"
+
+/// \cond CLASSIMP
+ClassImp(AliDimuWeightMap) // Class implementation in ROOT context
+/// \endcond
+
+//________________________________________________________________________
+AliDimuWeightMap::AliDimuWeightMap() :
+TObject(),
+fVars(),
+fNbins(),
+fMin(),
+fInvWidth(),
+fStride(),
+fWeights(),
+fOutsideWeight(1.)
+{
+  /// Default ctor.
+}
+
+//________________________________________________________________________
+AliDimuWeightMap::AliDimuWeightMap ( const AliDimuWeightMap& other ) :
+TObject(other),
+fVars(other.fVars),
+fNbins(other.fNbins),
+fMin(other.fMin),
+fInvWidth(other.fInvWidth),
+fStride(other.fStride),
+fWeights(other.fWeights),
+fOutsideWeight(other.fOutsideWeight)
+{
+  /// Copy ctor.
+}
+
+//________________________________________________________________________
+AliDimuWeightMap& AliDimuWeightMap::operator= ( const AliDimuWeightMap& other )
+{
+  /// Assignment operator
+  if ( this != &other ) {
+    TObject::operator=(other);
+    fVars = other.fVars;
+    fNbins = other.fNbins;
+    fMin = other.fMin;
+    fInvWidth = other.fInvWidth;
+    fStride = other.fStride;
+    fWeights = other.fWeights;
+    fOutsideWeight = other.fOutsideWeight;
+  }
+  return *this;
+}
+
+//________________________________________________________________________
+AliDimuWeightMap::~AliDimuWeightMap()
+{
+  /// Dtor.
+}
+
+//________________________________________________________________________
+void AliDimuWeightMap::AddAxis ( Int_t ivar, Int_t nBins, Double_t xMin, Double_t xMax )
+{
+  /// Add an axis for the variable ivar.
+  /// The weights are reset to 1
+  Long64_t stride = fWeights.empty() ? 1 : fWeights.size();
+  fVars.push_back(ivar);
+  fNbins.push_back(nBins);
+  fMin.push_back(xMin);
+  fInvWidth.push_back(nBins/(xMax-xMin));
+  fStride.push_back(stride);
+  fWeights.assign(stride*nBins, 1.);
+}
+
+//________________________________________________________________________
+void AliDimuWeightMap::SetWeight ( const Int_t* bins, Double_t weight )
+{
+  /// Set the weight of the cell (bins from 0 to nBins-1 on each axis)
+  Long64_t index = 0;
+  for ( size_t iaxis=0; iaxis<fVars.size(); ++iaxis ) {
+    if ( bins[iaxis] < 0 || bins[iaxis] >= fNbins[iaxis] ) return;
+    index += bins[iaxis] * fStride[iaxis];
+  }
+  fWeights[index] = weight;
+}
+
+//________________________________________________________________________
+Bool_t AliDimuWeightMap::UsesVariable ( Int_t ivar ) const
+{
+  /// Check if the weight depends on the variable
+  for ( Int_t var : fVars ) {
+    if ( var == ivar ) return kTRUE;
+  }
+  return kFALSE;
+}
+
+//________________________________________________________________________
+AliDimuWeightMap* AliDimuWeightMap::CreateFromSparse ( const THnSparse* sparse, const Int_t* vars, Bool_t invert, Double_t maxWeight )
+{
+  /// Create the map from the bins of the sparse (e.g. an efficiency map
+  /// from AliAnalysisTaskDimu::ComputeEfficiencyMap).
+  /// Axis i of the sparse is associated to the variable vars[i].
+  /// If invert is kTRUE the weight is 1/content (empty cells get weight 0).
+  /// Weights above maxWeight (if > 0) are set to 0.
+  /// Returns 0x0 if the sparse has non-uniform axes.
+  AliDimuWeightMap* weightMap = new AliDimuWeightMap();
+  Int_t nDims = sparse->GetNdimensions();
+  for ( Int_t idim=0; idim<nDims; ++idim ) {
+    TAxis* axis = sparse->GetAxis(idim);
+    Double_t width = ( axis->GetXmax() - axis->GetXmin() ) / axis->GetNbins();
+    for ( Int_t ibin=1; ibin<=axis->GetNbins(); ++ibin ) {
+      if ( TMath::Abs(axis->GetBinWidth(ibin)-width) > 1.e-6*width ) {
+        printf("E-AliDimuWeightMap::CreateFromSparse: axis %i of %s is not uniform\n", idim, sparse->GetName());
+        delete weightMap;
+        return 0x0;
+      }
+    }
+    weightMap->AddAxis(vars[idim], axis->GetNbins(), axis->GetXmin(), axis->GetXmax());
+  }
+
+  if ( invert ) weightMap->fWeights.assign(weightMap->fWeights.size(), 0.);
+  std::vector<Int_t> coord(nDims), bins(nDims);
+  for ( Long64_t ibin=0; ibin<sparse->GetNbins(); ++ibin ) {
+    Double_t content = sparse->GetBinContent(ibin, coord.data());
+    for ( Int_t idim=0; idim<nDims; ++idim ) bins[idim] = coord[idim] - 1;
+    Double_t weight = content;
+    if ( invert ) weight = ( content > 0. ) ? 1. / content : 0.;
+    if ( maxWeight > 0. && weight > maxWeight ) weight = 0.;
+    weightMap->SetWeight(bins.data(), weight);
+  }
+  return weightMap;
+}
+
+//________________________________________________________________________
+void AliDimuWeightMap::Print ( Option_t* /*option*/ ) const
+{
+  /// Print the map
+  printf("Weight map with %lli cells (%g MB), weight %g outside range\n", GetNcells(), GetNcells()*sizeof(Float_t)/1024./1024., fOutsideWeight);
+  for ( size_t iaxis=0; iaxis<fVars.size(); ++iaxis ) {
+    printf("  variable %i: %i bins in [%g, %g]\n", fVars[iaxis], fNbins[iaxis], fMin[iaxis], fMin[iaxis] + fNbins[iaxis] / fInvWidth[iaxis]);
+  }
+}
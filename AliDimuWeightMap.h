@@ -0,0 +1,66 @@
+#ifndef ALIDIMUWEIGHTMAP_H
+#define ALIDIMUWEIGHTMAP_H
+
+/* $Id$ */
+
+//
+// AliDimuWeightMap
+// N-dimensional weight map with uniform axes
+//
+//  Author: Diego Stocco
+//
+
+#include <vector>
+#include "TObject.h"
+
+class THnSparse;
+
+class AliDimuWeightMap : public TObject {
+ public:
+  AliDimuWeightMap();
+  AliDimuWeightMap ( const AliDimuWeightMap& other );
+  AliDimuWeightMap& operator= ( const AliDimuWeightMap& other );
+  virtual ~AliDimuWeightMap();
+
+  void AddAxis ( Int_t ivar, Int_t nBins, Double_t xMin, Double_t xMax );
+  void SetWeight ( const Int_t* bins, Double_t weight );
+  /// Weight outside the axes range
+  void SetOutsideWeight ( Double_t weight ) { fOutsideWeight = weight; }
+
+  static AliDimuWeightMap* CreateFromSparse ( const THnSparse* sparse, const Int_t* vars, Bool_t invert, Double_t maxWeight = 0. );
+
+  /// Number of axes
+  Int_t GetNaxes () const { return fVars.size(); }
+  /// Number of cells
+  Long64_t GetNcells () const { return fWeights.size(); }
+  Bool_t UsesVariable ( Int_t ivar ) const;
+
+  /// Weight for the variables x (x[ivar] is the value of the variable of the axis).
+  /// The outside weight is returned if the map has no cells
+  Double_t GetWeight ( const Double_t* x ) const
+  {
+    if ( fWeights.empty() ) return fOutsideWeight;
+    Long64_t index = 0;
+    for ( size_t iaxis=0; iaxis<fVars.size(); ++iaxis ) {
+      Double_t pos = ( x[fVars[iaxis]] - fMin[iaxis] ) * fInvWidth[iaxis];
+      if ( ! ( pos >= 0. && pos < fNbins[iaxis] ) ) return fOutsideWeight;
+      index += static_cast<Long64_t>(pos) * fStride[iaxis];
+    }
+    return fWeights[index];
+  }
+
+  virtual void Print ( Option_t* option = "" ) const;
+
+ private:
+  std::vector<Int_t> fVars;       ///< Variable of each axis
+  std::vector<Int_t> fNbins;      ///< Number of bins per axis
+  std::vector<Double_t> fMin;     ///< Lower edge per axis
+  std::vector<Double_t> fInvWidth; ///< Inverse of the bin width per axis
+  std::vector<Long64_t> fStride;  ///< Stride of the axis in the weight array
+  std::vector<Float_t> fWeights;  ///< Weights (first axis varies fastest)
+  Double_t fOutsideWeight;        ///< Weight outside the axes range
+
+  ClassDef(AliDimuWeightMap, 1); // N-dimensional weight map
+};
+
+#endif
@@ -0,0 +1,19 @@
+#ifdef __CINT__
+/* $Id$ */
+
+// Dictionary of the classes read and written by the command line tools
+// (dimuMerge, dimuOptimizeBinning, dimuSkimAnalysis). Generate it with:
+// rootcling -f G__DimuTools.cxx -I. -I$ALICE_PHYSICS/include -I$ALICE_ROOT/include
+//   AliDimuBinning.h AliDimuCompactSparse.h AliDimuOccupancy.h AliDimuSlowEvents.h DimuToolsLinkDef.h
+// and keep G__DimuTools_rdict.pcm next to the executables.
+
+#pragma link off all globals;
+#pragma link off all classes;
+#pragma link off all functions;
+
+#pragma link C++ class AliDimuBinning+;
+#pragma link C++ class AliDimuCompactSparse+;
+#pragma link C++ class AliDimuOccupancy+;
+#pragma link C++ class AliDimuSlowEvents+;
+
+#endif
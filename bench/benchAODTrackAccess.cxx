@@ -0,0 +1,244 @@
+/* $Id$ */
+
+//
+// benchAODTrackAccess
+// Microbenchmark of the access to the muon tracks of the AOD in
+// AliAnalysisTaskDimu: generic access (AliAnalysisMuonUtility, AliVParticle
+// virtual accessors and AliMuonTrackCuts::TrackPtCutMatchTrigClass, as for ESD input)
+// against the AOD fast path (AliDimuAODMuons, the code used by
+// AliAnalysisTaskDimu::LoadRecoTracks: single sweep with the non-virtual AliAODTrack accessors).
+//
+// A pool of AliAODEvent is filled with central barrel tracks and muon tracks,
+// then both sweeps do what the task does per event: list the candidates, select them,
+// build the compact muons and get their trigger level, looping over the pool.
+// The selection is the same in both paths (AliMuonTrackCuts::IsSelected in the task):
+// here it is replaced by the eta, theta_abs and trigger matching cuts read through
+// AliAnalysisMuonUtility, without the pDCA and chi2 cuts, so the speed-up only concerns
+// the candidate list, the muon kinematics and the trigger level.
+// The two sweeps must give the same checksum.
+//
+// Compile with (from the top directory):
+// g++ -O2 -std=c++11 `root-config --cflags` -I. -I$ALICE_ROOT/include -I$ALICE_PHYSICS/include bench/benchAODTrackAccess.cxx
+//   -o benchAODTrackAccess `root-config --libs` -L$ALICE_ROOT/lib -L$ALICE_PHYSICS/lib -lSTEERBase -lAOD -lOADB -lPWGmuon
+//
+// Usage:
+// benchAODTrackAccess [options] (benchAODTrackAccess -h for the list)
+//
+//  Author: Diego Stocco
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "TArrayI.h"
+#include "TMath.h"
+#include "TRandom3.h"
+#include "TStopwatch.h"
+#include "TString.h"
+
+#include "AliAODEvent.h"
+#include "AliAODTrack.h"
+#include "AliAnalysisMuonUtility.h"
+#include "AliMuonTrackCuts.h"
+#include "AliDimuAODMuons.h"
+
+/// Benchmark configuration
+struct BenchConfig {
+  Long64_t fNevents;        ///< Number of events read
+  Int_t fNpool;             ///< Number of events in the pool
+  Double_t fMeanMuons;      ///< Mean number of muon tracks per event
+  Double_t fMeanBarrel;     ///< Mean number of central barrel tracks per event
+  UInt_t fSeed;             ///< Seed
+};
+
+/// Result of a sweep
+struct BenchSweep {
+  Long64_t fCandidates;     ///< Tracks that pass the simple cuts
+  Double_t fChecksum;       ///< Sum of the quantities read
+};
+
+//________________________________________________________________________
+void FillEvent ( AliAODEvent& aod, TRandom3& rnd, const BenchConfig& config )
+{
+  /// Fill the event with central barrel and muon tracks in random order
+  Int_t nMuons = rnd.Poisson(config.fMeanMuons);
+  Int_t nBarrel = rnd.Poisson(config.fMeanBarrel);
+  Int_t nTracks = nMuons + nBarrel;
+  for ( Int_t itrack=0; itrack<nTracks; ++itrack ) {
+    Bool_t isMuon = ( rnd.Rndm() * ( nTracks - itrack ) < nMuons );
+    Double_t pt = rnd.Exp(1.5);
+    Double_t eta = isMuon ? rnd.Uniform(-4.2,-2.3) : rnd.Uniform(-0.9,0.9);
+    Double_t phi = rnd.Uniform(0.,TMath::TwoPi());
+    Double_t p[3] = { pt*TMath::Cos(phi), pt*TMath::Sin(phi), pt*TMath::SinH(eta) };
+    AliAODTrack track;
+    track.SetP(p, kTRUE);
+    track.SetCharge(( rnd.Rndm() < 0.5 ) ? -1 : 1);
+    track.SetLabel(itrack);
+    if ( isMuon ) {
+      track.SetMUONClusterMap(0x3ff);
+      track.SetRAtAbsorberEnd(rnd.Uniform(15.,95.));
+      track.SetMatchTrigger(rnd.Integer(4));
+      --nMuons;
+    }
+    aod.AddTrack(&track);
+  }
+}
+
+//________________________________________________________________________
+Bool_t PassSimpleCuts ( const AliVParticle* track )
+{
+  /// Stand-in for AliMuonTrackCuts::IsSelected, the same in both paths:
+  /// eta, theta_abs and trigger matching cuts read through AliAnalysisMuonUtility
+  Double_t eta = track->Eta();
+  Double_t thetaAbsDeg = AliAnalysisMuonUtility::GetThetaAbsDeg(track);
+  return ( eta > -4. && eta < -2.5 && thetaAbsDeg > 2. && thetaAbsDeg < 10. && AliAnalysisMuonUtility::GetMatchTrigger(track) >= 1 );
+}
+
+//________________________________________________________________________
+void AddMuon ( const AliDimuMuon& muon, BenchSweep& result )
+{
+  /// Add the selected muon to the result
+  ++result.fCandidates;
+  result.fChecksum += muon.fPx + muon.fPy + muon.fPz + muon.fE + muon.fCharge + 10.*muon.fTrigLevel;
+}
+
+/// Track cuts used for the trigger level of the generic path
+AliMuonTrackCuts gTrackCuts;
+
+//________________________________________________________________________
+void GenericSweep ( const AliVEvent* event, BenchSweep& result )
+{
+  /// Generic access (the ESD path of the task): candidates from AliAnalysisMuonUtility,
+  /// kinematics from the AliVParticle virtual accessors and trigger level from
+  /// AliMuonTrackCuts::TrackPtCutMatchTrigClass (AliAnalysisTaskDimu::GetTrigLevel)
+  static std::vector<AliVParticle*> tracks;
+  tracks.clear();
+  Int_t nTracks = AliAnalysisMuonUtility::GetNTracks(event);
+  for ( Int_t itrack=0; itrack<nTracks; ++itrack ) tracks.push_back(AliAnalysisMuonUtility::GetTrack(itrack,event));
+  TArrayI ptCutLevel(2);
+  ptCutLevel.Reset();
+  for ( AliVParticle* track : tracks ) {
+    if ( ! AliAnalysisMuonUtility::IsMuonTrack(track) || ! PassSimpleCuts(track) ) continue;
+    Double_t trackP = track->P();
+    Int_t trigLevel = 0;
+    for ( Int_t ilevel=3; ilevel>0; --ilevel ) {
+      ptCutLevel[0] = ilevel;
+      if ( gTrackCuts.TrackPtCutMatchTrigClass(track,ptCutLevel) ) {
+        trigLevel = ilevel;
+        break;
+      }
+    }
+    AliDimuMuon muon;
+    muon.Set(track->Px(), track->Py(), track->Pz(), TMath::Sqrt(trackP*trackP + AliAnalysisMuonUtility::MuonMass2()), track->Charge(), trigLevel);
+    AddMuon(muon, result);
+  }
+}
+
+//________________________________________________________________________
+void DirectSweep ( const AliVEvent* event, BenchSweep& result )
+{
+  /// AOD fast path of the task: the candidates and their compact muons are read
+  /// in a single sweep (AliDimuAODMuons), the trigger level is the matching level
+  static AliDimuAODMuons aodMuons;
+  static std::vector<AliVParticle*> tracks;
+  aodMuons.Load(static_cast<const AliAODEvent*>(event), kTRUE, tracks, 0x0);
+  for ( Int_t icand=0; icand<aodMuons.GetNcandidates(); ++icand ) {
+    if ( ! PassSimpleCuts(tracks[icand]) ) continue;
+    AliDimuMuon muon = aodMuons.GetMuon(icand);
+    muon.fTrigLevel = TMath::Min((Int_t)muon.fTrigLevel, 3);
+    AddMuon(muon, result);
+  }
+}
+
+//________________________________________________________________________
+Double_t TimeSweep ( void (*sweep)(const AliVEvent*, BenchSweep&), const std::vector<AliAODEvent*>& pool, Long64_t nEvents, BenchSweep& result )
+{
+  /// Read nEvents events of the pool and return the real time (s)
+  result.fCandidates = 0;
+  result.fChecksum = 0.;
+  TStopwatch watch;
+  watch.Start();
+  for ( Long64_t iev=0; iev<nEvents; ++iev ) sweep(pool[iev%pool.size()], result);
+  watch.Stop();
+  return watch.RealTime();
+}
+
+//________________________________________________________________________
+void PrintUsage ( const char* program )
+{
+  /// Print usage
+  printf("Usage: %s [options]\n", program);
+  printf("Options:\n");
+  printf("  -n <nEvents>      number of events read (default: 1000000)\n");
+  printf("  -e <nPool>        number of different events (default: 1000)\n");
+  printf("  -m <mean>         mean number of muon tracks per event (default: 4)\n");
+  printf("  -b <mean>         mean number of central barrel tracks per event, 0 for muon AODs (default: 0)\n");
+  printf("  -s <seed>         seed (default: 12345)\n");
+}
+
+//________________________________________________________________________
+int main ( int argc, char** argv )
+{
+  BenchConfig config = { 1000000, 1000, 4., 0., 12345 };
+
+  for ( Int_t iarg=1; iarg<argc; ++iarg ) {
+    TString arg = argv[iarg];
+    Bool_t hasValue = ( iarg+1 < argc );
+    const char* value = hasValue ? argv[iarg+1] : "";
+    Bool_t isOk = kTRUE;
+    if ( arg == "-h" || arg == "--help" ) {
+      PrintUsage(argv[0]);
+      return 0;
+    }
+    else if ( arg.BeginsWith("-") && hasValue ) {
+      if ( arg == "-n" ) config.fNevents = atoll(value);
+      else if ( arg == "-e" ) config.fNpool = TMath::Max(atoi(value),1);
+      else if ( arg == "-m" ) config.fMeanMuons = atof(value);
+      else if ( arg == "-b" ) config.fMeanBarrel = atof(value);
+      else if ( arg == "-s" ) config.fSeed = atoi(value);
+      else isOk = kFALSE;
+      ++iarg;
+    }
+    else isOk = kFALSE;
+
+    if ( ! isOk ) {
+      printf("E-benchAODTrackAccess: invalid option %s\n", arg.Data());
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  // Fill the pool
+  TRandom3 rnd(config.fSeed);
+  std::vector<AliAODEvent*> pool(config.fNpool);
+  Long64_t nTracks = 0;
+  for ( AliAODEvent*& aod : pool ) {
+    aod = new AliAODEvent();
+    aod->CreateStdContent();
+    FillEvent(*aod, rnd, config);
+    nTracks += aod->GetNumberOfTracks();
+  }
+  printf("%lld events read from a pool of %i (seed %u), %.2f tracks per event (%.1f muon tracks)\n\n",
+         config.fNevents, config.fNpool, config.fSeed, (Double_t)nTracks/config.fNpool, config.fMeanMuons);
+
+  // Warm up, then time both sweeps
+  BenchSweep generic, direct;
+  TimeSweep(GenericSweep, pool, config.fNpool, generic);
+  Double_t genericTime = TimeSweep(GenericSweep, pool, config.fNevents, generic);
+  Double_t directTime = TimeSweep(DirectSweep, pool, config.fNevents, direct);
+
+  printf("%-16s %10s %12s %12s %14s\n", "access", "time (ms)", "ns/event", "ns/track", "candidates");
+  printf("%-16s %10.1f %12.1f %12.2f %14lld\n", "generic", 1000.*genericTime, 1.e9*genericTime/config.fNevents, 1.e9*genericTime*config.fNpool/config.fNevents/TMath::Max(nTracks,1LL), generic.fCandidates);
+  printf("%-16s %10.1f %12.1f %12.2f %14lld\n", "direct AOD", 1000.*directTime, 1.e9*directTime/config.fNevents, 1.e9*directTime*config.fNpool/config.fNevents/TMath::Max(nTracks,1LL), direct.fCandidates);
+  printf("\nSpeed-up (candidate list, kinematics and trigger level; same selection): %.2f\n", directTime > 0. ? genericTime/directTime : 0.);
+
+  Int_t status = 0;
+  if ( generic.fCandidates != direct.fCandidates || TMath::Abs(generic.fChecksum-direct.fChecksum) > 1.e-6*TMath::Abs(generic.fChecksum) ) {
+    printf("E-benchAODTrackAccess: different results (checksums %g and %g)\n", generic.fChecksum, direct.fChecksum);
+    status = 1;
+  }
+
+  for ( AliAODEvent* aod : pool ) delete aod;
+  return status;
+}
@@ -0,0 +1,196 @@
+/* $Id$ */
+
+//
+// benchCompactSparse
+// Size and read/write time of the dimuon sparses written with the default
+// THnSparse streamer and as AliDimuCompactSparse (both in ROOT files,
+// with the default compression). The round trip is checked bin by bin.
+//
+// Compile with (from the top directory):
+// rootcling -f G__DimuTools.cxx -I. -I$ALICE_ROOT/include
+//   AliDimuBinning.h AliDimuCompactSparse.h AliDimuOccupancy.h AliDimuSlowEvents.h DimuToolsLinkDef.h
+// g++ -O2 -std=c++11 `root-config --cflags` -I. -I$ALICE_ROOT/include bench/benchCompactSparse.cxx AliDimuMerger.cxx
+//   G__DimuTools.cxx AliDimuBinning.cxx AliDimuCompactSparse.cxx AliDimuOccupancy.cxx AliDimuSlowEvents.cxx
+//   -o benchCompactSparse `root-config --libs` -L$ALICE_ROOT/lib -lSTEERBase -lANALYSIS -lpthread
+// (dictionary of DimuToolsLinkDef.h, as for the command line tools)
+//
+// Usage:
+// benchCompactSparse output.root [collectionPath]   (sparses of a task output)
+// benchCompactSparse --synthetic [nPairs]           (one sparse filled with nPairs random pairs, default 1e6)
+//
+//  Author: Diego Stocco
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "TFile.h"
+#include "TH1.h"
+#include "TMath.h"
+#include "TObjArray.h"
+#include "TObjString.h"
+#include "TList.h"
+#include "TRandom3.h"
+#include "TStopwatch.h"
+#include "TString.h"
+#include "THnSparse.h"
+
+#include "AliMergeableCollection.h"
+#include "AliDimuBinning.h"
+#include "AliDimuCompactSparse.h"
+#include "AliDimuMerger.h"
+
+//________________________________________________________________________
+void CollectSparses ( AliMergeableCollection* collection, std::vector<THnSparse*>& sparses )
+{
+  /// Get the sparses of the collection
+  TObjArray* identifiers = collection->SortAllIdentifiers();
+  TIter nextIdentifier(identifiers);
+  TObjString* identifier = 0x0;
+  while ( (identifier = static_cast<TObjString*>(nextIdentifier())) ) {
+    TList* objectNames = collection->CreateListOfObjectNames(identifier->GetName());
+    TIter nextName(objectNames);
+    TObjString* objectName = 0x0;
+    while ( (objectName = static_cast<TObjString*>(nextName())) ) {
+      TObject* obj = collection->GetObject(identifier->GetName(), objectName->GetName());
+      if ( obj && obj->InheritsFrom(THnSparse::Class()) ) sparses.push_back(static_cast<THnSparse*>(obj));
+    }
+    delete objectNames;
+  }
+  delete identifiers;
+}
+
+//________________________________________________________________________
+THnSparse* CreateSynthetic ( Long64_t nPairs )
+{
+  /// Sparse with the default binning, filled with random pairs
+  AliDimuBinning binning;
+  THnSparse* sparse = binning.CreateSparse("DimuSparse","Synthetic pairs");
+  TRandom3 random(12345);
+  Double_t x[AliDimuBinning::kNaxes];
+  for ( Long64_t ipair=0; ipair<nPairs; ++ipair ) {
+    x[AliDimuBinning::kPt] = random.Exp(2.);
+    x[AliDimuBinning::kY] = random.Uniform(-4.,-2.5);
+    x[AliDimuBinning::kPhi] = random.Uniform(-TMath::Pi(),TMath::Pi());
+    x[AliDimuBinning::kInvMass] = ( random.Rndm() < 0.1 ) ? random.Gaus(3.1,0.07) : random.Exp(1.5);
+    x[AliDimuBinning::kCentrality] = random.Uniform(0.,100.);
+    x[AliDimuBinning::kTracklets] = random.Poisson(30.);
+    sparse->Fill(x);
+  }
+  return sparse;
+}
+
+//________________________________________________________________________
+Bool_t IsSame ( const THnSparse* sparse, const THnSparse* decoded )
+{
+  /// Check the bins of the round trip
+  if ( ! decoded || decoded->GetNbins() != sparse->GetNbins() || decoded->GetEntries() != sparse->GetEntries() ) return kFALSE;
+  std::vector<Int_t> coord(sparse->GetNdimensions());
+  THnSparse* mutableDecoded = const_cast<THnSparse*>(decoded);
+  for ( Long64_t ibin=0; ibin<sparse->GetNbins(); ++ibin ) {
+    Double_t content = sparse->GetBinContent(ibin, coord.data());
+    Long64_t jbin = mutableDecoded->GetBin(coord.data(), kFALSE);
+    if ( jbin < 0 || decoded->GetBinContent(jbin) != content || decoded->GetBinError2(jbin) != sparse->GetBinError2(ibin) ) return kFALSE;
+  }
+  return kTRUE;
+}
+
+//________________________________________________________________________
+int main ( int argc, char** argv )
+{
+  if ( argc < 2 ) {
+    printf("Usage: %s output.root [collectionPath] | --synthetic [nPairs]\n", argv[0]);
+    return 1;
+  }
+  TH1::AddDirectory(kFALSE);
+
+  std::vector<THnSparse*> sparses;
+  AliMergeableCollection* collection = 0x0;
+  if ( TString(argv[1]) == "--synthetic" ) {
+    Long64_t nPairs = ( argc > 2 ) ? atoll(argv[2]) : 1000000;
+    sparses.push_back(CreateSynthetic(nPairs));
+  }
+  else {
+    TString path = ( argc > 2 ) ? argv[2] : AliDimuMerger::FindCollectionPath(argv[1]).Data();
+    collection = AliDimuMerger::ReadCollection(argv[1], path.Data());
+    if ( ! collection ) return 1;
+    CollectSparses(collection, sparses);
+  }
+  Long64_t nBins = 0;
+  for ( THnSparse* sparse : sparses ) nBins += sparse->GetNbins();
+  printf("%lu sparses, %lld filled bins\n\n", sparses.size(), nBins);
+
+  const char* defaultFileName = "benchCompactSparse_default.root";
+  const char* compactFileName = "benchCompactSparse_compact.root";
+  TStopwatch watch;
+
+  // Default streamer
+  watch.Start();
+  TFile* file = TFile::Open(defaultFileName,"RECREATE");
+  for ( size_t isparse=0; isparse<sparses.size(); ++isparse ) file->WriteTObject(sparses[isparse], Form("sparse%lu",isparse));
+  file->Close();
+  delete file;
+  watch.Stop();
+  Double_t defaultWriteTime = watch.RealTime();
+
+  // Compact encoding
+  Long64_t encodedSize = 0;
+  Int_t nInvalid = 0;
+  watch.Start();
+  file = TFile::Open(compactFileName,"RECREATE");
+  for ( size_t isparse=0; isparse<sparses.size(); ++isparse ) {
+    AliDimuCompactSparse compact(sparses[isparse]);
+    if ( ! compact.IsValid() ) {
+      ++nInvalid;
+      continue;
+    }
+    encodedSize += compact.GetSize();
+    file->WriteTObject(&compact, Form("sparse%lu",isparse));
+  }
+  file->Close();
+  delete file;
+  watch.Stop();
+  Double_t compactWriteTime = watch.RealTime();
+
+  // Read back
+  watch.Start();
+  file = TFile::Open(defaultFileName);
+  Long64_t defaultSize = file->GetSize();
+  for ( size_t isparse=0; isparse<sparses.size(); ++isparse ) delete file->Get(Form("sparse%lu",isparse));
+  delete file;
+  watch.Stop();
+  Double_t defaultReadTime = watch.RealTime();
+
+  Int_t nDiffs = 0;
+  std::vector<THnSparse*> decoded(sparses.size(),0x0);
+  watch.Start();
+  file = TFile::Open(compactFileName);
+  Long64_t compactSize = file->GetSize();
+  for ( size_t isparse=0; isparse<sparses.size(); ++isparse ) {
+    AliDimuCompactSparse* compact = static_cast<AliDimuCompactSparse*>(file->Get(Form("sparse%lu",isparse)));
+    if ( ! compact ) continue;
+    decoded[isparse] = compact->Decode();
+    delete compact;
+  }
+  delete file;
+  watch.Stop();
+  Double_t compactReadTime = watch.RealTime();
+  for ( size_t isparse=0; isparse<sparses.size(); ++isparse ) {
+    if ( ! decoded[isparse] ) continue;
+    if ( ! IsSame(sparses[isparse], decoded[isparse]) ) ++nDiffs;
+    delete decoded[isparse];
+  }
+
+  printf("%-10s %12s %12s %12s\n", "", "file (kB)", "write (ms)", "read (ms)");
+  printf("%-10s %12.1f %12.1f %12.1f\n", "default", defaultSize/1024., 1000.*defaultWriteTime, 1000.*defaultReadTime);
+  printf("%-10s %12.1f %12.1f %12.1f\n", "compact", compactSize/1024., 1000.*compactWriteTime, 1000.*compactReadTime);
+  printf("\nCompact encoding before compression: %.1f kB (%.2f bytes/bin)\n", encodedSize/1024., nBins > 0 ? (Double_t)encodedSize/nBins : 0.);
+  printf("Size ratio default/compact: %.2f\n", compactSize > 0 ? (Double_t)defaultSize/compactSize : 0.);
+  if ( nInvalid > 0 ) printf("%i sparses could not be encoded\n", nInvalid);
+  printf("Round trip: %s\n", nDiffs == 0 ? "identical" : Form("%i sparses differ",nDiffs));
+
+  if ( collection ) delete collection;
+  else for ( THnSparse* sparse : sparses ) delete sparse;
+  return ( nDiffs == 0 ) ? 0 : 1;
+}
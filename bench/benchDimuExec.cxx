@@ -0,0 +1,751 @@
+/* $Id$ */
+
+//
+// benchDimuExec
+// Microbenchmarks of the per-event work of AliAnalysisTaskDimu::UserExec
+// (reconstructed step), on synthetic events and without the AliRoot input handlers.
+//
+// The input of UserExec is replaced by light stand-ins (BenchEvent), filled by
+// a seeded generator (BenchGenerator) with configurable muon and tracklet
+// multiplicities and MC ancestry:
+// - the event is an AliAODEvent with the muon tracks (AliAODTrack),
+//   which is the input AliMuonTrackCuts and AliAnalysisMuonUtility can read;
+// - the SPD tracklets are an AliMultiplicity;
+// - the MC stack is a list of AliAODMCParticle served by a minimal AliMCEvent (BenchMCEvent).
+// The stages call the code used by the task: AliMuonTrackCuts::IsSelected and
+// TrackPtCutMatchTrigClass for the selection, AliUtilityDimuonSource for the
+// classification, AliDimuPair for the kinematics, the tracklet counting and the
+// trigger pt-cut matching, and the indexed caches of the task (pair type index,
+// sparse per trigger class, tracklet cut and charge) for the fill.
+// The trigger classes and their pt-cut levels are given by a table
+// (AliMuonEventCuts needs the trigger configuration of the run).
+//
+// Each stage is timed separately, with its inputs prepared beforehand,
+// then the full event loop is timed end to end. The events are read
+// from a pool, the event generation is not included in the timings.
+//
+// Compile with (from the top directory):
+// rootcling -f G__DimuTools.cxx -I. -I$ALICE_ROOT/include
+//   AliDimuBinning.h AliDimuCompactSparse.h AliDimuOccupancy.h AliDimuSlowEvents.h DimuToolsLinkDef.h
+// g++ -O2 -std=c++11 `root-config --cflags` -I. -I$ALICE_ROOT/include -I$ALICE_PHYSICS/include bench/benchDimuExec.cxx
+//   G__DimuTools.cxx AliDimuBinning.cxx AliDimuCompactSparse.cxx AliDimuOccupancy.cxx AliDimuSlowEvents.cxx
+//   -o benchDimuExec `root-config --libs` -L$ALICE_ROOT/lib -L$ALICE_PHYSICS/lib
+//   -lSTEERBase -lESD -lAOD -lANALYSIS -lOADB -lPWGmuon
+// (dictionary of DimuToolsLinkDef.h, as for the command line tools)
+//
+// Usage:
+// benchDimuExec [options] (benchDimuExec -h for the list)
+//
+//  Author: Diego Stocco
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "TArrayI.h"
+#include "TBits.h"
+#include "TClonesArray.h"
+#include "TH1.h"
+#include "TMath.h"
+#include "TObjArray.h"
+#include "TObjString.h"
+#include "TPRegexp.h"
+#include "TRandom3.h"
+#include "TStopwatch.h"
+#include "TString.h"
+#include "THnSparse.h"
+
+#include "AliAODEvent.h"
+#include "AliAODTrack.h"
+#include "AliAODMCParticle.h"
+#include "AliMCEvent.h"
+#include "AliMultiplicity.h"
+#include "AliAnalysisMuonUtility.h"
+#include "AliMuonTrackCuts.h"
+#include "AliUtilityDimuonSource.h"
+#include "AliMergeableCollection.h"
+#include "AliDimuBinning.h"
+#include "AliDimuMuon.h"
+
+/// Stand-in for the MC event: the MC stack is a list of AliAODMCParticle,
+/// read by AliUtilityDimuonSource and AliAnalysisMuonUtility through GetTrack
+class BenchMCEvent : public AliMCEvent {
+ public:
+  BenchMCEvent () : AliMCEvent(), fParticles("AliAODMCParticle") {}
+  virtual ~BenchMCEvent () {}
+
+  /// Number of particles in the stack
+  virtual Int_t GetNumberOfTracks () const { return fParticles.GetEntriesFast(); }
+  /// Particle of the stack
+  virtual AliVParticle* GetTrack ( Int_t itrack ) const
+  { return ( itrack >= 0 && itrack < fParticles.GetEntriesFast() ) ? static_cast<AliVParticle*>(fParticles.UncheckedAt(itrack)) : 0x0; }
+
+  //________________________________________________________________________
+  Int_t AddParticle ( Int_t pdg, Int_t mother )
+  {
+    /// Add a particle to the stack and return its index.
+    /// The muons are final state particles, the other ones have decayed
+    Int_t index = fParticles.GetEntriesFast();
+    AliAODMCParticle* particle = new (fParticles[index]) AliAODMCParticle();
+    particle->SetPdgCode(pdg);
+    particle->SetMother(mother);
+    particle->SetStatus(( TMath::Abs(pdg) == 13 ) ? 1 : 11);
+    particle->SetLabel(index);
+    return index;
+  }
+
+ private:
+  BenchMCEvent(const BenchMCEvent&);
+  BenchMCEvent& operator=(const BenchMCEvent&);
+
+  TClonesArray fParticles; ///< MC stack
+};
+
+/// Stand-in for the input of UserExec
+struct BenchEvent {
+  AliAODEvent* fAOD;          ///< Event with the muon tracks
+  AliMultiplicity* fMult;     ///< SPD tracklets
+  BenchMCEvent* fMCEvent;     ///< MC stack (0x0 for data)
+  Float_t fCentrality;        ///< Centrality
+  UInt_t fTrigMask;           ///< Fired trigger classes (bit i = class i)
+};
+
+/// Trigger class with its pt-cut level
+struct BenchTrigClass {
+  const char* fName;     ///< Name
+  Int_t fPtCutLevel;     ///< Trigger pt-cut level
+  Bool_t fIsDimuon;      ///< Dimuon trigger
+  Double_t fProbability; ///< Probability that the class fires
+};
+
+const BenchTrigClass kTrigClasses[] = {
+  { "CMUL7-B-NOPF-MUFAST", 2, kTRUE, 0.5 },
+  { "CMLL7-B-NOPF-MUFAST", 2, kTRUE, 0.6 },
+  { "CMSL7-B-NOPF-MUFAST", 2, kFALSE, 0.3 },
+  { "CMSH7-B-NOPF-MUFAST", 3, kFALSE, 0.1 }
+};
+const Int_t kNtrigClasses = sizeof(kTrigClasses)/sizeof(kTrigClasses[0]);
+
+/// Generator settings
+struct BenchConfig {
+  Long64_t fNevents;            ///< Number of events read
+  Int_t fNpool;                 ///< Number of events in the pool
+  Double_t fMeanMuons;          ///< Mean number of muon sources per event (Poisson)
+  Double_t fMeanTracklets;      ///< Mean number of tracklets in a central event (Poisson)
+  Double_t fFakeFraction;       ///< Fraction of fake tracks (no MC label)
+  Double_t fQuarkoniumFraction; ///< Fraction of J/psi sources (two muons)
+  Double_t fCharmFraction;      ///< Fraction of open charm sources
+  Double_t fBeautyFraction;     ///< Fraction of open beauty sources (the rest are light hadron decays)
+  Bool_t fIsMC;                 ///< Fill the MC stack
+  Int_t fNtrigClasses;          ///< Number of trigger classes used
+  Int_t fRun;                   ///< Run of the track cut parameters
+  UInt_t fSeed;                 ///< Seed
+};
+
+/// Seeded generator of synthetic events
+class BenchGenerator {
+ public:
+  BenchGenerator ( const BenchConfig& config ) : fConfig(config), fRandom(config.fSeed) {}
+
+  //________________________________________________________________________
+  void Generate ( BenchEvent& event )
+  {
+    /// Generate an event
+    event.fAOD = new AliAODEvent();
+    event.fAOD->CreateStdContent();
+    event.fMCEvent = fConfig.fIsMC ? new BenchMCEvent() : 0x0;
+
+    event.fCentrality = fRandom.Uniform(0.,100.);
+    event.fTrigMask = 0;
+    for ( Int_t itrig=0; itrig<fConfig.fNtrigClasses; ++itrig ) {
+      if ( fRandom.Rndm() < kTrigClasses[itrig].fProbability ) event.fTrigMask |= ( 1u << itrig );
+    }
+    if ( event.fTrigMask == 0 ) event.fTrigMask = 1;
+
+    // SPD tracklets in |eta| < 2, with the residuals within the reconstruction windows
+    // (theta, phi, dphi, dtheta and the labels on the two layers, as AliITSMultReconstructor)
+    Int_t nTracklets = fRandom.Poisson(fConfig.fMeanTracklets * ( 1. - 0.009 * event.fCentrality ));
+    TBits fastOrFiredChips;
+    event.fMult = new AliMultiplicity(nTracklets, 0, 0, 0, fastOrFiredChips);
+    for ( Int_t itrk=0; itrk<nTracklets; ++itrk ) {
+      Float_t tracklet[6] = { (Float_t)( 2. * TMath::ATan(TMath::Exp(-fRandom.Uniform(-2.,2.))) ), (Float_t)fRandom.Uniform(0.,TMath::TwoPi()),
+                              (Float_t)fRandom.Gaus(0.0045,0.02), (Float_t)fRandom.Gaus(0.,0.01), -1., -1. };
+      event.fMult->SetTrackletData(itrk, tracklet);
+    }
+
+    Int_t nSources = fRandom.Poisson(fConfig.fMeanMuons);
+    for ( Int_t isrc=0; isrc<nSources; ++isrc ) {
+      Double_t rnd = fRandom.Rndm();
+      if ( rnd < fConfig.fFakeFraction ) {
+        AddTrack(event, -1, fRandom.Exp(1.));
+        continue;
+      }
+      rnd = fRandom.Rndm();
+      if ( rnd < fConfig.fQuarkoniumFraction ) {
+        // Prompt or non-prompt J/psi
+        Int_t mother = ( fRandom.Rndm() < 0.15 ) ? AddParticle(event, 521, AddParticle(event, 5, -1)) : -1;
+        Int_t jpsi = AddParticle(event, 443, mother);
+        Double_t pt = fRandom.Exp(1.5);
+        AddTrack(event, AddParticle(event, 13, jpsi), pt);
+        AddTrack(event, AddParticle(event, -13, jpsi), pt);
+      }
+      else if ( rnd < fConfig.fQuarkoniumFraction + fConfig.fCharmFraction ) {
+        AddTrack(event, AddParticle(event, -13, AddParticle(event, 411, AddParticle(event, 4, -1))), fRandom.Exp(1.));
+      }
+      else if ( rnd < fConfig.fQuarkoniumFraction + fConfig.fCharmFraction + fConfig.fBeautyFraction ) {
+        // Half of the beauty muons come from the b -> c cascade
+        Int_t hadron = AddParticle(event, 511, AddParticle(event, 5, -1));
+        if ( fRandom.Rndm() < 0.5 ) hadron = AddParticle(event, 421, hadron);
+        AddTrack(event, AddParticle(event, 13, hadron), fRandom.Exp(1.5));
+      }
+      else {
+        AddTrack(event, AddParticle(event, ( fRandom.Rndm() < 0.5 ) ? 13 : -13, AddParticle(event, 211, -1)), fRandom.Exp(0.7));
+      }
+    }
+  }
+
+ private:
+  //________________________________________________________________________
+  Int_t AddParticle ( BenchEvent& event, Int_t pdg, Int_t mother )
+  {
+    /// Add a particle to the MC stack (if MC) and return its index
+    return event.fMCEvent ? event.fMCEvent->AddParticle(pdg, mother) : -1;
+  }
+
+  //________________________________________________________________________
+  void AddTrack ( BenchEvent& event, Int_t label, Double_t pt )
+  {
+    /// Add a muon track in the spectrometer acceptance (with tails outside the cuts).
+    /// The fake tracks have a larger p x DCA and chi2, and are less often matched
+    Double_t eta = fRandom.Uniform(-4.2,-2.3);
+    Double_t phi = fRandom.Uniform(0.,TMath::TwoPi());
+    Double_t p[3] = { pt*TMath::Cos(phi), pt*TMath::Sin(phi), pt*TMath::SinH(eta) };
+    Double_t thetaAbsDeg = 180. - TMath::RadToDeg() * 2. * TMath::ATan(TMath::Exp(-eta)) + fRandom.Gaus(0.,0.5);
+    Double_t dca = fRandom.Exp(( label < 0 ) ? 300. : 60.) / ( pt * TMath::CosH(eta) );
+    Double_t dcaPhi = fRandom.Uniform(0.,TMath::TwoPi());
+    Short_t charge = ( label >= 0 ) ? ( ( event.fMCEvent->GetTrack(label)->PdgCode() < 0 ) ? 1 : -1 ) : ( ( fRandom.Rndm() < 0.5 ) ? 1 : -1 );
+    Double_t rnd = fRandom.Rndm();
+    Int_t matchTrig = ( label < 0 && rnd < 0.7 ) ? 0 : ( rnd < 0.1 ) ? 0 : ( rnd < 0.3 ) ? 1 : ( pt > 4. && rnd < 0.8 ) ? 3 : 2;
+
+    AliAODTrack track;
+    track.SetP(p, kTRUE);
+    track.SetCharge(charge);
+    track.SetLabel(label);
+    track.SetMUONClusterMap(0x3ff);
+    track.SetRAtAbsorberEnd(505. * TMath::Tan(TMath::DegToRad() * thetaAbsDeg));
+    track.SetXYAtDCA(dca * TMath::Cos(dcaPhi), dca * TMath::Sin(dcaPhi));
+    track.SetChi2perNDF(fRandom.Exp(( label < 0 ) ? 4. : 1.5));
+    track.SetMatchTrigger(matchTrig);
+    track.SetChi2MatchTrigger(( matchTrig > 0 ) ? fRandom.Exp(2.) : 0.);
+    event.fAOD->AddTrack(&track);
+  }
+
+  BenchConfig fConfig; ///< Settings
+  TRandom3 fRandom;    ///< Random generator
+};
+
+/// Shared state of the benchmark: the cuts, utilities and indexed caches of the task
+struct BenchContext {
+  AliMuonTrackCuts fTrackCuts;         ///< Track cuts
+  AliUtilityDimuonSource fDimuonSource; ///< Source classification
+  std::vector<Double_t> fDistCuts;     ///< Tracklet distance cuts (decreasing)
+  std::vector<TString> fDistCutsNames; ///< Names of the tracklet cuts (with "none")
+  TString fSelectedPairTypes;          ///< Selected pair types (empty = all)
+  std::map<TString,Int_t> fPairTypeIds; ///< Pair type index per name
+  std::vector<TString> fPairTypeNames; ///< Pair type names (by index)
+  std::vector<Bool_t> fPairTypeSelected; ///< Pair type selection (by index)
+  Bool_t fDataParticleTypeCached;      ///< Particle type of the data computed
+  Int_t fDataParticleType;             ///< Particle type of the data
+  Int_t fDataPairTypeId;               ///< Pair type index of the data (-1 until the first pair)
+  THnSparse* fSparse;                  ///< Template sparse
+  AliMergeableCollection* fCollection; ///< Output collection
+  std::vector<TH1*> fTrigClassEvents;  ///< Event counter per trigger class
+  std::vector<std::vector<THnSparse*> > fPairSparses; ///< Pair sparses per trigger class (by pair type, tracklet cut and charge)
+  Double_t fSink;                      ///< Accumulator, to keep the work from being optimised away
+};
+
+/// Work buffers of the event loop
+struct BenchWork {
+  std::vector<AliVParticle*> fTracks;  ///< Selected tracks
+  std::vector<AliDimuMuon> fMuons;     ///< Selected muons
+  std::vector<Int_t> fTypes;           ///< Particle types of the selected tracks
+  std::vector<Double_t> fTrackletPhi;  ///< Tracklet phi
+  std::vector<Double_t> fTrackletDist; ///< Tracklet distance
+  std::vector<Int_t> fNtrackletsPerCut; ///< Tracklets per cut
+};
+
+//________________________________________________________________________
+Int_t GetPairTypeId ( BenchContext& context, const TString& pairType )
+{
+  /// Index of the pair type, with its selection (AliAnalysisTaskDimu::GetPairTypeId)
+  std::map<TString,Int_t>::const_iterator it = context.fPairTypeIds.find(pairType);
+  if ( it != context.fPairTypeIds.end() ) return it->second;
+  Int_t id = context.fPairTypeNames.size();
+  context.fPairTypeIds[pairType] = id;
+  context.fPairTypeNames.push_back(pairType);
+  TPRegexp re(Form("(^|,)%s(,|$)",pairType.Data()));
+  context.fPairTypeSelected.push_back(context.fSelectedPairTypes.IsNull() || context.fSelectedPairTypes.Contains(re));
+  return id;
+}
+
+//________________________________________________________________________
+THnSparse* GetPairSparse ( BenchContext& context, Int_t trigClassId, Int_t pairTypeId, Int_t icut, Int_t icharge )
+{
+  /// Pair sparse from the cache of the trigger class, created in the collection
+  /// the first time (AliAnalysisTaskDimu::GetPairSparse and CreatePairSparse)
+  Int_t nCuts = context.fDistCutsNames.size();
+  std::vector<THnSparse*>& sparses = context.fPairSparses[trigClassId];
+  size_t isparse = ( pairTypeId * nCuts + icut ) * 2 + icharge;
+  if ( isparse < sparses.size() && sparses[isparse] ) return sparses[isparse];
+  if ( isparse >= sparses.size() ) sparses.resize(( pairTypeId + 1 ) * nCuts * 2, 0x0);
+  TString identifier = Form("/%s/%s/%s/%s",kTrigClasses[trigClassId].fName,context.fDistCutsNames[icut].Data(),context.fPairTypeNames[pairTypeId].Data(),icharge?"SS":"OS");
+  TObject* obj = context.fCollection->GetObject(identifier.Data(), "DimuSparse");
+  if ( ! obj ) {
+    obj = context.fSparse->Clone("DimuSparse");
+    context.fCollection->Adopt(identifier.Data(), obj);
+  }
+  sparses[isparse] = static_cast<THnSparse*>(obj);
+  return sparses[isparse];
+}
+
+//________________________________________________________________________
+Int_t GetTrigLevel ( BenchContext& context, AliVParticle* track, Int_t maxLevel )
+{
+  /// Highest trigger pt-cut level passed by the track, up to maxLevel (AliAnalysisTaskDimu::GetTrigLevel)
+  TArrayI ptCutLevel(2);
+  ptCutLevel.Reset();
+  for ( Int_t ilevel=maxLevel; ilevel>0; --ilevel ) {
+    ptCutLevel[0] = ilevel;
+    if ( context.fTrackCuts.TrackPtCutMatchTrigClass(track,ptCutLevel) ) return ilevel;
+  }
+  return 0;
+}
+
+//________________________________________________________________________
+Int_t SelectMuons ( BenchContext& context, const BenchEvent& event, BenchWork& work )
+{
+  /// Select the tracks with the track cuts and build the muons with their trigger level,
+  /// as in the track loop of UserExec (generic access). Returns the number of selected muons
+  work.fTracks.clear();
+  work.fMuons.clear();
+  Int_t nTracks = AliAnalysisMuonUtility::GetNTracks(event.fAOD);
+  for ( Int_t itrack=0; itrack<nTracks; ++itrack ) {
+    AliVParticle* track = AliAnalysisMuonUtility::GetTrack(itrack,event.fAOD);
+    if ( ! context.fTrackCuts.IsSelected(track) ) continue;
+    AliDimuMuon muon;
+    Double_t trackP = track->P();
+    muon.Set(track->Px(), track->Py(), track->Pz(), TMath::Sqrt(trackP*trackP + AliAnalysisMuonUtility::MuonMass2()), track->Charge(), 0);
+    work.fTracks.push_back(track);
+    work.fMuons.push_back(muon);
+  }
+
+  // The trigger level is only needed up to the highest level of the fired classes
+  Int_t nSelected = work.fMuons.size();
+  Int_t maxLevel = 0;
+  if ( nSelected >= 2 ) {
+    for ( Int_t itrig=0; itrig<kNtrigClasses; ++itrig ) {
+      if ( event.fTrigMask & ( 1u << itrig ) ) maxLevel = TMath::Max(maxLevel,kTrigClasses[itrig].fPtCutLevel);
+    }
+  }
+  for ( Int_t imu=0; imu<nSelected; ++imu ) work.fMuons[imu].fTrigLevel = ( maxLevel > 0 ) ? GetTrigLevel(context, work.fTracks[imu], maxLevel) : 0;
+  return nSelected;
+}
+
+//________________________________________________________________________
+void ClassifyTracks ( BenchContext& context, const BenchEvent& event, const std::vector<AliVParticle*>& tracks, std::vector<Int_t>& types )
+{
+  /// Particle type of the selected tracks, as in the track loop of UserExec:
+  /// per track, with its history, in MC, and once per job in data
+  types.resize(tracks.size());
+  for ( size_t imu=0; imu<tracks.size(); ++imu ) {
+    if ( event.fMCEvent ) {
+      types[imu] = context.fDimuonSource.GetParticleType(tracks[imu],event.fMCEvent);
+      context.fSink += AliAnalysisMuonUtility::GetTrackHistory(tracks[imu],event.fMCEvent).Length();
+    }
+    else {
+      if ( ! context.fDataParticleTypeCached ) {
+        context.fDataParticleType = context.fDimuonSource.GetParticleType(tracks[imu],0x0);
+        context.fDataParticleTypeCached = kTRUE;
+      }
+      types[imu] = context.fDataParticleType;
+    }
+  }
+}
+
+//________________________________________________________________________
+Int_t ClassifyPair ( BenchContext& context, const BenchEvent& event, const AliVParticle* track1, const AliVParticle* track2, Int_t type1, Int_t type2 )
+{
+  /// Pair type index, as in the pair loop of UserExec:
+  /// per pair in MC, from the first pair of the job in data
+  if ( event.fMCEvent ) {
+    Int_t commonAncestor = context.fDimuonSource.GetCommonAncestor(track1,track2,event.fMCEvent);
+    return GetPairTypeId(context, context.fDimuonSource.GetPairType(type1, type2, commonAncestor, event.fMCEvent));
+  }
+  if ( context.fDataPairTypeId < 0 ) {
+    Int_t commonAncestor = context.fDimuonSource.GetCommonAncestor(track1,track2,0x0);
+    context.fDataPairTypeId = GetPairTypeId(context, context.fDimuonSource.GetPairType(type1, type2, commonAncestor, 0x0));
+  }
+  return context.fDataPairTypeId;
+}
+
+//________________________________________________________________________
+void LoadTracklets ( AliMultiplicity* mult, BenchWork& work )
+{
+  /// Get the tracklet phi and distance once per event (AliAnalysisTaskDimu::LoadTracklets)
+  Int_t nTracklets = mult->GetNumberOfTracklets();
+  work.fTrackletPhi.resize(nTracklets);
+  work.fTrackletDist.resize(nTracklets);
+  for ( Int_t itrk=0; itrk<nTracklets; ++itrk ) {
+    work.fTrackletPhi[itrk] = mult->GetPhi(itrk);
+    work.fTrackletDist[itrk] = mult->CalcDist(itrk);
+  }
+}
+
+//________________________________________________________________________
+Long64_t FillPair ( BenchContext& context, const BenchEvent& event, const AliDimuMuon& mu1, const AliDimuMuon& mu2, Int_t pairTypeId, Double_t* containerInput, const Int_t* nTrackletsPerCut )
+{
+  /// Fill the sparses of the pair for the fired trigger classes and the tracklet cuts,
+  /// as in the pair loop of UserExec. Returns the number of fills
+  Int_t icharge = AliDimuPair::IsSameSign(mu1,mu2) ? 1 : 0;
+  Int_t nCuts = context.fDistCutsNames.size();
+  Long64_t nFills = 0;
+  for ( Int_t itrig=0; itrig<kNtrigClasses; ++itrig ) {
+    if ( ( event.fTrigMask & ( 1u << itrig ) ) == 0 ) continue;
+    if ( ! AliDimuPair::PassTrigPtCut(mu1.fTrigLevel, mu2.fTrigLevel, kTrigClasses[itrig].fPtCutLevel, kTrigClasses[itrig].fIsDimuon) ) continue;
+    for ( Int_t icut=0; icut<nCuts; ++icut ) {
+      containerInput[AliDimuBinning::kTracklets] = nTrackletsPerCut[icut];
+      GetPairSparse(context, itrig, pairTypeId, icut, icharge)->Fill(containerInput);
+      ++nFills;
+    }
+  }
+  return nFills;
+}
+
+//________________________________________________________________________
+Long64_t ProcessEvent ( BenchContext& context, const BenchEvent& event, BenchWork& work )
+{
+  /// Full per-event work, in the order of UserExec. Returns the number of fills
+  for ( Int_t itrig=0; itrig<kNtrigClasses; ++itrig ) {
+    if ( event.fTrigMask & ( 1u << itrig ) ) context.fTrigClassEvents[itrig]->Fill(1.);
+  }
+  Int_t nSelected = SelectMuons(context, event, work);
+  if ( nSelected < 2 ) return 0;
+  ClassifyTracks(context, event, work.fTracks, work.fTypes);
+
+  Int_t nCuts = context.fDistCuts.size();
+  Bool_t trackletsLoaded = kFALSE;
+  Double_t containerInput[AliDimuBinning::kNaxes];
+  containerInput[AliDimuBinning::kCentrality] = event.fCentrality;
+  Long64_t nFills = 0;
+  for ( Int_t imu=0; imu<nSelected; ++imu ) {
+    for ( Int_t jmu=imu+1; jmu<nSelected; ++jmu ) {
+      Int_t pairTypeId = ClassifyPair(context, event, work.fTracks[imu], work.fTracks[jmu], work.fTypes[imu], work.fTypes[jmu]);
+      if ( ! context.fPairTypeSelected[pairTypeId] ) continue;
+      AliDimuPair::Kinematics(work.fMuons[imu], work.fMuons[jmu], containerInput[AliDimuBinning::kPt], containerInput[AliDimuBinning::kY], containerInput[AliDimuBinning::kPhi], containerInput[AliDimuBinning::kInvMass]);
+      if ( ! trackletsLoaded ) {
+        LoadTracklets(event.fMult, work);
+        trackletsLoaded = kTRUE;
+      }
+      AliDimuPair::CountTracklets(containerInput[AliDimuBinning::kPhi], work.fTrackletPhi.data(), work.fTrackletDist.data(), work.fTrackletPhi.size(), context.fDistCuts.data(), nCuts, work.fNtrackletsPerCut.data());
+      nFills += FillPair(context, event, work.fMuons[imu], work.fMuons[jmu], pairTypeId, containerInput, work.fNtrackletsPerCut.data());
+    }
+  }
+  return nFills;
+}
+
+/// Per-event inputs of the stages, prepared before the timings
+struct BenchEventInput {
+  std::vector<AliVParticle*> fTracks;  ///< Selected tracks
+  std::vector<AliDimuMuon> fMuons;     ///< Selected muons, with their trigger level
+  std::vector<Int_t> fTypes;           ///< Particle types of the selected tracks
+  std::vector<Int_t> fPairTypeIds;     ///< Pair type indices (all the pairs)
+  std::vector<Double_t> fPairVars;     ///< Pair kinematics (kNaxes per pair)
+  std::vector<Int_t> fPairTracklets;   ///< Tracklets per cut (nCuts+1 per pair)
+};
+
+//________________________________________________________________________
+void PrepareInputs ( BenchContext& context, const std::vector<BenchEvent>& pool, std::vector<BenchEventInput>& inputs )
+{
+  /// Compute the inputs of each stage with the code of the end to end loop
+  Int_t nCuts = context.fDistCuts.size();
+  BenchWork work;
+  work.fNtrackletsPerCut.resize(nCuts+1);
+  inputs.resize(pool.size());
+  for ( size_t iev=0; iev<pool.size(); ++iev ) {
+    const BenchEvent& event = pool[iev];
+    BenchEventInput& input = inputs[iev];
+    Int_t nSelected = SelectMuons(context, event, work);
+    input.fTracks = work.fTracks;
+    input.fMuons = work.fMuons;
+    if ( nSelected < 2 ) continue;
+    ClassifyTracks(context, event, input.fTracks, input.fTypes);
+    LoadTracklets(event.fMult, work);
+    Double_t vars[AliDimuBinning::kNaxes];
+    vars[AliDimuBinning::kCentrality] = event.fCentrality;
+    for ( Int_t imu=0; imu<nSelected; ++imu ) {
+      for ( Int_t jmu=imu+1; jmu<nSelected; ++jmu ) {
+        input.fPairTypeIds.push_back(ClassifyPair(context, event, input.fTracks[imu], input.fTracks[jmu], input.fTypes[imu], input.fTypes[jmu]));
+        AliDimuPair::Kinematics(input.fMuons[imu], input.fMuons[jmu], vars[AliDimuBinning::kPt], vars[AliDimuBinning::kY], vars[AliDimuBinning::kPhi], vars[AliDimuBinning::kInvMass]);
+        AliDimuPair::CountTracklets(vars[AliDimuBinning::kPhi], work.fTrackletPhi.data(), work.fTrackletDist.data(), work.fTrackletPhi.size(), context.fDistCuts.data(), nCuts, work.fNtrackletsPerCut.data());
+        input.fPairVars.insert(input.fPairVars.end(), vars, vars+AliDimuBinning::kNaxes);
+        input.fPairTracklets.insert(input.fPairTracklets.end(), work.fNtrackletsPerCut.begin(), work.fNtrackletsPerCut.end());
+      }
+    }
+  }
+}
+
+/// Timing of a stage
+struct BenchResult {
+  const char* fName; ///< Stage
+  Double_t fTime;    ///< Real time (s)
+};
+
+//________________________________________________________________________
+void PrintResult ( const BenchResult& result, Long64_t nEvents, Long64_t nPairs )
+{
+  /// Print the time of a stage, per event and per pair
+  printf("%-22s %10.1f %14.0f %12.1f\n", result.fName, 1000.*result.fTime,
+         result.fTime > 0. ? nEvents/result.fTime : 0., nPairs > 0 ? 1.e9*result.fTime/nPairs : 0.);
+}
+
+//________________________________________________________________________
+void PrintUsage ( const char* program )
+{
+  /// Print usage
+  printf("Usage: %s [options]\n", program);
+  printf("Options:\n");
+  printf("  -n <nEvents>      number of events read (default: 1000000)\n");
+  printf("  -e <nPool>        number of different events (default: 1000)\n");
+  printf("  -m <mean>         mean number of muon sources per event (default: 3)\n");
+  printf("  -t <mean>         mean number of tracklets in central events (default: 60)\n");
+  printf("  -c <nClasses>     number of trigger classes, 1 to %i (default: 2)\n", kNtrigClasses);
+  printf("  -d <cut1,cut2..>  tracklet distance cuts (default: 1,0.5)\n");
+  printf("  -p <types>        selected pair types, comma separated (default: all)\n");
+  printf("  -r <run>          run of the track cut parameters (default: 244918)\n");
+  printf("  -s <seed>         seed (default: 12345)\n");
+  printf("  --data            no MC stack (the pair type is the one of the data)\n");
+}
+
+//________________________________________________________________________
+int main ( int argc, char** argv )
+{
+  BenchConfig config = { 1000000, 1000, 3., 60., 0.1, 0.1, 0.3, 0.2, kTRUE, 2, 244918, 12345 };
+  BenchContext context;
+  context.fSelectedPairTypes = "";
+  context.fDataParticleTypeCached = kFALSE;
+  context.fDataParticleType = 0;
+  context.fDataPairTypeId = -1;
+  context.fSink = 0.;
+  TString distCuts = "1,0.5";
+
+  for ( Int_t iarg=1; iarg<argc; ++iarg ) {
+    TString arg = argv[iarg];
+    Bool_t hasValue = ( iarg+1 < argc );
+    const char* value = hasValue ? argv[iarg+1] : "";
+    Bool_t isOk = kTRUE;
+    if ( arg == "-h" || arg == "--help" ) {
+      PrintUsage(argv[0]);
+      return 0;
+    }
+    else if ( arg == "--data" ) config.fIsMC = kFALSE;
+    else if ( arg.BeginsWith("-") && hasValue ) {
+      if ( arg == "-n" ) config.fNevents = atoll(value);
+      else if ( arg == "-e" ) config.fNpool = TMath::Max(atoi(value),1);
+      else if ( arg == "-m" ) config.fMeanMuons = atof(value);
+      else if ( arg == "-t" ) config.fMeanTracklets = atof(value);
+      else if ( arg == "-c" ) config.fNtrigClasses = TMath::Min(TMath::Max(atoi(value),1),kNtrigClasses);
+      else if ( arg == "-d" ) distCuts = value;
+      else if ( arg == "-p" ) context.fSelectedPairTypes = value;
+      else if ( arg == "-r" ) config.fRun = atoi(value);
+      else if ( arg == "-s" ) config.fSeed = atoi(value);
+      else isOk = kFALSE;
+      ++iarg;
+    }
+    else isOk = kFALSE;
+
+    if ( ! isOk ) {
+      printf("E-benchDimuExec: invalid option %s\n", arg.Data());
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+  TH1::AddDirectory(kFALSE);
+
+  context.fTrackCuts.SetIsMC(config.fIsMC);
+  context.fTrackCuts.SetAllowDefaultParams(kTRUE);
+  context.fTrackCuts.SetCustomParamFromRun(config.fRun);
+
+  TObjArray* cuts = distCuts.Tokenize(",");
+  for ( Int_t icut=0; icut<cuts->GetEntriesFast(); ++icut ) context.fDistCuts.push_back(static_cast<TObjString*>(cuts->UncheckedAt(icut))->String().Atof());
+  delete cuts;
+  std::sort(context.fDistCuts.begin(),context.fDistCuts.end(),std::greater<Double_t>());
+  for ( Double_t cut : context.fDistCuts ) context.fDistCutsNames.push_back(Form("trackletDistCuts_%g",cut));
+  context.fDistCutsNames.push_back("trackletDistCuts_none");
+  Int_t nCuts = context.fDistCuts.size();
+
+  AliDimuBinning binning;
+  context.fSparse = binning.CreateSparse("BaseDimuSparse","Sparse for tracks");
+  context.fCollection = new AliMergeableCollection("benchDimuExec");
+  for ( Int_t itrig=0; itrig<kNtrigClasses; ++itrig ) {
+    TH1* histo = new TH1D("nevents","nevents",1,0.5,1.5);
+    context.fCollection->Adopt(Form("/%s",kTrigClasses[itrig].fName), histo);
+    context.fTrigClassEvents.push_back(histo);
+  }
+  context.fPairSparses.resize(kNtrigClasses);
+
+  // Generate the pool and prepare the inputs of the stages
+  TStopwatch watch;
+  watch.Start();
+  BenchGenerator generator(config);
+  std::vector<BenchEvent> pool(config.fNpool);
+  for ( BenchEvent& event : pool ) generator.Generate(event);
+  std::vector<BenchEventInput> inputs;
+  PrepareInputs(context, pool, inputs);
+  watch.Stop();
+
+  Long64_t nPoolTracks = 0, nPoolTracklets = 0, nPoolSelected = 0, nPoolPairs = 0, nPoolSelectedPairs = 0;
+  for ( size_t iev=0; iev<pool.size(); ++iev ) {
+    nPoolTracks += pool[iev].fAOD->GetNumberOfTracks();
+    nPoolTracklets += pool[iev].fMult->GetNumberOfTracklets();
+    nPoolSelected += inputs[iev].fMuons.size();
+    nPoolPairs += inputs[iev].fPairTypeIds.size();
+    for ( Int_t pairTypeId : inputs[iev].fPairTypeIds ) nPoolSelectedPairs += context.fPairTypeSelected[pairTypeId];
+  }
+  Long64_t nEvents = config.fNevents;
+  Long64_t nPairs = 0, nSelectedPairs = 0;
+  for ( Long64_t iev=0; iev<nEvents; ++iev ) {
+    const BenchEventInput& input = inputs[iev%pool.size()];
+    nPairs += input.fPairTypeIds.size();
+    for ( Int_t pairTypeId : input.fPairTypeIds ) nSelectedPairs += context.fPairTypeSelected[pairTypeId];
+  }
+  printf("%lld events (%s, seed %u) read from a pool of %i generated in %.2f s\n", nEvents, config.fIsMC ? "MC" : "data", config.fSeed, config.fNpool, watch.RealTime());
+  printf("%.2f tracks, %.2f selected muons, %.1f tracklets, %.2f pairs (%.2f selected) per event, %i trigger classes, %i tracklet cuts\n",
+         (Double_t)nPoolTracks/config.fNpool, (Double_t)nPoolSelected/config.fNpool, (Double_t)nPoolTracklets/config.fNpool,
+         (Double_t)nPoolPairs/config.fNpool, (Double_t)nPoolSelectedPairs/config.fNpool, config.fNtrigClasses, nCuts);
+  printf("Pair types:");
+  for ( size_t itype=0; itype<context.fPairTypeNames.size(); ++itype ) printf(" %s%s", context.fPairTypeNames[itype].Data(), context.fPairTypeSelected[itype] ? "" : " (rejected)");
+  printf("\n\n");
+
+  std::vector<BenchResult> results;
+  BenchWork work;
+  work.fNtrackletsPerCut.resize(nCuts+1);
+  Double_t containerInput[AliDimuBinning::kNaxes];
+
+  // Track selection (track cuts, muon kinematics and trigger level)
+  watch.Start();
+  for ( Long64_t iev=0; iev<nEvents; ++iev ) context.fSink += SelectMuons(context, pool[iev%pool.size()], work);
+  watch.Stop();
+  results.push_back({ "selection", watch.RealTime() });
+
+  // Pair classification (particle types, common ancestor, pair type index and its selection)
+  watch.Start();
+  for ( Long64_t iev=0; iev<nEvents; ++iev ) {
+    const BenchEvent& event = pool[iev%pool.size()];
+    const BenchEventInput& input = inputs[iev%pool.size()];
+    Int_t nSelected = input.fMuons.size();
+    if ( nSelected < 2 ) continue;
+    ClassifyTracks(context, event, input.fTracks, work.fTypes);
+    for ( Int_t imu=0; imu<nSelected; ++imu ) {
+      for ( Int_t jmu=imu+1; jmu<nSelected; ++jmu ) {
+        Int_t pairTypeId = ClassifyPair(context, event, input.fTracks[imu], input.fTracks[jmu], work.fTypes[imu], work.fTypes[jmu]);
+        context.fSink += context.fPairTypeSelected[pairTypeId];
+      }
+    }
+  }
+  watch.Stop();
+  results.push_back({ "pair classification", watch.RealTime() });
+
+  // Pair kinematics (selected pairs)
+  watch.Start();
+  for ( Long64_t iev=0; iev<nEvents; ++iev ) {
+    const BenchEventInput& input = inputs[iev%pool.size()];
+    Int_t nSelected = input.fMuons.size();
+    Int_t ipair = 0;
+    for ( Int_t imu=0; imu<nSelected; ++imu ) {
+      for ( Int_t jmu=imu+1; jmu<nSelected; ++jmu, ++ipair ) {
+        if ( ! context.fPairTypeSelected[input.fPairTypeIds[ipair]] ) continue;
+        AliDimuPair::Kinematics(input.fMuons[imu], input.fMuons[jmu], containerInput[0], containerInput[1], containerInput[2], containerInput[3]);
+        context.fSink += containerInput[3];
+      }
+    }
+  }
+  watch.Stop();
+  results.push_back({ "pair kinematics", watch.RealTime() });
+
+  // Tracklet counting (tracklets loaded from AliMultiplicity once per event with a selected pair)
+  watch.Start();
+  for ( Long64_t iev=0; iev<nEvents; ++iev ) {
+    const BenchEvent& event = pool[iev%pool.size()];
+    const BenchEventInput& input = inputs[iev%pool.size()];
+    Bool_t trackletsLoaded = kFALSE;
+    for ( size_t ipair=0; ipair<input.fPairTypeIds.size(); ++ipair ) {
+      if ( ! context.fPairTypeSelected[input.fPairTypeIds[ipair]] ) continue;
+      if ( ! trackletsLoaded ) {
+        LoadTracklets(event.fMult, work);
+        trackletsLoaded = kTRUE;
+      }
+      AliDimuPair::CountTracklets(input.fPairVars[ipair*AliDimuBinning::kNaxes+AliDimuBinning::kPhi], work.fTrackletPhi.data(), work.fTrackletDist.data(), work.fTrackletPhi.size(), context.fDistCuts.data(), nCuts, work.fNtrackletsPerCut.data());
+      context.fSink += work.fNtrackletsPerCut[nCuts];
+    }
+  }
+  watch.Stop();
+  results.push_back({ "tracklet counting", watch.RealTime() });
+
+  // Histogram fill (trigger pt-cut matching, sparse cache and fill)
+  Long64_t nFills = 0;
+  watch.Start();
+  for ( Long64_t iev=0; iev<nEvents; ++iev ) {
+    const BenchEvent& event = pool[iev%pool.size()];
+    const BenchEventInput& input = inputs[iev%pool.size()];
+    Int_t nSelected = input.fMuons.size();
+    Int_t ipair = 0;
+    for ( Int_t imu=0; imu<nSelected; ++imu ) {
+      for ( Int_t jmu=imu+1; jmu<nSelected; ++jmu, ++ipair ) {
+        if ( ! context.fPairTypeSelected[input.fPairTypeIds[ipair]] ) continue;
+        std::copy(input.fPairVars.begin()+ipair*AliDimuBinning::kNaxes, input.fPairVars.begin()+(ipair+1)*AliDimuBinning::kNaxes, containerInput);
+        nFills += FillPair(context, event, input.fMuons[imu], input.fMuons[jmu], input.fPairTypeIds[ipair], containerInput, &input.fPairTracklets[ipair*(nCuts+1)]);
+      }
+    }
+  }
+  watch.Stop();
+  results.push_back({ "histogram fill", watch.RealTime() });
+  for ( std::vector<THnSparse*>& sparses : context.fPairSparses ) {
+    for ( THnSparse* sparse : sparses ) {
+      if ( sparse ) sparse->Reset();
+    }
+  }
+
+  // End to end
+  Long64_t nEndToEndFills = 0;
+  watch.Start();
+  for ( Long64_t iev=0; iev<nEvents; ++iev ) nEndToEndFills += ProcessEvent(context, pool[iev%pool.size()], work);
+  watch.Stop();
+  results.push_back({ "end to end", watch.RealTime() });
+
+  Double_t sumStages = 0.;
+  for ( size_t istage=0; istage+1<results.size(); ++istage ) sumStages += results[istage].fTime;
+
+  printf("%-22s %10s %14s %12s\n", "stage", "time (ms)", "events/s", "ns/pair");
+  for ( const BenchResult& result : results ) PrintResult(result, nEvents, nPairs);
+  printf("\nSum of the stages: %.1f ms (end to end: %.1f ms)\n", 1000.*sumStages, 1000.*results.back().fTime);
+  printf("End to end: %lld selected pairs, %lld fills in %i objects (checksum %g)\n", nSelectedPairs, nEndToEndFills, context.fCollection->NumberOfObjects(), context.fSink);
+
+  Int_t status = 0;
+  if ( nEndToEndFills != nFills ) {
+    printf("E-benchDimuExec: %lld fills end to end, %lld in the fill stage\n", nEndToEndFills, nFills);
+    status = 1;
+  }
+
+  for ( BenchEvent& event : pool ) {
+    delete event.fAOD;
+    delete event.fMult;
+    delete event.fMCEvent;
+  }
+  delete context.fCollection;
+  delete context.fSparse;
+  return status;
+}
@@ -0,0 +1,148 @@
+/* $Id$ */
+
+//
+// benchSkimIndex
+// Time to answer single-run and single-centrality queries on a dimuon skim,
+// scanning all the events or using the sidecar index (AliDimuSkimIndex).
+// Both methods read the muons of the selected events, so that the
+// comparison includes the access to the data and not only the lookup.
+//
+// Compile with (from the top directory):
+// g++ -O2 -std=c++11 `root-config --cflags` -I. bench/benchSkimIndex.cxx AliDimuSkimIndex.cxx AliDimuSkim.cxx AliDimuBinning.cxx
+//   -o benchSkimIndex `root-config --libs`
+//
+// Usage:
+// benchSkimIndex skim.dimu [run] [centralityMin:centralityMax]
+// (default: first run of the skim, centrality 0:10)
+//
+//  Author: Diego Stocco
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "TStopwatch.h"
+#include "TString.h"
+
+#include "AliDimuSkim.h"
+#include "AliDimuSkimIndex.h"
+
+/// Result of a query
+struct QueryResult {
+  ULong64_t fNevents; ///< Number of selected events
+  ULong64_t fNmuons;  ///< Number of muons in the selected events
+  Double_t fSumPz;    ///< Sum of the muon pz (to force reading the muons)
+};
+
+//________________________________________________________________________
+void ReadEvents ( const AliDimuSkimBlock& block, UInt_t firstEvent, UInt_t lastEvent, const std::vector<Int_t>& runs, Double_t centralityMin, Double_t centralityMax, QueryResult& result )
+{
+  /// Read the muons of the selected events in the range
+  for ( UInt_t iev=firstEvent; iev<lastEvent; ++iev ) {
+    if ( ! runs.empty() && block.fRun[iev] != runs[0] ) continue;
+    if ( block.fCentrality[iev] < centralityMin || block.fCentrality[iev] > centralityMax ) continue;
+    ++result.fNevents;
+    for ( UInt_t imu=block.fMuonBegin[iev]; imu<block.fMuonBegin[iev+1]; ++imu ) {
+      ++result.fNmuons;
+      result.fSumPz += block.fPz[imu];
+    }
+  }
+}
+
+//________________________________________________________________________
+QueryResult ScanQuery ( const AliDimuSkimReader& reader, const std::vector<Int_t>& runs, Double_t centralityMin, Double_t centralityMax )
+{
+  /// Answer the query with a scan of all the events
+  QueryResult result = { 0, 0, 0. };
+  AliDimuSkimBlock block;
+  for ( Int_t iblock=0; iblock<reader.GetNblocks(); ++iblock ) {
+    if ( ! reader.GetBlock(iblock,block) ) continue;
+    ReadEvents(block, 0, block.fNevents, runs, centralityMin, centralityMax, result);
+  }
+  return result;
+}
+
+//________________________________________________________________________
+QueryResult IndexQuery ( const AliDimuSkimReader& reader, const AliDimuSkimIndex& index, const std::vector<Int_t>& runs, Double_t centralityMin, Double_t centralityMax )
+{
+  /// Answer the query with the index
+  QueryResult result = { 0, 0, 0. };
+  std::vector<AliDimuSkimIndex::EventRange> ranges;
+  index.Select(runs, centralityMin, centralityMax, std::vector<Int_t>(), ranges);
+  AliDimuSkimBlock block;
+  for ( const AliDimuSkimIndex::EventRange& range : ranges ) {
+    if ( ! reader.GetBlock(range.fBlock,block) ) continue;
+    ReadEvents(block, range.fFirstEvent, range.fFirstEvent+range.fNevents, runs, centralityMin, centralityMax, result);
+  }
+  return result;
+}
+
+//________________________________________________________________________
+void Compare ( const char* queryName, const AliDimuSkimReader& reader, const AliDimuSkimIndex& index, const std::vector<Int_t>& runs, Double_t centralityMin, Double_t centralityMax, Int_t nRepetitions )
+{
+  /// Time the scan and the index query
+  TStopwatch watch;
+  QueryResult scanResult = { 0, 0, 0. }, indexResult = { 0, 0, 0. };
+
+  reader.SetRandomAccess(kFALSE);
+  watch.Start();
+  for ( Int_t irep=0; irep<nRepetitions; ++irep ) scanResult = ScanQuery(reader, runs, centralityMin, centralityMax);
+  watch.Stop();
+  Double_t scanTime = 1000. * watch.RealTime() / nRepetitions;
+
+  reader.SetRandomAccess(kTRUE);
+  watch.Start();
+  for ( Int_t irep=0; irep<nRepetitions; ++irep ) indexResult = IndexQuery(reader, index, runs, centralityMin, centralityMax);
+  watch.Stop();
+  Double_t indexTime = 1000. * watch.RealTime() / nRepetitions;
+
+  Bool_t isSame = ( scanResult.fNevents == indexResult.fNevents && scanResult.fNmuons == indexResult.fNmuons );
+  printf("%-28s events %10llu  muons %10llu  scan %9.3f ms  index %9.3f ms  speed-up %7.1f %s\n",
+         queryName, indexResult.fNevents, indexResult.fNmuons, scanTime, indexTime,
+         ( indexTime > 0. ) ? scanTime / indexTime : 0., isSame ? "" : "MISMATCH");
+}
+
+//________________________________________________________________________
+int main ( int argc, char** argv )
+{
+  if ( argc < 2 ) {
+    printf("Usage: %s skim.dimu [run] [centralityMin:centralityMax]\n", argv[0]);
+    return 1;
+  }
+
+  AliDimuSkimReader reader(argv[1]);
+  if ( ! reader.IsOpen() ) return 1;
+
+  TStopwatch watch;
+  AliDimuSkimIndex index;
+  watch.Start();
+  if ( ! index.Build(reader) ) return 1;
+  watch.Stop();
+  printf("Skim %s: %llu events in %i blocks (%.1f MB)\n", argv[1], reader.GetNevents(), reader.GetNblocks(), reader.GetSize()/1024./1024.);
+  printf("Index build: %.3f ms (%i keys)\n", 1000.*watch.RealTime(), index.GetNkeys());
+
+  std::string indexFileName = AliDimuSkimIndex::GetIndexFileName(argv[1]);
+  index.Save(indexFileName.c_str());
+  AliDimuSkimIndex loadedIndex;
+  watch.Start();
+  Bool_t isLoaded = loadedIndex.Load(indexFileName.c_str(), reader);
+  watch.Stop();
+  printf("Index load: %.3f ms %s\n\n", 1000.*watch.RealTime(), isLoaded ? "" : "(FAILED)");
+
+  std::vector<Int_t> allRuns = index.GetRuns();
+  if ( allRuns.empty() ) return 0;
+  Int_t run = ( argc > 2 ) ? atoi(argv[2]) : allRuns[0];
+  Double_t centralityMin = 0., centralityMax = 10.;
+  if ( argc > 3 ) sscanf(argv[3], "%lf:%lf", &centralityMin, &centralityMax);
+
+  const Int_t nRepetitions = 5;
+  std::vector<Int_t> runs(1,run);
+  std::vector<Int_t> noRuns;
+  Compare(Form("run %i", run), reader, index, runs, -1.e10, 1.e10, nRepetitions);
+  Compare(Form("centrality %g-%g", centralityMin, centralityMax), reader, index, noRuns, centralityMin, centralityMax, nRepetitions);
+  Compare(Form("run %i, centrality %g-%g", run, centralityMin, centralityMax), reader, index, runs, centralityMin, centralityMax, nRepetitions);
+  Compare("all events", reader, index, noRuns, -1.e10, 1.e10, nRepetitions);
+
+  return 0;
+}
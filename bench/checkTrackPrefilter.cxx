@@ -0,0 +1,197 @@
+/* $Id$ */
+
+//
+// checkTrackPrefilter
+// Check of the batch track prefilter of AliAnalysisTaskDimu (AliDimuTrackPrefilter)
+// on a recorded AOD sample: every track selected by AliMuonTrackCuts::IsSelected
+// must pass the prefilter, which is filled as in AliAnalysisTaskDimu::LoadRecoTracks
+// both with the direct AOD access (AliDimuAODMuons, fast path) and with the generic access.
+// The check fails (exit code 1) on any mismatch, or if no event is read.
+//
+// Compile with (from the top directory):
+// g++ -O2 -std=c++11 `root-config --cflags` -I. -I$ALICE_ROOT/include -I$ALICE_PHYSICS/include bench/checkTrackPrefilter.cxx
+//   -o checkTrackPrefilter `root-config --libs` -L$ALICE_ROOT/lib -L$ALICE_PHYSICS/lib -lSTEERBase -lAOD -lOADB -lPWGmuon
+//
+// Usage:
+// checkTrackPrefilter [options] AliAOD.Muons.root [more AOD files] (checkTrackPrefilter -h for the list)
+//
+//  Author: Diego Stocco
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TString.h"
+
+#include "AliAODEvent.h"
+#include "AliAODTrack.h"
+#include "AliAnalysisMuonUtility.h"
+#include "AliMuonTrackCuts.h"
+#include "AliDimuTrackPrefilter.h"
+#include "AliDimuAODMuons.h"
+
+/// Result of the check
+struct CheckResult {
+  Long64_t fNevents;        ///< Events read
+  Long64_t fNtracks;        ///< Tracks read
+  Long64_t fNselected;      ///< Tracks selected by the track cuts
+  Long64_t fNpassDirect;    ///< Tracks that pass the prefilter (direct AOD access)
+  Long64_t fNpassGeneric;   ///< Tracks that pass the prefilter (generic access)
+  Long64_t fNmismatches;    ///< Selected tracks rejected by the prefilter
+};
+
+//________________________________________________________________________
+void ReportMismatch ( const char* access, Long64_t ientry, Int_t itrack, const AliVParticle* track, CheckResult& result )
+{
+  /// Count the mismatch and print the first ones
+  if ( result.fNmismatches++ < 10 ) {
+    printf("E-checkTrackPrefilter: %s access: track %i of entry %lld selected but rejected by the prefilter (eta %g theta_abs %g match %i)\n",
+           access, itrack, ientry, track->Eta(), AliAnalysisMuonUtility::GetThetaAbsDeg(track), AliAnalysisMuonUtility::GetMatchTrigger(track));
+  }
+}
+
+//________________________________________________________________________
+void CheckEvent ( const AliAODEvent* aod, Long64_t ientry, AliMuonTrackCuts& cuts, AliDimuTrackPrefilter& prefilter, CheckResult& result )
+{
+  /// Compare the track cuts with the prefilter on all the tracks of the event
+  Int_t nTracks = aod->GetNumberOfTracks();
+  Bool_t muonTracksOnly = ( cuts.GetFilterMask() != 0 );
+  std::vector<Bool_t> isSelected(nTracks);
+  Long64_t nSelected = 0;
+  for ( Int_t itrack=0; itrack<nTracks; ++itrack ) {
+    isSelected[itrack] = cuts.IsSelected(aod->GetTrack(itrack));
+    if ( isSelected[itrack] ) ++nSelected;
+  }
+  result.fNtracks += nTracks;
+  result.fNselected += nSelected;
+
+  // Direct AOD access (AOD fast path, same code as the task): only the muon tracks
+  // are candidates when the cuts require them
+  static AliDimuAODMuons aodMuons;
+  static std::vector<AliVParticle*> candidates;
+  aodMuons.Load(aod, muonTracksOnly, candidates, &prefilter);
+  Long64_t nSelectedCandidates = 0;
+  for ( Int_t icand=0; icand<aodMuons.GetNcandidates(); ++icand ) {
+    result.fNpassDirect += prefilter.Pass(icand);
+    if ( ! cuts.IsSelected(candidates[icand]) ) continue;
+    ++nSelectedCandidates;
+    if ( ! prefilter.Pass(icand) ) ReportMismatch("direct", ientry, icand, candidates[icand], result);
+  }
+  if ( nSelectedCandidates != nSelected ) {
+    printf("E-checkTrackPrefilter: direct access: %lld selected tracks of entry %lld are not candidates\n", nSelected-nSelectedCandidates, ientry);
+    result.fNmismatches += nSelected-nSelectedCandidates;
+  }
+
+  // Generic access
+  prefilter.Resize(nTracks);
+  for ( Int_t itrack=0; itrack<nTracks; ++itrack ) {
+    const AliVParticle* track = AliAnalysisMuonUtility::GetTrack(itrack,aod);
+    if ( AliAnalysisMuonUtility::IsMuonTrack(track) ) prefilter.SetTrack(itrack, kTRUE, track->Eta(), AliAnalysisMuonUtility::GetThetaAbsDeg(track), AliAnalysisMuonUtility::GetMatchTrigger(track));
+    else prefilter.SetTrack(itrack, kFALSE, 0., 0., 0);
+  }
+  result.fNpassGeneric += prefilter.Select();
+  for ( Int_t itrack=0; itrack<nTracks; ++itrack ) {
+    if ( isSelected[itrack] && ! prefilter.Pass(itrack) ) ReportMismatch("generic", ientry, itrack, aod->GetTrack(itrack), result);
+  }
+}
+
+//________________________________________________________________________
+void PrintUsage ( const char* program )
+{
+  /// Print usage
+  printf("Usage: %s [options] AliAOD.root [more AOD files]\n", program);
+  printf("Options:\n");
+  printf("  -m <mask>         filter mask of the track cuts (default: the default mask of AliMuonTrackCuts)\n");
+  printf("  -n <nEvents>      maximum number of events read (default: all)\n");
+  printf("  --mc              MC sample\n");
+}
+
+//________________________________________________________________________
+int main ( int argc, char** argv )
+{
+  Long64_t maxEvents = -1;
+  Bool_t isMC = kFALSE;
+  TString filterMask = "";
+  std::vector<TString> fileNames;
+
+  for ( Int_t iarg=1; iarg<argc; ++iarg ) {
+    TString arg = argv[iarg];
+    Bool_t hasValue = ( iarg+1 < argc );
+    const char* value = hasValue ? argv[iarg+1] : "";
+    Bool_t isOk = kTRUE;
+    if ( arg == "-h" || arg == "--help" ) {
+      PrintUsage(argv[0]);
+      return 0;
+    }
+    else if ( arg == "--mc" ) isMC = kTRUE;
+    else if ( arg.BeginsWith("-") && hasValue ) {
+      if ( arg == "-m" ) filterMask = value;
+      else if ( arg == "-n" ) maxEvents = atoll(value);
+      else isOk = kFALSE;
+      ++iarg;
+    }
+    else if ( ! arg.BeginsWith("-") ) fileNames.push_back(arg);
+    else isOk = kFALSE;
+
+    if ( ! isOk ) {
+      printf("E-checkTrackPrefilter: invalid option %s\n", arg.Data());
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+  if ( fileNames.empty() ) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  AliMuonTrackCuts cuts("checkTrackPrefilter","checkTrackPrefilter");
+  cuts.SetIsMC(isMC);
+  cuts.SetAllowDefaultParams(kTRUE);
+  if ( ! filterMask.IsNull() ) cuts.SetFilterMask(strtoul(filterMask.Data(),0x0,0));
+  AliDimuTrackPrefilter prefilter;
+  prefilter.Configure(cuts.GetFilterMask());
+  printf("Filter mask of the track cuts: 0x%x\n", cuts.GetFilterMask());
+
+  CheckResult result = { 0, 0, 0, 0, 0, 0 };
+  Int_t currentRun = -1;
+  for ( const TString& fileName : fileNames ) {
+    TFile* file = TFile::Open(fileName.Data());
+    TTree* tree = ( file && ! file->IsZombie() ) ? static_cast<TTree*>(file->Get("aodTree")) : 0x0;
+    if ( ! tree ) {
+      printf("E-checkTrackPrefilter: cannot read the AOD tree of %s\n", fileName.Data());
+      delete file;
+      return 1;
+    }
+    AliAODEvent* aod = new AliAODEvent();
+    aod->ReadFromTree(tree);
+    Long64_t nEntries = tree->GetEntries();
+    for ( Long64_t ientry=0; ientry<nEntries; ++ientry ) {
+      if ( maxEvents >= 0 && result.fNevents >= maxEvents ) break;
+      tree->GetEntry(ientry);
+      if ( aod->GetRunNumber() != currentRun ) {
+        currentRun = aod->GetRunNumber();
+        cuts.SetCustomParamFromRun(currentRun);
+      }
+      CheckEvent(aod, ientry, cuts, prefilter, result);
+      ++result.fNevents;
+    }
+    delete aod;
+    delete file;
+  }
+
+  printf("\n%lld events, %lld tracks: %lld selected by the track cuts, %lld (direct) and %lld (generic) pass the prefilter\n",
+         result.fNevents, result.fNtracks, result.fNselected, result.fNpassDirect, result.fNpassGeneric);
+  if ( result.fNevents == 0 ) {
+    printf("E-checkTrackPrefilter: no event read\n");
+    return 1;
+  }
+  if ( result.fNmismatches > 0 ) {
+    printf("E-checkTrackPrefilter: %lld selected tracks rejected by the prefilter\n", result.fNmismatches);
+    return 1;
+  }
+  printf("I-checkTrackPrefilter: same selection as the track cuts\n");
+  return 0;
+}
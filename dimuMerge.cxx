@@ -0,0 +1,191 @@
+/* $Id$ */
+
+//
+// dimuMerge
+// Command line merger of the AliAnalysisTaskDimu outputs (see AliDimuMerger)
+// The merged collection is written with the same path as in the input files.
+// With --streaming the merge is done one object at a time, with bounded memory,
+// and the output is in split layout (one key per object). The inputs can be in
+// collection or split layout: merging a single split file converts it back to a collection.
+// With --compare the merged output is compared with a reference output, e.g. to check
+// that a modified task gives the same identifiers and contents as the previous version.
+//
+// Compile with (from the top directory):
+// rootcling -f G__DimuTools.cxx -I. -I$ALICE_PHYSICS/include -I$ALICE_ROOT/include
+//   AliDimuBinning.h AliDimuCompactSparse.h AliDimuOccupancy.h AliDimuSlowEvents.h DimuToolsLinkDef.h
+// g++ -O2 -std=c++11 `root-config --cflags` -I. -I$ALICE_PHYSICS/include -I$ALICE_ROOT/include
+//   dimuMerge.cxx AliDimuMerger.cxx G__DimuTools.cxx AliDimuBinning.cxx AliDimuCompactSparse.cxx AliDimuOccupancy.cxx AliDimuSlowEvents.cxx
+//   -o dimuMerge `root-config --libs` -L$ALICE_ROOT/lib -lSTEERBase -lANALYSIS -lPWGmuon -lpthread
+// (G__DimuTools.cxx is the dictionary of the classes stored in the outputs, see DimuToolsLinkDef.h:
+//  G__DimuTools_rdict.pcm must be in the directory of the executable)
+//
+// Usage:
+// dimuMerge [options] file1.root [file2.root ...] [@fileList.txt]
+//
+//  Author: Diego Stocco
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "TFile.h"
+#include "TStopwatch.h"
+#include "TString.h"
+
+#include "AliMergeableCollection.h"
+#include "AliDimuMerger.h"
+
+//________________________________________________________________________
+void PrintUsage ( const char* program )
+{
+  /// Print usage
+  printf("Usage: %s [options] file1.root [file2.root ...] [@fileList.txt]\n", program);
+  printf("Options:\n");
+  printf("  -o <file>      output file (default: DimuMerged.root)\n");
+  printf("  -n <path>      path of the collection in the input files (default: first collection found)\n");
+  printf("  -j <nThreads>  number of threads (default: number of cores)\n");
+  printf("  --standard     merge the files one by one with AliMergeableCollection::Merge\n");
+  printf("  --streaming    merge one object at a time and write the output in split layout\n");
+  printf("  --max-open <n> maximum number of files open at the same time with --streaming (default: 64)\n");
+  printf("  --compact      write the sparses in compact form (AliDimuCompactSparse)\n");
+  printf("  --verify       also run the standard merge and compare the results\n");
+  printf("  --compare <file> compare the merged collection with the one of a reference output (exit code 1 if they differ)\n");
+}
+
+//________________________________________________________________________
+Bool_t CompareWithReference ( const char* refFileName, const AliMergeableCollection* collection )
+{
+  /// Compare the collection with the first collection of the reference file
+  TString refPath = AliDimuMerger::FindCollectionPath(refFileName);
+  AliMergeableCollection* reference = refPath.IsNull() ? 0x0 : AliDimuMerger::ReadCollection(refFileName, refPath.Data());
+  if ( ! reference ) {
+    printf("E-dimuMerge: no collection in %s\n", refFileName);
+    return kFALSE;
+  }
+  printf("I-dimuMerge: comparison with %s:%s\n", refFileName, refPath.Data());
+  Bool_t isSame = AliDimuMerger::Compare(reference, collection);
+  delete reference;
+  return isSame;
+}
+
+//________________________________________________________________________
+int main ( int argc, char** argv )
+{
+  AliDimuMerger merger;
+  TString outFileName = "DimuMerged.root";
+  TString refFileName = "";
+  Bool_t isStandard = kFALSE, isStreaming = kFALSE, isCompact = kFALSE, verify = kFALSE;
+  std::vector<std::string> fileNames;
+
+  for ( Int_t iarg=1; iarg<argc; ++iarg ) {
+    TString arg = argv[iarg];
+    Bool_t hasValue = ( iarg+1 < argc );
+    const char* value = hasValue ? argv[iarg+1] : "";
+    Bool_t isOk = kTRUE;
+    if ( arg == "-h" || arg == "--help" ) {
+      PrintUsage(argv[0]);
+      return 0;
+    }
+    else if ( arg == "--standard" ) isStandard = kTRUE;
+    else if ( arg == "--streaming" ) isStreaming = kTRUE;
+    else if ( arg == "--compact" ) {
+      isCompact = kTRUE;
+      merger.SetCompactOutput(kTRUE);
+    }
+    else if ( arg == "--verify" ) verify = kTRUE;
+    else if ( arg.BeginsWith("-") ) {
+      if ( ! hasValue ) isOk = kFALSE;
+      else if ( arg == "-o" ) outFileName = value;
+      else if ( arg == "-n" ) merger.SetCollectionPath(value);
+      else if ( arg == "-j" ) merger.SetNthreads(atoi(value));
+      else if ( arg == "--max-open" ) merger.SetMaxOpenFiles(atoi(value));
+      else if ( arg == "--compare" ) refFileName = value;
+      else isOk = kFALSE;
+      ++iarg;
+    }
+    else if ( arg.BeginsWith("@") ) {
+      std::ifstream inFile(arg.Data()+1);
+      std::string line;
+      while ( std::getline(inFile,line) ) {
+        if ( ! line.empty() && line[0] != '#' ) fileNames.push_back(line);
+      }
+    }
+    else fileNames.push_back(arg.Data());
+
+    if ( ! isOk ) {
+      printf("E-dimuMerge: invalid option %s\n", arg.Data());
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if ( fileNames.empty() ) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+  for ( const std::string& fileName : fileNames ) merger.AddFile(fileName.c_str());
+
+  TStopwatch watch;
+  watch.Start();
+  if ( isStreaming ) {
+    Bool_t isOk = merger.RunStreaming(outFileName.Data());
+    watch.Stop();
+    if ( ! isOk ) return 1;
+    printf("I-dimuMerge: %lu files merged in %.2f s, output written in %s\n", fileNames.size(), watch.RealTime(), outFileName.Data());
+    if ( ! verify && refFileName.IsNull() ) return 0;
+    AliMergeableCollection* merged = AliDimuMerger::ReadCollection(outFileName.Data(), merger.GetCollectionPath());
+    Bool_t isSame = ( merged != 0x0 );
+    if ( verify ) {
+      AliMergeableCollection* reference = merger.RunStandard();
+      isSame = ( merged && reference && AliDimuMerger::Compare(reference, merged) ) && isSame;
+      delete reference;
+    }
+    if ( ! refFileName.IsNull() ) isSame = ( merged && CompareWithReference(refFileName.Data(), merged) ) && isSame;
+    delete merged;
+    return isSame ? 0 : 1;
+  }
+
+  AliMergeableCollection* collection = isStandard ? merger.RunStandard() : merger.Run();
+  watch.Stop();
+  if ( ! collection ) {
+    printf("E-dimuMerge: nothing merged\n");
+    return 1;
+  }
+  printf("I-dimuMerge: %lu files merged in %.2f s\n", fileNames.size(), watch.RealTime());
+
+  Int_t status = 0;
+  if ( verify && ! isStandard ) {
+    watch.Start();
+    AliMergeableCollection* reference = merger.RunStandard();
+    watch.Stop();
+    printf("I-dimuMerge: standard merge in %.2f s\n", watch.RealTime());
+    if ( ! reference || ! AliDimuMerger::Compare(reference, collection) ) status = 1;
+    delete reference;
+  }
+  if ( ! refFileName.IsNull() && ! CompareWithReference(refFileName.Data(), collection) ) status = 1;
+
+  TFile* outFile = TFile::Open(outFileName.Data(),"RECREATE");
+  if ( ! outFile || outFile->IsZombie() ) {
+    printf("E-dimuMerge: cannot create %s\n", outFileName.Data());
+    return 1;
+  }
+  TString path = merger.GetCollectionPath();
+  TString name = path, dirName = "";
+  Int_t slash = path.Last('/');
+  if ( slash >= 0 ) {
+    dirName = path(0,slash);
+    name = path(slash+1,path.Length()-slash-1);
+  }
+  TDirectory* dir = dirName.IsNull() ? outFile : outFile->mkdir(dirName.Data());
+  if ( isCompact ) AliDimuMerger::Compact(collection);
+  dir->WriteTObject(collection, name.Data(), "SingleKey");
+  outFile->Close();
+  delete outFile;
+  delete collection;
+
+  printf("I-dimuMerge: output written in %s\n", outFileName.Data());
+  return status;
+}
@@ -0,0 +1,335 @@
+/* $Id$ */
+
+//
+// dimuOptimizeBinning
+// Propose a binning of the dimuon sparses from the occupancy of a representative output.
+// The filled bins of all the sparses are projected on each axis, then adjacent bins
+// are merged until each new bin reaches the target statistical precision
+// (relative error of its projected content), with at most maxMerge original bins
+// per new bin: the new edges are a subset of the original ones.
+// The proposal is evaluated by refilling the sparses with the new binning
+// (filled bins, memory and time per fill). If the memory or fill-time budget is
+// not met, the target precision is tightened (more merging) and the procedure repeated.
+// The schema is written in a text file that the task can read
+// (AliAnalysisTaskDimu::SetBinningSchema or AliDimuBinning::ReadSchema).
+//
+// Compile with (from the top directory):
+// rootcling -f G__DimuTools.cxx -I. -I$ALICE_PHYSICS/include -I$ALICE_ROOT/include
+//   AliDimuBinning.h AliDimuCompactSparse.h AliDimuOccupancy.h AliDimuSlowEvents.h DimuToolsLinkDef.h
+// g++ -O2 -std=c++11 `root-config --cflags` -I. -I$ALICE_PHYSICS/include -I$ALICE_ROOT/include
+//   dimuOptimizeBinning.cxx AliDimuMerger.cxx G__DimuTools.cxx AliDimuBinning.cxx AliDimuCompactSparse.cxx AliDimuOccupancy.cxx AliDimuSlowEvents.cxx
+//   -o dimuOptimizeBinning `root-config --libs` -L$ALICE_ROOT/lib -lSTEERBase -lANALYSIS -lPWGmuon -lpthread
+// (G__DimuTools.cxx is the dictionary of the classes stored in the outputs, see DimuToolsLinkDef.h:
+//  G__DimuTools_rdict.pcm must be in the directory of the executable)
+//
+// Usage:
+// dimuOptimizeBinning [options] output.root
+//
+//  Author: Diego Stocco
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "TH1.h"
+#include "TMath.h"
+#include "TObjArray.h"
+#include "TObjString.h"
+#include "TStopwatch.h"
+#include "TString.h"
+#include "TAxis.h"
+#include "THnSparse.h"
+
+#include "AliMergeableCollection.h"
+#include "AliDimuBinning.h"
+#include "AliDimuMerger.h"
+#include "AliDimuOccupancy.h"
+
+/// Projection of the filled bins on an axis (with under/overflow)
+struct AxisProjection {
+  std::vector<Double_t> fSum;   ///< Sum of weights per bin
+  std::vector<Double_t> fSumw2; ///< Sum of squared weights per bin
+};
+
+/// Evaluation of a binning
+struct Evaluation {
+  Long64_t fBins;      ///< Filled bins
+  Long64_t fBytes;     ///< Estimated memory (bytes)
+  Double_t fNsPerFill; ///< Time per fill (ns)
+};
+
+//________________________________________________________________________
+void PrintUsage ( const char* program )
+{
+  /// Print usage
+  printf("Usage: %s [options] output.root\n", program);
+  printf("Options:\n");
+  printf("  -o <file>        output schema (default: DimuBinning.txt)\n");
+  printf("  -n <path>        path of the collection in the file (default: first collection found)\n");
+  printf("  -i <pattern>     only use the identifiers containing pattern\n");
+  printf("  -p <precision>   initial target relative precision per projected bin (default: 0.1)\n");
+  printf("  -k <maxMerge>    maximum number of original bins per new bin (default: 10)\n");
+  printf("  -m <MB>          memory budget of all the sparses (default: none)\n");
+  printf("  -t <ns>          fill time budget per fill (default: none)\n");
+  printf("  --keep <axes>    comma separated axes that are not rebinned (e.g. mass,centrality)\n");
+}
+
+//________________________________________________________________________
+void SetAxesFromSparse ( const THnSparse* sparse, AliDimuBinning& binning )
+{
+  /// Binning of the sparse
+  for ( Int_t iaxis=0; iaxis<AliDimuBinning::kNaxes; ++iaxis ) {
+    const TAxis* axis = sparse->GetAxis(iaxis);
+    std::vector<Double_t> edges(axis->GetNbins()+1);
+    for ( Int_t ibin=1; ibin<=axis->GetNbins(); ++ibin ) edges[ibin-1] = axis->GetBinLowEdge(ibin);
+    edges.back() = axis->GetBinUpEdge(axis->GetNbins());
+    binning.SetAxis(iaxis, axis->GetNbins(), edges.data());
+    binning.SetAxisTitle(iaxis, axis->GetTitle());
+  }
+}
+
+//________________________________________________________________________
+void Project ( const std::vector<THnSparse*>& sparses, std::vector<AxisProjection>& projections )
+{
+  /// Project the filled bins of all the sparses on each axis
+  const THnSparse* first = sparses.front();
+  projections.resize(AliDimuBinning::kNaxes);
+  for ( Int_t iaxis=0; iaxis<AliDimuBinning::kNaxes; ++iaxis ) {
+    projections[iaxis].fSum.assign(first->GetAxis(iaxis)->GetNbins()+2,0.);
+    projections[iaxis].fSumw2.assign(first->GetAxis(iaxis)->GetNbins()+2,0.);
+  }
+  Int_t coord[AliDimuBinning::kNaxes];
+  for ( THnSparse* sparse : sparses ) {
+    Bool_t hasErrors = sparse->GetCalculateErrors();
+    for ( Long64_t ibin=0; ibin<sparse->GetNbins(); ++ibin ) {
+      Double_t content = sparse->GetBinContent(ibin, coord);
+      Double_t error2 = hasErrors ? sparse->GetBinError2(ibin) : content;
+      for ( Int_t iaxis=0; iaxis<AliDimuBinning::kNaxes; ++iaxis ) {
+        projections[iaxis].fSum[coord[iaxis]] += content;
+        projections[iaxis].fSumw2[coord[iaxis]] += error2;
+      }
+    }
+  }
+}
+
+//________________________________________________________________________
+std::vector<Double_t> ProposeEdges ( const std::vector<Double_t>& edges, const AxisProjection& projection, Double_t precision, Int_t maxMerge )
+{
+  /// Merge adjacent bins until the relative error of the new bin is below precision
+  /// (i.e. the effective entries sum^2/sumw2 exceed 1/precision^2), with at most maxMerge bins.
+  /// A low-statistics last bin is merged with the previous one if possible
+  Int_t nBins = edges.size()-1;
+  Double_t minEffEntries = 1./(precision*precision);
+  std::vector<Double_t> newEdges(1,edges.front());
+  std::vector<Int_t> nMerged;
+  Double_t sum = 0., sumw2 = 0.;
+  Int_t nCurrent = 0;
+  for ( Int_t ibin=1; ibin<=nBins; ++ibin ) {
+    sum += projection.fSum[ibin];
+    sumw2 += projection.fSumw2[ibin];
+    ++nCurrent;
+    Bool_t isPrecise = ( sumw2 > 0. && sum*sum/sumw2 >= minEffEntries );
+    if ( isPrecise || nCurrent == maxMerge || ibin == nBins ) {
+      if ( ibin == nBins && ! isPrecise && ! nMerged.empty() && nMerged.back() + nCurrent <= maxMerge ) {
+        newEdges.pop_back();
+        nCurrent += nMerged.back();
+        nMerged.pop_back();
+      }
+      newEdges.push_back(edges[ibin]);
+      nMerged.push_back(nCurrent);
+      sum = sumw2 = 0.;
+      nCurrent = 0;
+    }
+  }
+  return newEdges;
+}
+
+//________________________________________________________________________
+Evaluation Evaluate ( const std::vector<THnSparse*>& sparses, const AliDimuBinning& binning )
+{
+  /// Refill the sparses with the binning: number of filled bins, memory and time per fill.
+  /// Each filled bin of the original sparse is one fill at its center
+  Evaluation evaluation = { 0, 0, 0. };
+  Long64_t nFills = 0;
+  Double_t time = 0.;
+  TStopwatch watch;
+  Int_t coord[AliDimuBinning::kNaxes];
+  Double_t x[AliDimuBinning::kNaxes];
+  for ( THnSparse* sparse : sparses ) {
+    THnSparse* rebinned = binning.CreateSparse("rebinned","rebinned");
+    if ( sparse->GetCalculateErrors() ) rebinned->Sumw2();
+    std::vector<Double_t> contents(sparse->GetNbins());
+    std::vector<Double_t> values(sparse->GetNbins()*AliDimuBinning::kNaxes);
+    for ( Long64_t ibin=0; ibin<sparse->GetNbins(); ++ibin ) {
+      contents[ibin] = sparse->GetBinContent(ibin, coord);
+      for ( Int_t iaxis=0; iaxis<AliDimuBinning::kNaxes; ++iaxis ) {
+        const TAxis* axis = sparse->GetAxis(iaxis);
+        if ( coord[iaxis] == 0 ) x[iaxis] = axis->GetXmin() - 1.;
+        else if ( coord[iaxis] > axis->GetNbins() ) x[iaxis] = axis->GetXmax() + 1.;
+        else x[iaxis] = axis->GetBinCenter(coord[iaxis]);
+        values[ibin*AliDimuBinning::kNaxes+iaxis] = x[iaxis];
+      }
+    }
+    watch.Start();
+    for ( Long64_t ibin=0; ibin<sparse->GetNbins(); ++ibin ) rebinned->Fill(&values[ibin*AliDimuBinning::kNaxes], contents[ibin]);
+    watch.Stop();
+    time += watch.RealTime();
+    nFills += sparse->GetNbins();
+    evaluation.fBins += rebinned->GetNbins();
+    evaluation.fBytes += AliDimuOccupancy::EstimateBytes(rebinned);
+    delete rebinned;
+  }
+  evaluation.fNsPerFill = ( nFills > 0 ) ? 1.e9*time/nFills : 0.;
+  return evaluation;
+}
+
+//________________________________________________________________________
+void PrintEvaluation ( const char* name, const Evaluation& evaluation )
+{
+  /// Print the evaluation of a binning
+  printf("%-10s %14lld %14.1f %12.1f\n", name, evaluation.fBins, evaluation.fBytes/1024./1024., evaluation.fNsPerFill);
+}
+
+//________________________________________________________________________
+int main ( int argc, char** argv )
+{
+  TString outFileName = "DimuBinning.txt", collectionPath = "", pattern = "";
+  Double_t precision = 0.1, memoryBudget = 0., fillBudget = 0.;
+  Int_t maxMerge = 10;
+  std::vector<Bool_t> keepAxis(AliDimuBinning::kNaxes,kFALSE);
+  TString inFileName = "";
+
+  for ( Int_t iarg=1; iarg<argc; ++iarg ) {
+    TString arg = argv[iarg];
+    Bool_t hasValue = ( iarg+1 < argc );
+    const char* value = hasValue ? argv[iarg+1] : "";
+    Bool_t isOk = kTRUE;
+    if ( arg == "-h" || arg == "--help" ) {
+      PrintUsage(argv[0]);
+      return 0;
+    }
+    else if ( arg.BeginsWith("-") ) {
+      if ( ! hasValue ) isOk = kFALSE;
+      else if ( arg == "-o" ) outFileName = value;
+      else if ( arg == "-n" ) collectionPath = value;
+      else if ( arg == "-i" ) pattern = value;
+      else if ( arg == "-p" ) precision = atof(value);
+      else if ( arg == "-k" ) maxMerge = atoi(value);
+      else if ( arg == "-m" ) memoryBudget = atof(value)*1024.*1024.;
+      else if ( arg == "-t" ) fillBudget = atof(value);
+      else if ( arg == "--keep" ) {
+        TObjArray* axes = TString(value).Tokenize(",");
+        for ( Int_t iaxis=0; iaxis<axes->GetEntries(); ++iaxis ) {
+          Int_t index = AliDimuBinning::GetAxisIndex(static_cast<TObjString*>(axes->At(iaxis))->String().Data());
+          if ( index < 0 ) isOk = kFALSE;
+          else keepAxis[index] = kTRUE;
+        }
+        delete axes;
+      }
+      else isOk = kFALSE;
+      ++iarg;
+    }
+    else inFileName = arg;
+
+    if ( ! isOk || precision <= 0. || maxMerge < 1 ) {
+      printf("E-dimuOptimizeBinning: invalid option %s\n", arg.Data());
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+  if ( inFileName.IsNull() ) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+  TH1::AddDirectory(kFALSE);
+
+  if ( collectionPath.IsNull() ) collectionPath = AliDimuMerger::FindCollectionPath(inFileName.Data());
+  AliMergeableCollection* collection = AliDimuMerger::ReadCollection(inFileName.Data(), collectionPath.Data());
+  if ( ! collection ) return 1;
+
+  // Sparses with the same binning
+  std::vector<THnSparse*> sparses;
+  TObjArray* identifiers = collection->SortAllIdentifiers();
+  TIter nextIdentifier(identifiers);
+  TObjString* identifier = 0x0;
+  while ( (identifier = static_cast<TObjString*>(nextIdentifier())) ) {
+    if ( ! pattern.IsNull() && ! identifier->String().Contains(pattern) ) continue;
+    THnSparse* sparse = dynamic_cast<THnSparse*>(collection->GetObject(identifier->GetName(),"DimuSparse"));
+    if ( ! sparse || sparse->GetNdimensions() != AliDimuBinning::kNaxes ) continue;
+    if ( ! sparses.empty() ) {
+      Bool_t isSame = kTRUE;
+      for ( Int_t iaxis=0; iaxis<AliDimuBinning::kNaxes; ++iaxis ) {
+        if ( sparse->GetAxis(iaxis)->GetNbins() != sparses.front()->GetAxis(iaxis)->GetNbins() ) isSame = kFALSE;
+      }
+      if ( ! isSame ) {
+        printf("W-dimuOptimizeBinning: %s has a different binning: skipped\n", identifier->GetName());
+        continue;
+      }
+    }
+    sparses.push_back(sparse);
+  }
+  delete identifiers;
+  if ( sparses.empty() ) {
+    printf("E-dimuOptimizeBinning: no sparse found in %s\n", inFileName.Data());
+    delete collection;
+    return 1;
+  }
+
+  AliDimuBinning original;
+  SetAxesFromSparse(sparses.front(), original);
+  std::vector<AxisProjection> projections;
+  Project(sparses, projections);
+
+  Evaluation reference = Evaluate(sparses, original);
+  printf("%lu sparses\n\n%-10s %14s %14s %12s\n", sparses.size(), "binning", "filled bins", "memory (MB)", "ns/fill");
+  PrintEvaluation("original", reference);
+
+  // Tighten the precision (more merging) until the budget is met
+  // or every axis is fully merged (all the bins at maxMerge, i.e. no further merging possible).
+  // An iteration where the bin count does not change does not stop the search:
+  // a tighter precision can still merge the bins of a sparsely populated region
+  AliDimuBinning proposed;
+  Evaluation evaluation = reference;
+  Bool_t isInBudget = kFALSE;
+  for ( Int_t iter=0; iter<50; ++iter ) {
+    proposed = original;
+    Bool_t isFullyMerged = kTRUE;
+    for ( Int_t iaxis=0; iaxis<AliDimuBinning::kNaxes; ++iaxis ) {
+      if ( keepAxis[iaxis] ) continue;
+      std::vector<Double_t> edges = ProposeEdges(original.GetEdges(iaxis), projections[iaxis], precision, maxMerge);
+      proposed.SetAxis(iaxis, edges.size()-1, edges.data());
+      Int_t nMinBins = ( original.GetNbins(iaxis) + maxMerge - 1 ) / maxMerge;
+      if ( proposed.GetNbins(iaxis) > nMinBins ) isFullyMerged = kFALSE;
+    }
+    evaluation = Evaluate(sparses, proposed);
+    PrintEvaluation(Form("p=%.3g",precision), evaluation);
+    isInBudget = ( memoryBudget <= 0. || evaluation.fBytes <= memoryBudget ) && ( fillBudget <= 0. || evaluation.fNsPerFill <= fillBudget );
+    if ( isInBudget || isFullyMerged ) break;
+    precision /= 1.5;
+  }
+
+  // Precision loss: bins merged per axis
+  printf("\n%-12s %10s %10s %12s\n", "axis", "bins", "new bins", "max merged");
+  for ( Int_t iaxis=0; iaxis<AliDimuBinning::kNaxes; ++iaxis ) {
+    const std::vector<Double_t>& edges = original.GetEdges(iaxis);
+    const std::vector<Double_t>& newEdges = proposed.GetEdges(iaxis);
+    Int_t maxMerged = 0, iedge = 0;
+    for ( size_t inew=1; inew<newEdges.size(); ++inew ) {
+      Int_t first = iedge;
+      while ( iedge < (Int_t)edges.size()-1 && edges[iedge] < newEdges[inew] - 1.e-9*TMath::Abs(newEdges[inew]) ) ++iedge;
+      maxMerged = TMath::Max(maxMerged, iedge-first);
+    }
+    printf("%-12s %10i %10i %12i\n", AliDimuBinning::GetAxisName(iaxis), original.GetNbins(iaxis), proposed.GetNbins(iaxis), maxMerged);
+  }
+
+  TString comment = Form("Proposed by dimuOptimizeBinning from %s\nprecision %g, max merge %i: %lld filled bins, %.1f MB, %.1f ns/fill (original: %lld, %.1f MB, %.1f ns/fill)",
+                         inFileName.Data(), precision, maxMerge, evaluation.fBins, evaluation.fBytes/1024./1024., evaluation.fNsPerFill,
+                         reference.fBins, reference.fBytes/1024./1024., reference.fNsPerFill);
+  Bool_t isWritten = proposed.WriteSchema(outFileName.Data(), comment.Data());
+  if ( isWritten ) printf("\nI-dimuOptimizeBinning: schema written in %s\n", outFileName.Data());
+  if ( ! isInBudget ) printf("W-dimuOptimizeBinning: the budget cannot be met with at most %i bins merged\n", maxMerge);
+
+  delete collection;
+  return ( isWritten && isInBudget ) ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+/* $Id$ */
+
+//
+// dimuSkimAnalysis
+// Command line re-analysis of the dimuon skims written by AliAnalysisTaskDimu
+// The output collection has the same layout as the one of the task,
+// so that it can be used with AliAnalysisTaskDimu::Terminate.
+//
+// Compile with (from the top directory):
+// rootcling -f G__DimuTools.cxx -I. -I$ALICE_PHYSICS/include -I$ALICE_ROOT/include
+//   AliDimuBinning.h AliDimuCompactSparse.h AliDimuOccupancy.h AliDimuSlowEvents.h DimuToolsLinkDef.h
+// g++ -O2 -std=c++11 `root-config --cflags` -I. -I$ALICE_PHYSICS/include -I$ALICE_ROOT/include
+//   dimuSkimAnalysis.cxx AliDimuSkimAnalysis.cxx AliDimuSkimIndex.cxx AliDimuSkim.cxx G__DimuTools.cxx AliDimuBinning.cxx AliDimuCompactSparse.cxx AliDimuOccupancy.cxx AliDimuSlowEvents.cxx
+//   -o dimuSkimAnalysis `root-config --libs` -L$ALICE_ROOT/lib -lSTEERBase -lANALYSIS -lCORRFW -lPWGmuon -lpthread
+// (G__DimuTools.cxx is the dictionary of the classes stored in the outputs, see DimuToolsLinkDef.h:
+//  G__DimuTools_rdict.pcm must be in the directory of the executable)
+//
+// Usage:
+// dimuSkimAnalysis [options] skim1.dimu [skim2.dimu ...] [@fileList.txt]
+//
+//  Author: Diego Stocco
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "TFile.h"
+#include "TObjArray.h"
+#include "TObjString.h"
+#include "TString.h"
+
+#include "AliMergeableCollection.h"
+#include "AliDimuSkimAnalysis.h"
+
+//________________________________________________________________________
+void PrintUsage ( const char* program )
+{
+  /// Print usage
+  printf("Usage: %s [options] skim1.dimu [skim2.dimu ...] [@fileList.txt]\n", program);
+  printf("Options:\n");
+  printf("  -o <file>              output file (default: DimuSkimAnalysis.root)\n");
+  printf("  -n <name>              name of the output collection (default: DimuOut)\n");
+  printf("  -j <nThreads>          number of threads (default: number of cores)\n");
+  printf("  --tracklet-cuts <list> comma separated tracklet distance cuts\n");
+  printf("  --pair-types <list>    comma separated pair types to be kept\n");
+  printf("  --trig-classes <list>  comma separated trigger classes to be kept\n");
+  printf("  --charge <list>        charge types to be kept (OS,SS)\n");
+  printf("  --runs <list>          comma separated runs to be kept\n");
+  printf("  --muon-pt-min <pt>     minimum single muon pt\n");
+  printf("  --muon-eta <min:max>   single muon pseudo-rapidity range\n");
+  printf("  --centrality <min:max> centrality range\n");
+  printf("  --no-trig-pt-cut       do not apply the pt cut of the trigger class\n");
+  printf("  --no-index             scan all the events instead of using the sidecar index\n");
+  printf("  --save-index           write the sidecar index next to the skim if it is missing or stale\n");
+  printf("  --binning <axisDef>    axis binning (e.g. mass:300:0:15 or pt:0,1,2,4,8), can be repeated\n");
+}
+
+//________________________________________________________________________
+Bool_t ParseRange ( const char* range, Double_t& xMin, Double_t& xMax )
+{
+  /// Parse range min:max
+  TObjArray* tokens = TString(range).Tokenize(":");
+  Bool_t isOk = ( tokens->GetEntries() == 2 );
+  if ( isOk ) {
+    xMin = static_cast<TObjString*>(tokens->At(0))->String().Atof();
+    xMax = static_cast<TObjString*>(tokens->At(1))->String().Atof();
+  }
+  delete tokens;
+  return isOk;
+}
+
+//________________________________________________________________________
+int main ( int argc, char** argv )
+{
+  AliDimuSkimAnalysis analysis;
+  TString outFileName = "DimuSkimAnalysis.root";
+  TString collectionName = "DimuOut";
+  std::vector<std::string> fileNames;
+
+  for ( Int_t iarg=1; iarg<argc; ++iarg ) {
+    TString arg = argv[iarg];
+    Bool_t hasValue = ( iarg+1 < argc );
+    const char* value = hasValue ? argv[iarg+1] : "";
+    Bool_t isOk = kTRUE;
+    if ( arg == "-h" || arg == "--help" ) {
+      PrintUsage(argv[0]);
+      return 0;
+    }
+    else if ( arg == "--no-trig-pt-cut" ) analysis.SetApplyTrigPtCut(kFALSE);
+    else if ( arg == "--no-index" ) analysis.SetUseIndex(kFALSE);
+    else if ( arg == "--save-index" ) analysis.SetSaveIndex(kTRUE);
+    else if ( arg.BeginsWith("-") ) {
+      if ( ! hasValue ) isOk = kFALSE;
+      else if ( arg == "-o" ) outFileName = value;
+      else if ( arg == "-n" ) collectionName = value;
+      else if ( arg == "-j" ) analysis.SetNthreads(atoi(value));
+      else if ( arg == "--tracklet-cuts" ) {
+        std::vector<Double_t> cuts;
+        TObjArray* tokens = TString(value).Tokenize(",");
+        for ( Int_t itoken=0; itoken<tokens->GetEntries(); ++itoken ) cuts.push_back(static_cast<TObjString*>(tokens->At(itoken))->String().Atof());
+        delete tokens;
+        analysis.SetTrackletDistCuts(cuts);
+      }
+      else if ( arg == "--pair-types" ) analysis.SelectPairTypes(value);
+      else if ( arg == "--trig-classes" ) analysis.SelectTrigClasses(value);
+      else if ( arg == "--charge" ) analysis.SelectChargeTypes(value);
+      else if ( arg == "--runs" ) analysis.SelectRuns(value);
+      else if ( arg == "--muon-pt-min" ) analysis.SetMuonPtMin(atof(value));
+      else if ( arg == "--muon-eta" || arg == "--centrality" ) {
+        Double_t xMin = 0., xMax = 0.;
+        isOk = ParseRange(value, xMin, xMax);
+        if ( isOk ) {
+          if ( arg == "--muon-eta" ) analysis.SetMuonEtaRange(xMin, xMax);
+          else analysis.SetCentralityRange(xMin, xMax);
+        }
+      }
+      else if ( arg == "--binning" ) isOk = analysis.GetBinning()->SetAxis(value);
+      else isOk = kFALSE;
+      ++iarg;
+    }
+    else if ( arg.BeginsWith("@") ) {
+      std::ifstream inFile(arg.Data()+1);
+      std::string line;
+      while ( std::getline(inFile,line) ) {
+        if ( ! line.empty() && line[0] != '#' ) fileNames.push_back(line);
+      }
+    }
+    else fileNames.push_back(arg.Data());
+
+    if ( ! isOk ) {
+      printf("E-dimuSkimAnalysis: invalid option %s\n", arg.Data());
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if ( fileNames.empty() ) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  for ( const std::string& fileName : fileNames ) {
+    if ( ! analysis.AddFile(fileName.c_str()) ) {
+      printf("E-dimuSkimAnalysis: cannot open skim %s\n", fileName.c_str());
+      return 1;
+    }
+  }
+
+  AliMergeableCollection* collection = analysis.Run(collectionName.Data());
+
+  TFile* outFile = TFile::Open(outFileName.Data(),"RECREATE");
+  if ( ! outFile || outFile->IsZombie() ) {
+    printf("E-dimuSkimAnalysis: cannot create %s\n", outFileName.Data());
+    return 1;
+  }
+  collection->Write(collection->GetName(),TObject::kSingleKey);
+  outFile->Close();
+  delete outFile;
+  delete collection;
+
+  printf("I-dimuSkimAnalysis: output written in %s\n", outFileName.Data());
+  return 0;
+}